@@ -0,0 +1,104 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr size_t kPageSize = 4096;
+}
+
+Arena::Arena(std::pmr::memory_resource* upstream)
+    : m_upstream(upstream)
+{
+}
+
+Arena::~Arena()
+{
+    release();
+}
+
+void Arena::release()
+{
+    for (auto [chunk, bytes] : m_chunks) {
+        m_upstream->deallocate(chunk, bytes, kGranularity);
+    }
+    m_chunks.clear();
+    m_chunks.shrink_to_fit();
+    m_free.fill(nullptr);
+    m_cursor = nullptr;
+    m_end = nullptr;
+    m_capacity = 0;
+    m_freeBytes = 0;
+}
+
+void Arena::reserve(size_t bytes)
+{
+    const size_t available = static_cast<size_t>(m_end - m_cursor) + m_freeBytes;
+    if (bytes <= available) {
+        return;
+    }
+
+    // the rest of the current chunk goes to the free lists, so it still counts
+    addChunk(bytes - available);
+    for (std::byte* page = m_cursor; page < m_end; page += kPageSize) {
+        *page = std::byte { 0 };
+    }
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment)
+{
+    if (!small(bytes, alignment)) {
+        void* out = m_upstream->allocate(bytes, alignment);
+        m_largeBytes += bytes;
+        return out;
+    }
+
+    const size_t index = sizeClass(bytes);
+    if (FreeBlock* block = m_free[index]) {
+        m_free[index] = block->next;
+        m_freeBytes -= (index + 1) * kGranularity;
+        return block;
+    }
+
+    const size_t blockSize = (index + 1) * kGranularity;
+    if (static_cast<size_t>(m_end - m_cursor) < blockSize) {
+        addChunk(kChunkSize);
+    }
+    void* out = m_cursor;
+    m_cursor += blockSize;
+    return out;
+}
+
+void Arena::do_deallocate(void* p, size_t bytes, size_t alignment)
+{
+    if (!small(bytes, alignment)) {
+        m_upstream->deallocate(p, bytes, alignment);
+        m_largeBytes -= bytes;
+        return;
+    }
+
+    pushFree(p, sizeClass(bytes));
+}
+
+void Arena::pushFree(void* p, size_t index)
+{
+    m_free[index] = new (p) FreeBlock { m_free[index] };
+    m_freeBytes += (index + 1) * kGranularity;
+}
+
+void Arena::addChunk(size_t bytes)
+{
+    // the tail is a multiple of kGranularity, it is cut into blocks of the biggest size class
+    while (m_cursor < m_end) {
+        const size_t blockSize = std::min(static_cast<size_t>(m_end - m_cursor), kMaxBlock);
+        pushFree(m_cursor, sizeClass(blockSize));
+        m_cursor += blockSize;
+    }
+
+    bytes = std::max(bytes, kChunkSize);
+    auto* chunk = static_cast<std::byte*>(m_upstream->allocate(bytes, kGranularity));
+    m_chunks.emplace_back(chunk, bytes);
+    m_cursor = chunk;
+    m_end = chunk + bytes;
+    m_capacity += bytes;
+}
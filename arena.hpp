@@ -0,0 +1,68 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Single threaded memory resource handing out small blocks from big chunks. Freed blocks go to a free list of their
+// size class and are reused by the next allocation of that class, so a steady add/cancel flow stops hitting malloc
+// once the arena has grown to the working set size. Memory is returned upstream only when the arena is destroyed.
+// Blocks above kMaxBlock bytes are passed to the upstream resource directly. When a new chunk is started, the tail of
+// the current one goes to the free lists too, so no chunk is left partly unused.
+class Arena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t kGranularity = 16;
+    static constexpr size_t kMaxBlock = 512;
+    static constexpr size_t kChunkSize = 256 * 1024;
+
+    explicit Arena(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+    ~Arena() override;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // makes sure at least that many bytes can be allocated without asking upstream: free blocks and the rest of the
+    // current chunk count, a new chunk is added (and its pages touched, so the first allocations don't pay for page
+    // faults) only for what they fall short of
+    void reserve(size_t bytes);
+
+    // bytes taken from upstream for chunks
+    size_t capacity() const { return m_capacity; }
+    // bytes of blocks above kMaxBlock currently passed through to upstream
+    size_t largeBytes() const { return m_largeBytes; }
+    // bytes of small blocks waiting in the free lists
+    size_t freeBytes() const { return m_freeBytes; }
+
+    // gives all chunks back upstream, meant for an owner which has deallocated (or dropped) every small block
+    void release();
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    static bool small(size_t bytes, size_t alignment) { return bytes <= kMaxBlock && alignment <= kGranularity; }
+    static size_t sizeClass(size_t bytes) { return (std::max(bytes, size_t { 1 }) + kGranularity - 1) / kGranularity - 1; }
+
+    void addChunk(size_t bytes);
+    void pushFree(void* p, size_t index);
+
+    std::pmr::memory_resource* m_upstream;
+    std::array<FreeBlock*, kMaxBlock / kGranularity> m_free {};
+    std::vector<std::pair<std::byte*, size_t>> m_chunks;
+    std::byte* m_cursor { nullptr };
+    std::byte* m_end { nullptr };
+    size_t m_capacity { 0 };
+    size_t m_largeBytes { 0 };
+    size_t m_freeBytes { 0 };
+};
+
+#endif // ARENA_HPP
@@ -0,0 +1,223 @@
+#include "asyncordercache.hpp"
+
+#include <memory>
+
+namespace {
+
+// the promise is shared so the callback stays copyable for std::function
+template <typename T>
+std::pair<std::future<T>, std::function<void(T)>> promised()
+{
+    auto promise = std::make_shared<std::promise<T>>();
+    auto future = promise->get_future();
+    return { std::move(future), [promise](T value) { promise->set_value(std::move(value)); } };
+}
+
+} // namespace
+
+AsyncOrderCache::AsyncOrderCache(size_t ringCapacity)
+    : m_ring(ringCapacity)
+    , m_writer(&AsyncOrderCache::run, this)
+{
+}
+
+AsyncOrderCache::~AsyncOrderCache()
+{
+    submit(Stop {});
+    m_writer.join();
+}
+
+void AsyncOrderCache::addOrder(Order order)
+{
+    submit(Add { std::move(order) });
+}
+
+void AsyncOrderCache::cancelOrder(const std::string& orderId)
+{
+    submit(Cancel { orderId });
+}
+
+void AsyncOrderCache::cancelOrdersForUser(const std::string& user)
+{
+    submit(CancelForUser { user });
+}
+
+void AsyncOrderCache::cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty)
+{
+    submit(CancelForSecIdWithMinimumQty { securityId, minQty });
+}
+
+unsigned int AsyncOrderCache::getMatchingSizeForSecurity(const std::string& securityId)
+{
+    return submitMatchingSize(securityId).get();
+}
+
+unsigned int AsyncOrderCache::getMatchingSizeForSecurity2(const std::string& securityId)
+{
+    return submitMatchingSize2(securityId).get();
+}
+
+std::vector<Order> AsyncOrderCache::getAllOrders() const
+{
+    return submitGetAllOrders().get();
+}
+
+void AsyncOrderCache::addOrders(const std::vector<Order>& orders)
+{
+    submit(AddBatch { orders });
+}
+
+void AsyncOrderCache::cancelOrders(const std::vector<std::string>& orderIds)
+{
+    submit(CancelBatch { orderIds });
+}
+
+void AsyncOrderCache::cancelOrdersForUsers(const std::vector<std::string>& users)
+{
+    submit(CancelForUsers { users });
+}
+
+std::future<unsigned int> AsyncOrderCache::submitMatchingSize(const std::string& securityId)
+{
+    auto [future, done] = promised<unsigned int>();
+    submitMatchingSize(securityId, std::move(done));
+    return std::move(future);
+}
+
+void AsyncOrderCache::submitMatchingSize(const std::string& securityId, std::function<void(unsigned int)> done)
+{
+    submit(MatchingSize { securityId, std::move(done) });
+}
+
+std::future<unsigned int> AsyncOrderCache::submitMatchingSize2(const std::string& securityId)
+{
+    auto [future, done] = promised<unsigned int>();
+    submitMatchingSize2(securityId, std::move(done));
+    return std::move(future);
+}
+
+void AsyncOrderCache::submitMatchingSize2(const std::string& securityId, std::function<void(unsigned int)> done)
+{
+    submit(MatchingSize2 { securityId, std::move(done) });
+}
+
+std::future<std::vector<Order>> AsyncOrderCache::submitGetAllOrders() const
+{
+    auto [future, done] = promised<std::vector<Order>>();
+    submit(AllOrders { std::move(done) });
+    return std::move(future);
+}
+
+void AsyncOrderCache::flush() const
+{
+    auto promise = std::make_shared<std::promise<void>>();
+    auto future = promise->get_future();
+    submit(Barrier { [promise] { promise->set_value(); } });
+    future.get();
+}
+
+void AsyncOrderCache::submit(Command command) const
+{
+    m_ring.push(std::move(command));
+    // pairs with the fence in sleep(): either the writer sees the command or we see it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed)) {
+        std::scoped_lock lock(m_sleepMutex);
+        m_wake.notify_one();
+    }
+}
+
+void AsyncOrderCache::run()
+{
+    Command command;
+    for (int spins = 0;;) {
+        if (!m_ring.tryPop(command)) {
+            if (++spins < kSpins) {
+                std::this_thread::yield();
+            } else {
+                sleep();
+                spins = 0;
+            }
+            continue;
+        }
+        spins = 0;
+        if (!apply(command)) {
+            return;
+        }
+    }
+}
+
+bool AsyncOrderCache::apply(Command& command)
+{
+    struct Visitor {
+        OrderBook& book;
+
+        bool operator()(std::monostate) { return true; }
+        bool operator()(Add& add)
+        {
+            book.add(add.order);
+            return true;
+        }
+        bool operator()(Cancel& cancel)
+        {
+            book.cancel(cancel.orderId);
+            return true;
+        }
+        bool operator()(CancelForUser& cancel)
+        {
+            book.cancelForUser(cancel.user);
+            return true;
+        }
+        bool operator()(CancelForSecIdWithMinimumQty& cancel)
+        {
+            book.cancelForSecIdWithMinimumQty(cancel.securityId, cancel.minQty);
+            return true;
+        }
+        bool operator()(MatchingSize& query)
+        {
+            query.done(book.matchingSize(query.securityId));
+            return true;
+        }
+        bool operator()(MatchingSize2& query)
+        {
+            query.done(book.match(query.securityId));
+            return true;
+        }
+        bool operator()(AllOrders& query)
+        {
+            query.done(book.orders());
+            return true;
+        }
+        bool operator()(AddBatch& batch)
+        {
+            book.add(batch.orders);
+            return true;
+        }
+        bool operator()(CancelBatch& batch)
+        {
+            book.cancel(batch.orderIds);
+            return true;
+        }
+        bool operator()(CancelForUsers& batch)
+        {
+            book.cancelForUsers(batch.users);
+            return true;
+        }
+        bool operator()(Barrier& barrier)
+        {
+            barrier.done();
+            return true;
+        }
+        bool operator()(Stop&) { return false; }
+    };
+    return std::visit(Visitor { m_book }, command);
+}
+
+void AsyncOrderCache::sleep()
+{
+    std::unique_lock lock(m_sleepMutex);
+    m_sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    m_wake.wait(lock, [this] { return !m_ring.empty(); });
+    m_sleeping.store(false, std::memory_order_relaxed);
+}
@@ -0,0 +1,123 @@
+#ifndef ASYNCORDERCACHE_HPP
+#define ASYNCORDERCACHE_HPP
+
+#include "mpscring.hpp"
+#include "ordercachebatchinterface.hpp"
+#include "ordercacheinterface.hpp"
+#include "orderbook.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+// Single writer execution mode (LMAX disruptor style). Callers don't touch the book, they push commands into a
+// lock-free MPSC ring and one dedicated thread applies them in ring order to an OrderBook which is never locked.
+// Ingest takes no lock at all, every command sees the effects of all commands pushed before it, and the book stays
+// hot in the writer thread's cache.
+//
+// Mutations return as soon as the command is queued. Queries are commands too: the submit*() functions return
+// a future or call a callback on the writer thread (it must not block and must not call back into the cache),
+// the synchronous OrderCacheInterface queries submit and wait. A full ring makes producers yield until the writer
+// catches up. An idle writer spins a little and then sleeps until a producer wakes it up.
+class AsyncOrderCache : public OrderCacheInterface, public OrderCacheBatchInterface {
+public:
+    explicit AsyncOrderCache(size_t ringCapacity = 64 * 1024);
+    // applies everything queued so far
+    ~AsyncOrderCache();
+
+    AsyncOrderCache(const AsyncOrderCache&) = delete;
+    AsyncOrderCache& operator=(const AsyncOrderCache&) = delete;
+
+    // OrderCacheInterface interface
+    void addOrder(Order order) override;
+    void cancelOrder(const std::string& orderId) override;
+    void cancelOrdersForUser(const std::string& user) override;
+    void cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty) override;
+    unsigned int getMatchingSizeForSecurity(const std::string& securityId) override;
+    unsigned int getMatchingSizeForSecurity2(const std::string& securityId) override;
+    std::vector<Order> getAllOrders() const override;
+
+    // OrderCacheBatchInterface interface, a batch is a single command
+    void addOrders(const std::vector<Order>& orders) override;
+    void cancelOrders(const std::vector<std::string>& orderIds) override;
+    void cancelOrdersForUsers(const std::vector<std::string>& users) override;
+
+    std::future<unsigned int> submitMatchingSize(const std::string& securityId);
+    void submitMatchingSize(const std::string& securityId, std::function<void(unsigned int)> done);
+    std::future<unsigned int> submitMatchingSize2(const std::string& securityId);
+    void submitMatchingSize2(const std::string& securityId, std::function<void(unsigned int)> done);
+    std::future<std::vector<Order>> submitGetAllOrders() const;
+
+    // blocks until every command queued before the call is applied
+    void flush() const;
+
+private:
+    struct Add {
+        Order order;
+    };
+    struct Cancel {
+        std::string orderId;
+    };
+    struct CancelForUser {
+        std::string user;
+    };
+    struct CancelForSecIdWithMinimumQty {
+        std::string securityId;
+        unsigned int minQty;
+    };
+    struct MatchingSize {
+        std::string securityId;
+        std::function<void(unsigned int)> done;
+    };
+    struct MatchingSize2 {
+        std::string securityId;
+        std::function<void(unsigned int)> done;
+    };
+    struct AllOrders {
+        std::function<void(std::vector<Order>)> done;
+    };
+    struct AddBatch {
+        std::vector<Order> orders;
+    };
+    struct CancelBatch {
+        std::vector<std::string> orderIds;
+    };
+    struct CancelForUsers {
+        std::vector<std::string> users;
+    };
+    struct Barrier {
+        std::function<void()> done;
+    };
+    struct Stop {
+    };
+
+    using Command = std::variant<std::monostate, Add, Cancel, CancelForUser, CancelForSecIdWithMinimumQty, MatchingSize,
+        MatchingSize2, AllOrders, AddBatch, CancelBatch, CancelForUsers, Barrier, Stop>;
+
+    // const queries push as well, the ring is the only state shared with the writer
+    void submit(Command command) const;
+    void run();
+    // returns false for Stop
+    bool apply(Command& command);
+    // blocks until the ring has something, called by the writer only
+    void sleep();
+
+    // polls of an empty ring before the writer goes to sleep
+    static constexpr int kSpins = 1024;
+
+    OrderBook m_book;
+    mutable MpscRing<Command> m_ring;
+
+    mutable std::mutex m_sleepMutex;
+    mutable std::condition_variable m_wake;
+    mutable std::atomic<bool> m_sleeping { false };
+    std::thread m_writer;
+};
+
+#endif // ASYNCORDERCACHE_HPP
@@ -0,0 +1,216 @@
+#ifndef BASICORDERCACHE_HPP
+#define BASICORDERCACHE_HPP
+
+#include "order.hpp"
+#include "ordercachebatchinterface.hpp"
+#include "ordercacheinterface.hpp"
+#include "orderbook.hpp"
+#include "timingwheel.hpp"
+
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Lock policy of single threaded users (backtests, replays), every call compiles away.
+struct NoLock {
+    void lock() {}
+    bool try_lock() { return true; }
+    void unlock() {}
+};
+
+// Order cache put together at compile time. Book is the storage and index policy - OrderBook (columnar store, orderId
+// index, posting lists and matching aggregates) or anything else with its interface. Lock is the locking policy,
+// anything lockable: NoLock for single threaded processes or std::mutex (std::shared_mutex works too) when the cache
+// is shared. Sharded locking needs many books behind an orderId directory, that is ShardedOrderCache.
+//
+// None of the functions is virtual, a caller holding a BasicOrderCache gets the cache layer inlined. The OrderBook
+// functions are out of line in orderbook.cpp, they inline into the caller only with link time optimization, which
+// CMakeLists enables for Release builds.
+// OrderCacheAdapter puts it behind OrderCacheInterface when a virtual interface is needed after all.
+// OrderCacheImpl stays the full featured cache - stats, journal, snapshots and the worker pool.
+template <typename Book = OrderBook, typename Lock = std::mutex>
+class BasicOrderCache {
+public:
+    using BookType = Book;
+    using LockType = Lock;
+
+    void addOrder(Order order)
+    {
+        std::scoped_lock lock(m_lock);
+        m_book.add(order);
+    }
+
+    // see OrderCacheImpl, tick() is up to the caller - a backtest ticks with its simulated clock
+    void addOrder(Order order, expiry::Clock::time_point expiresAt)
+    {
+        std::scoped_lock lock(m_lock);
+        m_book.add(order, expiry::deadline(expiresAt));
+    }
+
+    std::vector<std::string> tick(expiry::Clock::time_point now)
+    {
+        std::scoped_lock lock(m_lock);
+        std::vector<std::string> removedIds;
+        m_book.expire(expiry::reading(now), &removedIds);
+        return removedIds;
+    }
+
+    void cancelOrder(const std::string& orderId)
+    {
+        std::scoped_lock lock(m_lock);
+        m_book.cancel(orderId);
+    }
+
+    void cancelOrdersForUser(const std::string& user)
+    {
+        std::scoped_lock lock(m_lock);
+        m_book.cancelForUser(user);
+    }
+
+    void cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty)
+    {
+        std::scoped_lock lock(m_lock);
+        m_book.cancelForSecIdWithMinimumQty(securityId, minQty);
+    }
+
+    unsigned int getMatchingSizeForSecurity(const std::string& securityId)
+    {
+        std::scoped_lock lock(m_lock);
+        return m_book.matchingSize(securityId);
+    }
+
+    unsigned int getMatchingSizeForSecurity2(const std::string& securityId)
+    {
+        std::scoped_lock lock(m_lock);
+        return m_book.match(securityId);
+    }
+
+    std::vector<Fill> matchSecurity(const std::string& securityId, MatchingMode mode = MatchingMode::Balanced)
+    {
+        std::scoped_lock lock(m_lock);
+        std::vector<Fill> fills;
+        m_book.match(securityId, nullptr, &fills, mode);
+        return fills;
+    }
+
+    std::vector<std::pair<std::string, unsigned int>> getTopMatchingSizes(size_t n) const
+    {
+        std::scoped_lock lock(m_lock);
+        return m_book.topMatchingSizes(n);
+    }
+
+    std::vector<Order> getAllOrders() const
+    {
+        std::scoped_lock lock(m_lock);
+        return m_book.orders();
+    }
+
+    std::vector<std::string> cancelOrdersForCompany(const std::string& company)
+    {
+        std::vector<std::string> removedIds;
+        std::scoped_lock lock(m_lock);
+        m_book.cancelForCompany(company, &removedIds);
+        return removedIds;
+    }
+
+    std::vector<std::string> cancelOrdersMatching(const OrderFilter& filter)
+    {
+        std::vector<std::string> removedIds;
+        std::scoped_lock lock(m_lock);
+        m_book.cancelMatching(filter, &removedIds);
+        return removedIds;
+    }
+
+    void addOrders(const std::vector<Order>& orders)
+    {
+        std::scoped_lock lock(m_lock);
+        m_book.add(orders);
+    }
+
+    void cancelOrders(const std::vector<std::string>& orderIds)
+    {
+        std::scoped_lock lock(m_lock);
+        m_book.cancel(orderIds);
+    }
+
+    void cancelOrdersForUsers(const std::vector<std::string>& users)
+    {
+        std::scoped_lock lock(m_lock);
+        m_book.cancelForUsers(users);
+    }
+
+    void reserve(size_t expectedOrders)
+    {
+        std::scoped_lock lock(m_lock);
+        m_book.reserve(expectedOrders);
+    }
+
+    void compact()
+    {
+        std::scoped_lock lock(m_lock);
+        m_book.compact();
+    }
+
+    MemoryUsage memoryUsage() const
+    {
+        std::scoped_lock lock(m_lock);
+        return m_book.memoryUsage();
+    }
+
+    void shrink()
+    {
+        std::scoped_lock lock(m_lock);
+        m_book.shrink();
+    }
+
+    // unlocked access to the book, for owners which know no other thread is around (e.g. with NoLock)
+    Book& book() { return m_book; }
+    const Book& book() const { return m_book; }
+
+private:
+    Book m_book;
+    mutable Lock m_lock;
+};
+
+// single threaded, lock free and devirtualized
+using BacktestOrderCache = BasicOrderCache<OrderBook, NoLock>;
+// thread safe, one lock around the book
+using LockedOrderCache = BasicOrderCache<OrderBook, std::mutex>;
+
+// Thin OrderCacheInterface/OrderCacheBatchInterface on top of a compile time composed cache. It is final, so calls
+// through the adapter type itself are devirtualized as well.
+template <typename Cache>
+class OrderCacheAdapter final : public OrderCacheInterface, public OrderCacheBatchInterface {
+public:
+    template <typename... Args>
+    explicit OrderCacheAdapter(Args&&... args)
+        : m_cache(std::forward<Args>(args)...)
+    {
+    }
+
+    // OrderCacheInterface interface
+    void addOrder(Order order) override { m_cache.addOrder(std::move(order)); }
+    void cancelOrder(const std::string& orderId) override { m_cache.cancelOrder(orderId); }
+    void cancelOrdersForUser(const std::string& user) override { m_cache.cancelOrdersForUser(user); }
+    void cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty) override
+    {
+        m_cache.cancelOrdersForSecIdWithMinimumQty(securityId, minQty);
+    }
+    unsigned int getMatchingSizeForSecurity(const std::string& securityId) override { return m_cache.getMatchingSizeForSecurity(securityId); }
+    unsigned int getMatchingSizeForSecurity2(const std::string& securityId) override { return m_cache.getMatchingSizeForSecurity2(securityId); }
+    std::vector<Order> getAllOrders() const override { return m_cache.getAllOrders(); }
+
+    // OrderCacheBatchInterface interface
+    void addOrders(const std::vector<Order>& orders) override { m_cache.addOrders(orders); }
+    void cancelOrders(const std::vector<std::string>& orderIds) override { m_cache.cancelOrders(orderIds); }
+    void cancelOrdersForUsers(const std::vector<std::string>& users) override { m_cache.cancelOrdersForUsers(users); }
+
+    Cache& cache() { return m_cache; }
+    const Cache& cache() const { return m_cache; }
+
+private:
+    Cache m_cache;
+};
+
+#endif // BASICORDERCACHE_HPP
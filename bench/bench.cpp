@@ -0,0 +1,324 @@
+// Microbenchmarks of OrderCacheInterface implementations plus a mixed multi-threaded workload.
+//
+// usage: bench [--orders N] [--securities N] [--users N] [--companies N] [--skew S] [--buy-ratio R] [--max-qty Q]
+//              [--mix add,cancel,cancelForUser,cancelForSecIdWithMinimumQty,matchingSize,matchingSize2,getAllOrders]
+//              [--ops N] [--threads N] [--impl NAME] [--seed N]
+//
+// Every line reports throughput and latency percentiles (ns) of one operation, mixed runs are repeated at 1, 2, 4 ...
+// up to --threads threads.
+
+#include "../basicordercache.hpp"
+#include "../latencyhistogram.hpp"
+#include "../ordercacheimpl.hpp"
+#include "../shardedordercache.hpp"
+#include "workload.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Implementation {
+    const char* name;
+    std::function<std::unique_ptr<OrderCacheInterface>()> make;
+};
+
+const std::vector<Implementation> kImplementations {
+    { "OrderCacheImpl", [] { return std::make_unique<OrderCacheImpl>(); } },
+    { "ShardedOrderCache", [] { return std::make_unique<ShardedOrderCache>(); } },
+    { "LockedOrderCache", [] { return std::make_unique<OrderCacheAdapter<LockedOrderCache>>(); } },
+};
+
+// keeps results of the measured calls alive
+std::atomic<uint64_t> g_sink { 0 };
+
+struct Options {
+    WorkloadConfig workload;
+    size_t ops { 200000 };
+    size_t threads { std::max(1u, std::thread::hardware_concurrency()) };
+    std::string implementation;
+};
+
+[[noreturn]] void usage(const char* error)
+{
+    std::fprintf(stderr, "bench: %s\n", error);
+    std::fprintf(stderr, "usage: bench [--orders N] [--securities N] [--users N] [--companies N] [--skew S] [--buy-ratio R] "
+                         "[--max-qty Q] [--mix w1,...,w7] [--ops N] [--threads N] [--impl NAME] [--seed N]\n");
+    std::exit(1);
+}
+
+Options parse(int argc, char** argv)
+{
+    Options options;
+    auto& workload = options.workload;
+    for (int i = 1; i < argc; i += 2) {
+        const std::string key = argv[i];
+        if (i + 1 >= argc) {
+            usage(("missing value of " + key).c_str());
+        }
+        const char* value = argv[i + 1];
+        if (key == "--orders") {
+            workload.orders = std::stoul(value);
+        } else if (key == "--securities") {
+            workload.securities = std::stoul(value);
+        } else if (key == "--users") {
+            workload.users = std::stoul(value);
+        } else if (key == "--companies") {
+            workload.companies = std::stoul(value);
+        } else if (key == "--skew") {
+            workload.skew = std::stod(value);
+        } else if (key == "--buy-ratio") {
+            workload.buyRatio = std::stod(value);
+        } else if (key == "--max-qty") {
+            workload.maxQty = std::stoul(value);
+        } else if (key == "--seed") {
+            workload.seed = std::stoull(value);
+        } else if (key == "--ops") {
+            options.ops = std::stoul(value);
+        } else if (key == "--threads") {
+            options.threads = std::max(1ul, std::stoul(value));
+        } else if (key == "--impl") {
+            options.implementation = value;
+        } else if (key == "--mix") {
+            std::vector<double> weights;
+            std::stringstream ss(value);
+            for (std::string weight; std::getline(ss, weight, ',');) {
+                weights.push_back(std::stod(weight));
+            }
+            if (weights.size() != 7) {
+                usage("--mix takes 7 weights");
+            }
+            workload.mix = { weights[0], weights[1], weights[2], weights[3], weights[4], weights[5], weights[6] };
+        } else {
+            usage(("unknown option " + key).c_str());
+        }
+    }
+    return options;
+}
+
+void report(const char* implementation, const char* benchmark, size_t threads, const LatencyHistogram& histogram, Clock::duration elapsed)
+{
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    std::printf("%-18s %-34s %7zu %10llu %14.0f %8llu %8llu %8llu %10llu\n", implementation, benchmark, threads,
+        static_cast<unsigned long long>(histogram.count()), seconds > 0 ? histogram.count() / seconds : 0.0,
+        static_cast<unsigned long long>(histogram.percentile(50)), static_cast<unsigned long long>(histogram.percentile(99)),
+        static_cast<unsigned long long>(histogram.percentile(99.9)), static_cast<unsigned long long>(histogram.max()));
+}
+
+template <typename F>
+void timed(LatencyHistogram& histogram, F&& f)
+{
+    const auto start = Clock::now();
+    f();
+    histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+class Bench {
+public:
+    Bench(const Options& options, const Workload& workload)
+        : m_options(options)
+        , m_workload(workload)
+    {
+        for (size_t i = 0; i < workload.config().securities; ++i) {
+            m_securityIds.push_back(Workload::securityId(i));
+        }
+        for (size_t i = 0; i < workload.config().users; ++i) {
+            m_users.push_back(Workload::user(i));
+        }
+        for (const auto& order : workload.orders()) {
+            m_orderIds.push_back(order.orderId());
+        }
+    }
+
+    void run(const Implementation& implementation)
+    {
+        m_name = implementation.name;
+        m_make = implementation.make;
+
+        single("addOrder", [&](OrderCacheInterface& cache, LatencyHistogram& histogram) {
+            for (const auto& order : m_workload.orders()) {
+                timed(histogram, [&] { cache.addOrder(order); });
+            }
+        }, false);
+
+        single("cancelOrder", [&](OrderCacheInterface& cache, LatencyHistogram& histogram) {
+            auto orderIds = m_orderIds;
+            std::shuffle(orderIds.begin(), orderIds.end(), std::mt19937_64(m_workload.config().seed));
+            for (const auto& orderId : orderIds) {
+                timed(histogram, [&] { cache.cancelOrder(orderId); });
+            }
+        });
+
+        single("cancelOrdersForUser", [&](OrderCacheInterface& cache, LatencyHistogram& histogram) {
+            for (const auto& user : m_users) {
+                timed(histogram, [&] { cache.cancelOrdersForUser(user); });
+            }
+        });
+
+        single("cancelOrdersForSecIdWithMinimumQty", [&](OrderCacheInterface& cache, LatencyHistogram& histogram) {
+            const unsigned int minQty = m_workload.config().maxQty / 2;
+            for (const auto& securityId : m_securityIds) {
+                timed(histogram, [&] { cache.cancelOrdersForSecIdWithMinimumQty(securityId, minQty); });
+            }
+        });
+
+        single("getMatchingSizeForSecurity", [&](OrderCacheInterface& cache, LatencyHistogram& histogram) {
+            // the call doesn't change the cache, repeat it to get as many samples as orders
+            const size_t rounds = std::max<size_t>(1, m_orderIds.size() / m_securityIds.size());
+            for (size_t round = 0; round < rounds; ++round) {
+                for (const auto& securityId : m_securityIds) {
+                    timed(histogram, [&] { g_sink += cache.getMatchingSizeForSecurity(securityId); });
+                }
+            }
+        });
+
+        single("getMatchingSizeForSecurity2", [&](OrderCacheInterface& cache, LatencyHistogram& histogram) {
+            for (const auto& securityId : m_securityIds) {
+                timed(histogram, [&] { g_sink += cache.getMatchingSizeForSecurity2(securityId); });
+            }
+        });
+
+        single("getAllOrders", [&](OrderCacheInterface& cache, LatencyHistogram& histogram) {
+            for (int i = 0; i < 10; ++i) {
+                timed(histogram, [&] { g_sink += cache.getAllOrders().size(); });
+            }
+        });
+
+        for (size_t threads = 1;; threads = std::min(threads * 2, m_options.threads)) {
+            mixed(threads);
+            if (threads == m_options.threads) {
+                break;
+            }
+        }
+    }
+
+private:
+    void fill(OrderCacheInterface& cache)
+    {
+        for (const auto& order : m_workload.orders()) {
+            cache.addOrder(order);
+        }
+    }
+
+    template <typename F>
+    void single(const char* benchmark, F&& f, bool filled = true)
+    {
+        auto cache = m_make();
+        if (filled) {
+            fill(*cache);
+        }
+        LatencyHistogram histogram;
+        const auto start = Clock::now();
+        f(*cache, histogram);
+        report(m_name, benchmark, 1, histogram, Clock::now() - start);
+    }
+
+    // every thread replays its own operation stream on a shared cache, threads add and cancel disjoint orders
+    void mixed(size_t threads)
+    {
+        auto cache = m_make();
+        const size_t ordersPerThread = m_orderIds.size() / threads;
+        std::vector<std::vector<Operation>> streams;
+        for (size_t t = 0; t < threads; ++t) {
+            streams.push_back(m_workload.operations(m_options.ops, t * ordersPerThread, ordersPerThread, m_workload.config().seed + t + 1));
+        }
+
+        std::vector<LatencyHistogram> histograms(threads);
+        std::atomic<size_t> ready { 0 };
+        std::atomic<bool> go { false };
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                ++ready;
+                while (!go) {
+                }
+                for (const auto& op : streams[t]) {
+                    timed(histograms[t], [&] { execute(*cache, op); });
+                }
+            });
+        }
+        while (ready != threads) {
+        }
+        const auto start = Clock::now();
+        go = true;
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        const auto elapsed = Clock::now() - start;
+
+        for (size_t t = 1; t < threads; ++t) {
+            histograms[0].merge(histograms[t]);
+        }
+        report(m_name, "mixed", threads, histograms[0], elapsed);
+    }
+
+    void execute(OrderCacheInterface& cache, const Operation& op)
+    {
+        switch (op.type) {
+        case OperationType::Add:
+            cache.addOrder(m_workload.orders()[op.index]);
+            break;
+        case OperationType::Cancel:
+            cache.cancelOrder(m_orderIds[op.index]);
+            break;
+        case OperationType::CancelForUser:
+            cache.cancelOrdersForUser(m_users[op.index]);
+            break;
+        case OperationType::CancelForSecIdWithMinimumQty:
+            cache.cancelOrdersForSecIdWithMinimumQty(m_securityIds[op.index], op.minQty);
+            break;
+        case OperationType::MatchingSize:
+            g_sink += cache.getMatchingSizeForSecurity(m_securityIds[op.index]);
+            break;
+        case OperationType::MatchingSize2:
+            g_sink += cache.getMatchingSizeForSecurity2(m_securityIds[op.index]);
+            break;
+        case OperationType::GetAllOrders:
+            g_sink += cache.getAllOrders().size();
+            break;
+        }
+    }
+
+    const Options& m_options;
+    const Workload& m_workload;
+    std::vector<std::string> m_securityIds;
+    std::vector<std::string> m_users;
+    std::vector<std::string> m_orderIds;
+
+    const char* m_name { nullptr };
+    std::function<std::unique_ptr<OrderCacheInterface>()> m_make;
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const Options options = parse(argc, argv);
+    const Workload workload(options.workload);
+    Bench bench(options, workload);
+
+    std::printf("%-18s %-34s %7s %10s %14s %8s %8s %8s %10s\n", "implementation", "benchmark", "threads", "ops", "ops/s", "p50",
+        "p99", "p99.9", "max");
+    bool found = false;
+    for (const auto& implementation : kImplementations) {
+        if (options.implementation.empty() || options.implementation == implementation.name) {
+            bench.run(implementation);
+            found = true;
+        }
+    }
+    if (!found) {
+        usage(("unknown implementation " + options.implementation).c_str());
+    }
+    return 0;
+}
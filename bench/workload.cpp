@@ -0,0 +1,97 @@
+#include "workload.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+ZipfDistribution::ZipfDistribution(size_t n, double skew)
+{
+    m_cdf.reserve(n);
+    double sum = 0;
+    for (size_t k = 0; k < n; ++k) {
+        sum += 1 / std::pow(static_cast<double>(k + 1), skew);
+        m_cdf.push_back(sum);
+    }
+    for (auto& p : m_cdf) {
+        p /= sum;
+    }
+}
+
+size_t ZipfDistribution::operator()(std::mt19937_64& rng) const
+{
+    const double u = std::uniform_real_distribution<double>(0, 1)(rng);
+    const auto it = std::lower_bound(m_cdf.begin(), m_cdf.end(), u);
+    return std::min(static_cast<size_t>(it - m_cdf.begin()), m_cdf.size() - 1);
+}
+
+Workload::Workload(const WorkloadConfig& config)
+    : m_config(config)
+    , m_securities(config.securities, config.skew)
+    , m_users(config.users, config.skew)
+{
+    std::mt19937_64 rng(config.seed);
+    const ZipfDistribution companies(config.companies, config.skew);
+    std::bernoulli_distribution buy(config.buyRatio);
+    std::uniform_int_distribution<unsigned int> qty(1, config.maxQty);
+
+    m_orders.reserve(config.orders);
+    for (size_t i = 0; i < config.orders; ++i) {
+        m_orders.emplace_back("OrdId" + std::to_string(i), securityId(m_securities(rng)), buy(rng) ? "Buy" : "Sell", qty(rng),
+            user(m_users(rng)), company(companies(rng)));
+    }
+}
+
+std::vector<Operation> Workload::operations(size_t count, size_t firstOrder, size_t orderCount, uint64_t seed) const
+{
+    const auto& mix = m_config.mix;
+    std::discrete_distribution<int> type({ mix.add, mix.cancel, mix.cancelForUser, mix.cancelForSecIdWithMinimumQty,
+        mix.matchingSize, mix.matchingSize2, mix.getAllOrders });
+    std::uniform_int_distribution<unsigned int> minQty(1, m_config.maxQty);
+    std::mt19937_64 rng(seed);
+
+    std::vector<Operation> out;
+    out.reserve(count);
+    // orders added by this stream and not cancelled yet, cancels pick a random one of them
+    std::vector<size_t> added;
+    size_t next = firstOrder;
+    const size_t last = firstOrder + orderCount;
+    // e.g. a mix of adds only runs out of orders
+    size_t skipped = 0;
+    while (out.size() < count && skipped < 1000) {
+        const size_t before = out.size();
+        auto op = static_cast<OperationType>(type(rng));
+        switch (op) {
+        case OperationType::Add:
+            if (next == last) {
+                break;
+            }
+            added.push_back(next);
+            out.push_back({ op, next++, 0 });
+            break;
+        case OperationType::Cancel: {
+            if (added.empty()) {
+                break;
+            }
+            const size_t pick = std::uniform_int_distribution<size_t>(0, added.size() - 1)(rng);
+            out.push_back({ op, added[pick], 0 });
+            added[pick] = added.back();
+            added.pop_back();
+            break;
+        }
+        case OperationType::CancelForUser:
+            out.push_back({ op, m_users(rng), 0 });
+            break;
+        case OperationType::CancelForSecIdWithMinimumQty:
+            out.push_back({ op, m_securities(rng), minQty(rng) });
+            break;
+        case OperationType::MatchingSize:
+        case OperationType::MatchingSize2:
+            out.push_back({ op, m_securities(rng), 0 });
+            break;
+        case OperationType::GetAllOrders:
+            out.push_back({ op, 0, 0 });
+            break;
+        }
+        skipped = out.size() == before ? skipped + 1 : 0;
+    }
+    return out;
+}
@@ -0,0 +1,88 @@
+#ifndef WORKLOAD_HPP
+#define WORKLOAD_HPP
+
+#include "../order.hpp"
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Synthetic order flow for the benchmarks. Securities, users and companies are drawn from Zipf distributions (a few
+// hot names and a long tail, like real flow), operations from a configurable mix.
+struct WorkloadConfig {
+    size_t orders { 100000 };
+    size_t securities { 1000 };
+    size_t users { 1000 };
+    size_t companies { 100 };
+    // Zipf exponent, 0 gives uniform names
+    double skew { 1.0 };
+    double buyRatio { 0.5 };
+    unsigned int maxQty { 10000 };
+    uint64_t seed { 42 };
+
+    // relative weights of the operations in the mixed workload
+    struct Mix {
+        double add { 60 };
+        double cancel { 30 };
+        double cancelForUser { 1 };
+        double cancelForSecIdWithMinimumQty { 2 };
+        double matchingSize { 5 };
+        double matchingSize2 { 1 };
+        double getAllOrders { 0.01 };
+    } mix;
+};
+
+enum class OperationType {
+    Add,
+    Cancel,
+    CancelForUser,
+    CancelForSecIdWithMinimumQty,
+    MatchingSize,
+    MatchingSize2,
+    GetAllOrders,
+};
+
+struct Operation {
+    OperationType type;
+    // index of the order to add or cancel, of the user or of the security
+    size_t index;
+    unsigned int minQty;
+};
+
+// samples 0..n-1 with P(k) ~ 1 / (k + 1)^skew
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t n, double skew);
+
+    size_t operator()(std::mt19937_64& rng) const;
+
+private:
+    std::vector<double> m_cdf;
+};
+
+class Workload {
+public:
+    explicit Workload(const WorkloadConfig& config);
+
+    const WorkloadConfig& config() const { return m_config; }
+
+    // config().orders orders with unique orderIds
+    const std::vector<Order>& orders() const { return m_orders; }
+
+    static std::string securityId(size_t index) { return "SecId" + std::to_string(index); }
+    static std::string user(size_t index) { return "User" + std::to_string(index); }
+    static std::string company(size_t index) { return "Company" + std::to_string(index); }
+
+    // operations for one thread drawn from the mix, it adds and cancels orders [firstOrder, firstOrder + orderCount)
+    // only, a cancel picks an order the same stream added before. Stops early when the mix can't produce more.
+    std::vector<Operation> operations(size_t count, size_t firstOrder, size_t orderCount, uint64_t seed) const;
+
+private:
+    WorkloadConfig m_config;
+    ZipfDistribution m_securities;
+    ZipfDistribution m_users;
+    std::vector<Order> m_orders;
+};
+
+#endif // WORKLOAD_HPP
@@ -0,0 +1,202 @@
+#include "cachestats.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+
+namespace {
+
+std::string format(const char* pattern, ...) __attribute__((format(printf, 1, 2)));
+
+std::string format(const char* pattern, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, pattern);
+    const int size = std::vsnprintf(buffer, sizeof(buffer), pattern, args);
+    va_end(args);
+    return std::string(buffer, size < 0 ? 0 : std::min<size_t>(size, sizeof(buffer) - 1));
+}
+
+unsigned long long ull(uint64_t value)
+{
+    return static_cast<unsigned long long>(value);
+}
+
+std::string json(const LatencyHistogram& histogram)
+{
+    return format(R"({"count": %llu, "mean": %.0f, "p50": %llu, "p90": %llu, "p99": %llu, "p99.9": %llu, "max": %llu})",
+        ull(histogram.count()), histogram.mean(), ull(histogram.percentile(50)), ull(histogram.percentile(90)),
+        ull(histogram.percentile(99)), ull(histogram.percentile(99.9)), ull(histogram.max()));
+}
+
+} // namespace
+
+const char* name(CacheOperation operation)
+{
+    switch (operation) {
+    case CacheOperation::AddOrder:
+        return "addOrder";
+    case CacheOperation::CancelOrder:
+        return "cancelOrder";
+    case CacheOperation::CancelOrdersForUser:
+        return "cancelOrdersForUser";
+    case CacheOperation::CancelOrdersForSecIdWithMinimumQty:
+        return "cancelOrdersForSecIdWithMinimumQty";
+    case CacheOperation::GetMatchingSizeForSecurity:
+        return "getMatchingSizeForSecurity";
+    case CacheOperation::GetMatchingSizeForSecurity2:
+        return "getMatchingSizeForSecurity2";
+    case CacheOperation::GetAllOrders:
+        return "getAllOrders";
+    case CacheOperation::AddOrders:
+        return "addOrders";
+    case CacheOperation::CancelOrders:
+        return "cancelOrders";
+    case CacheOperation::CancelOrdersForUsers:
+        return "cancelOrdersForUsers";
+    case CacheOperation::CancelOrdersForCompany:
+        return "cancelOrdersForCompany";
+    case CacheOperation::CancelOrdersMatching:
+        return "cancelOrdersMatching";
+    case CacheOperation::MatchSecurity:
+        return "matchSecurity";
+    case CacheOperation::ExpireOrders:
+        return "tick";
+    case CacheOperation::Count:
+        break;
+    }
+    return "unknown";
+}
+
+void OperationStats::merge(const OperationStats& other)
+{
+    calls += other.calls;
+    contended += other.contended;
+    work.scanned += other.work.scanned;
+    work.touched += other.work.touched;
+    latency.merge(other.latency);
+    lockWait.merge(other.lockWait);
+    lockHold.merge(other.lockHold);
+}
+
+void CacheStats::merge(const CacheStats& other)
+{
+    for (size_t i = 0; i < kCacheOperations; ++i) {
+        operations[i].merge(other.operations[i]);
+    }
+}
+
+std::string CacheStats::toText() const
+{
+    std::string out = format("%-34s %10s %10s %12s %12s %8s %8s %10s %8s %8s\n", "operation", "calls", "contended", "scanned",
+        "touched", "p50", "p99", "max", "wait p99", "hold p99");
+    for (size_t i = 0; i < kCacheOperations; ++i) {
+        const OperationStats& stats = operations[i];
+        if (stats.calls == 0) {
+            continue;
+        }
+        out += format("%-34s %10llu %10llu %12llu %12llu %8llu %8llu %10llu %8llu %8llu\n", name(static_cast<CacheOperation>(i)),
+            ull(stats.calls), ull(stats.contended), ull(stats.work.scanned), ull(stats.work.touched),
+            ull(stats.latency.percentile(50)), ull(stats.latency.percentile(99)), ull(stats.latency.max()),
+            ull(stats.lockWait.percentile(99)), ull(stats.lockHold.percentile(99)));
+    }
+    return out;
+}
+
+std::string CacheStats::toJson() const
+{
+    std::string out = "{";
+    for (size_t i = 0; i < kCacheOperations; ++i) {
+        const OperationStats& stats = operations[i];
+        out += format(R"(%s"%s": {"calls": %llu, "contended": %llu, "scanned": %llu, "touched": %llu, )", i ? ", " : "",
+            name(static_cast<CacheOperation>(i)), ull(stats.calls), ull(stats.contended), ull(stats.work.scanned), ull(stats.work.touched));
+        out += "\"latency\": " + json(stats.latency) + ", \"lockWait\": " + json(stats.lockWait) + ", \"lockHold\": " + json(stats.lockHold) + "}";
+    }
+    return out + "}";
+}
+
+CacheStats StatsRecorder::stats() const
+{
+    CacheStats out;
+#ifdef ORDERCACHE_STATS
+    std::scoped_lock lock(m_threadsMutex);
+    for (const auto& [thread, stats] : m_threads) {
+        std::scoped_lock threadLock(stats->mutex);
+        out.merge(stats->stats);
+    }
+#endif
+    return out;
+}
+
+void StatsRecorder::reset()
+{
+#ifdef ORDERCACHE_STATS
+    std::scoped_lock lock(m_threadsMutex);
+    for (const auto& [thread, stats] : m_threads) {
+        std::scoped_lock threadLock(stats->mutex);
+        stats->stats = {};
+    }
+#endif
+}
+
+#ifdef ORDERCACHE_STATS
+void StatsRecorder::record(const Call& call)
+{
+    const auto ns = [](Clock::duration duration) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    };
+    const uint64_t latency = ns(Clock::now() - call.m_start);
+
+    ThreadStats& thread = threadStats();
+    std::scoped_lock lock(thread.mutex);
+    OperationStats& stats = thread.stats.operations[static_cast<size_t>(call.m_operation)];
+    ++stats.calls;
+    stats.contended += call.m_contended;
+    stats.work.scanned += call.m_work.scanned;
+    stats.work.touched += call.m_work.touched;
+    stats.latency.record(latency);
+    stats.lockWait.record(ns(call.m_wait));
+    stats.lockHold.record(ns(call.m_hold));
+}
+
+StatsRecorder::ThreadStats& StatsRecorder::threadStats()
+{
+    struct Recent {
+        uint64_t recorder { 0 };
+        ThreadStats* stats { nullptr };
+    };
+    // the recorders this thread recorded into last, only a miss takes the mutex of the recorder
+    thread_local std::array<Recent, 4> recent;
+    thread_local size_t next = 0;
+    for (const Recent& entry : recent) {
+        if (entry.recorder == m_id) {
+            return *entry.stats;
+        }
+    }
+
+    ThreadStats* stats = nullptr;
+    {
+        const std::thread::id self = std::this_thread::get_id();
+        std::scoped_lock lock(m_threadsMutex);
+        for (const auto& [thread, threadStats] : m_threads) {
+            if (thread == self) {
+                stats = threadStats.get();
+            }
+        }
+        if (!stats) {
+            m_threads.emplace_back(self, std::make_unique<ThreadStats>());
+            stats = m_threads.back().second.get();
+        }
+    }
+    recent[next++ % recent.size()] = { m_id, stats };
+    return *stats;
+}
+
+uint64_t StatsRecorder::newId()
+{
+    static std::atomic<uint64_t> last { 0 };
+    return ++last;
+}
+#endif
@@ -0,0 +1,214 @@
+#ifndef CACHESTATS_HPP
+#define CACHESTATS_HPP
+
+#include "latencyhistogram.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Hot path instrumentation of the caches: per operation call latency, time spent waiting for and holding locks,
+// how often a lock was contended and how many orders the operation scanned and touched. It is compiled in only with
+// ORDERCACHE_STATS defined (cmake -DORDERCACHE_STATS=ON), otherwise StatsRecorder is empty, StatsLock is a plain
+// unique_lock and OrderBook doesn't count anything, so the release hot path pays nothing.
+#ifdef ORDERCACHE_STATS
+constexpr bool kStatsEnabled = true;
+#else
+constexpr bool kStatsEnabled = false;
+#endif
+
+// OrderCacheInterface and OrderCacheBatchInterface operations plus the mass cancels, fill-generating matches and order
+// expiry of the caches
+enum class CacheOperation : uint8_t {
+    AddOrder,
+    CancelOrder,
+    CancelOrdersForUser,
+    CancelOrdersForSecIdWithMinimumQty,
+    GetMatchingSizeForSecurity,
+    GetMatchingSizeForSecurity2,
+    GetAllOrders,
+    AddOrders,
+    CancelOrders,
+    CancelOrdersForUsers,
+    CancelOrdersForCompany,
+    CancelOrdersMatching,
+    MatchSecurity,
+    ExpireOrders,
+    // number of operations, not one itself
+    Count,
+};
+
+constexpr size_t kCacheOperations = static_cast<size_t>(CacheOperation::Count);
+
+const char* name(CacheOperation operation);
+
+// work done by an OrderBook, scanned counts orders (or slots of a column sweep) visited, touched counts orders written:
+// added, removed, moved by compaction and both sides of every fill
+struct WorkCounters {
+    uint64_t scanned { 0 };
+    uint64_t touched { 0 };
+};
+
+struct OperationStats {
+    uint64_t calls { 0 };
+    // calls which found a lock taken
+    uint64_t contended { 0 };
+    WorkCounters work;
+    // per call in ns, lock wait and hold are summed over all locks the call took
+    LatencyHistogram latency;
+    LatencyHistogram lockWait;
+    LatencyHistogram lockHold;
+
+    void merge(const OperationStats& other);
+};
+
+struct CacheStats {
+    std::array<OperationStats, kCacheOperations> operations;
+
+    const OperationStats& operator[](CacheOperation operation) const { return operations[static_cast<size_t>(operation)]; }
+
+    void merge(const CacheStats& other);
+    // one line per called operation, latencies in ns
+    std::string toText() const;
+    // {"addOrder": {"calls": .., "contended": .., "scanned": .., "touched": .., "latency": {..}, ..}, ..}
+    std::string toJson() const;
+};
+
+// Collects stats of a cache. A Call is created at the start of every operation and records into the stats of its
+// operation when it is destroyed. Every thread records into stats of its own, stats() merges them - threads calling
+// the cache (e.g. different shards of a ShardedOrderCache) never contend for the recorder.
+class StatsRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    class Call {
+    public:
+        Call(StatsRecorder& recorder, CacheOperation operation)
+#ifdef ORDERCACHE_STATS
+            : m_recorder(recorder)
+            , m_operation(operation)
+            , m_start(Clock::now())
+#endif
+        {
+            static_cast<void>(recorder);
+            static_cast<void>(operation);
+        }
+
+#ifdef ORDERCACHE_STATS
+        ~Call() { m_recorder.record(*this); }
+#endif
+
+        Call(const Call&) = delete;
+        Call& operator=(const Call&) = delete;
+
+    private:
+        template <typename Mutex>
+        friend class StatsLock;
+        friend class StatsRecorder;
+
+#ifdef ORDERCACHE_STATS
+        StatsRecorder& m_recorder;
+        const CacheOperation m_operation;
+        const Clock::time_point m_start;
+        Clock::duration m_wait {};
+        Clock::duration m_hold {};
+        bool m_contended { false };
+        WorkCounters m_work;
+#endif
+    };
+
+    // copy of the stats so far, all zero without ORDERCACHE_STATS
+    CacheStats stats() const;
+    void reset();
+
+private:
+#ifdef ORDERCACHE_STATS
+    // stats recorded by one thread, the mutex is contended only by stats() and reset()
+    struct ThreadStats {
+        std::mutex mutex;
+        CacheStats stats;
+    };
+
+    void record(const Call& call);
+    ThreadStats& threadStats();
+    static uint64_t newId();
+
+    // tells recorders apart in the lookup caches of the threads, addresses get reused
+    const uint64_t m_id { newId() };
+    mutable std::mutex m_threadsMutex;
+    std::vector<std::pair<std::thread::id, std::unique_ptr<ThreadStats>>> m_threads;
+#endif
+};
+
+// unique_lock which adds the time spent waiting for and holding the mutex to the call. If given, the work done by
+// the book between locking and unlocking is added as well - the counters are read only while the mutex is held.
+template <typename Mutex>
+class StatsLock {
+public:
+    StatsLock(Mutex& mutex, StatsRecorder::Call& call, const WorkCounters* work = nullptr)
+        : m_mutex(mutex)
+#ifdef ORDERCACHE_STATS
+        , m_call(call)
+        , m_work(work)
+#endif
+    {
+        static_cast<void>(call);
+        static_cast<void>(work);
+#ifdef ORDERCACHE_STATS
+        const auto start = StatsRecorder::Clock::now();
+        if (!m_mutex.try_lock()) {
+            m_call.m_contended = true;
+            m_mutex.lock();
+        }
+        m_locked = StatsRecorder::Clock::now();
+        m_call.m_wait += m_locked - start;
+        if (m_work) {
+            m_workBefore = *m_work;
+        }
+#else
+        m_mutex.lock();
+#endif
+        m_owns = true;
+    }
+
+    ~StatsLock()
+    {
+        if (m_owns) {
+            unlock();
+        }
+    }
+
+    StatsLock(const StatsLock&) = delete;
+    StatsLock& operator=(const StatsLock&) = delete;
+
+    void unlock()
+    {
+#ifdef ORDERCACHE_STATS
+        if (m_work) {
+            m_call.m_work.scanned += m_work->scanned - m_workBefore.scanned;
+            m_call.m_work.touched += m_work->touched - m_workBefore.touched;
+        }
+        m_call.m_hold += StatsRecorder::Clock::now() - m_locked;
+#endif
+        m_mutex.unlock();
+        m_owns = false;
+    }
+
+private:
+    Mutex& m_mutex;
+    bool m_owns { false };
+#ifdef ORDERCACHE_STATS
+    StatsRecorder::Call& m_call;
+    const WorkCounters* m_work;
+    WorkCounters m_workBefore;
+    StatsRecorder::Clock::time_point m_locked;
+#endif
+};
+
+#endif // CACHESTATS_HPP
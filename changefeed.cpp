@@ -0,0 +1,60 @@
+#include "changefeed.hpp"
+
+#include <algorithm>
+#include <utility>
+
+ChangeSubscription::ChangeSubscription(ChangeFilter filter, size_t capacity)
+    : m_filter(std::move(filter))
+    , m_batches(capacity)
+{
+}
+
+std::vector<OrderChange> ChangeSubscription::poll()
+{
+    std::vector<OrderChange> out;
+    drain([&out](const std::vector<OrderChange>& batch) { out.insert(out.end(), batch.begin(), batch.end()); });
+    return out;
+}
+
+void ChangeSubscription::push(std::vector<OrderChange>& batch)
+{
+    const size_t size = batch.size();
+    if (!m_batches.tryPush(std::move(batch))) {
+        m_droppedBatches.fetch_add(1, std::memory_order_relaxed);
+        m_droppedChanges.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+void ChangePublisher::subscribe(std::shared_ptr<ChangeSubscription> subscription)
+{
+    m_targets.push_back({ std::move(subscription), {} });
+}
+
+void ChangePublisher::unsubscribe(const ChangeSubscription* subscription)
+{
+    m_targets.erase(std::remove_if(m_targets.begin(), m_targets.end(),
+                        [subscription](const Target& target) { return target.subscription.get() == subscription; }),
+        m_targets.end());
+}
+
+void ChangePublisher::publish(OrderChange::Type type, unsigned int qty, std::string_view orderId,
+    std::string_view securityId, std::string_view side, std::string_view user, std::string_view company)
+{
+    for (auto& target : m_targets) {
+        if (target.subscription->filter().matches(securityId, user)) {
+            target.pending.push_back({ type, qty, std::string(orderId), std::string(securityId), std::string(side),
+                std::string(user), std::string(company) });
+        }
+    }
+}
+
+void ChangePublisher::flush()
+{
+    for (auto& target : m_targets) {
+        if (!target.pending.empty()) {
+            target.subscription->push(target.pending);
+            // moved into the ring or dropped
+            target.pending.clear();
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef CHANGEFEED_HPP
+#define CHANGEFEED_HPP
+
+#include "mpscring.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Change data capture of a cache: subscribers get every order the cache adds, every qty change and every removal
+// instead of polling getAllOrders() and diffing.
+//
+// The book publishes changes of an operation into a ChangePublisher while the cache's lock is held, the publisher
+// buffers them per subscription and the cache flushes the buffers once the operation is done - a batch per operation
+// and subscription, pushed into the subscription's lock-free ring (mpscring.hpp). The subscriber drains the ring from
+// its own thread whenever it likes, publishing never waits for it: a batch which doesn't fit the ring is dropped and
+// counted, the subscriber has to resync from a snapshot then. Without subscriptions publishing is a single branch.
+
+struct OrderChange {
+    enum class Type : uint8_t {
+        // the order was added, qty is its qty
+        Add,
+        // the order was (partially) filled by getMatchingSizeForSecurity2, qty is what is left
+        Fill,
+        // the order left the book, cancelled or fully filled (a Fill to 0 comes first then), qty is what it had left
+        Remove,
+    };
+
+    Type type { Type::Add };
+    unsigned int qty { 0 };
+    std::string orderId;
+    std::string securityId;
+    std::string side;
+    std::string user;
+    std::string company;
+};
+
+// Changes a subscription gets, empty conditions match anything
+struct ChangeFilter {
+    std::optional<std::string> securityId;
+    std::optional<std::string> user;
+
+    bool matches(std::string_view security, std::string_view orderUser) const
+    {
+        return (!securityId || *securityId == security) && (!user || *user == orderUser);
+    }
+};
+
+class ChangeSubscription {
+public:
+    // capacity is the number of batches the ring holds, rounded up to a power of two
+    explicit ChangeSubscription(ChangeFilter filter, size_t capacity = 1024);
+
+    const ChangeFilter& filter() const { return m_filter; }
+
+    // Subscriber thread only. Calls f(const std::vector<OrderChange>&) for every batch in the ring, in the order they
+    // were published - batches of different shards of a ShardedOrderCache may interleave, changes of an order never
+    // do. Returns the number of batches.
+    template <typename F>
+    size_t drain(F&& f)
+    {
+        size_t count = 0;
+        while (m_batches.tryPop(m_batch)) {
+            f(static_cast<const std::vector<OrderChange>&>(m_batch));
+            ++count;
+        }
+        return count;
+    }
+    // subscriber thread only, all changes in the ring
+    std::vector<OrderChange> poll();
+
+    // batches (and changes in them) dropped because the ring was full, the subscriber missed them
+    uint64_t droppedBatches() const { return m_droppedBatches.load(std::memory_order_relaxed); }
+    uint64_t droppedChanges() const { return m_droppedChanges.load(std::memory_order_relaxed); }
+
+private:
+    friend class ChangePublisher;
+
+    // publishers, the batch is left untouched when it is dropped
+    void push(std::vector<OrderChange>& batch);
+
+    const ChangeFilter m_filter;
+    MpscRing<std::vector<OrderChange>> m_batches;
+    std::atomic<uint64_t> m_droppedBatches { 0 };
+    std::atomic<uint64_t> m_droppedChanges { 0 };
+    // last drained batch
+    std::vector<OrderChange> m_batch;
+};
+
+// Publishing side, one per book. It isn't thread safe - the owner's lock covers it along with the book.
+class ChangePublisher {
+public:
+    bool active() const { return !m_targets.empty(); }
+
+    void subscribe(std::shared_ptr<ChangeSubscription> subscription);
+    // pending changes of the subscription are dropped
+    void unsubscribe(const ChangeSubscription* subscription);
+
+    // buffers the change for every subscription whose filter matches it
+    void publish(OrderChange::Type type, unsigned int qty, std::string_view orderId, std::string_view securityId,
+        std::string_view side, std::string_view user, std::string_view company);
+    // hands the buffered changes to the subscriptions, a batch each
+    void flush();
+
+private:
+    struct Target {
+        std::shared_ptr<ChangeSubscription> subscription;
+        std::vector<OrderChange> pending;
+    };
+
+    std::vector<Target> m_targets;
+};
+
+#endif // CHANGEFEED_HPP
@@ -0,0 +1,127 @@
+#ifndef INDEXEDHEAP_HPP
+#define INDEXEDHEAP_HPP
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// Binary max-heap of keys by priority, indexed by key: every key knows its position in the heap, so a changed priority
+// is sifted into place and a key is taken out in O(log n). Keys are dense unsigned integers (SymbolIds, local indexes),
+// positions are stored as keys too. Equal priorities are ordered by KeyBefore. A key with priority 0 isn't in the heap.
+template <typename Key, typename Priority, typename KeyBefore = std::less<Key>>
+class IndexedHeap {
+public:
+    struct Entry {
+        Priority priority;
+        Key key;
+    };
+
+    static bool before(const Entry& lhs, const Entry& rhs)
+    {
+        return lhs.priority > rhs.priority || (lhs.priority == rhs.priority && KeyBefore()(lhs.key, rhs.key));
+    }
+
+    // sets the priority of the key, 0 takes it out of the heap
+    void update(Key key, Priority priority)
+    {
+        if (key >= m_positions.size()) {
+            m_positions.resize(static_cast<size_t>(key) + 1, npos);
+        }
+        const Key position = m_positions[key];
+        if (position == npos) {
+            if (priority) {
+                m_heap.push_back({ priority, key });
+                siftUp(m_heap.size() - 1);
+            }
+            return;
+        }
+        if (!priority) {
+            remove(position);
+            return;
+        }
+
+        const Priority old = m_heap[position].priority;
+        m_heap[position].priority = priority;
+        priority > old ? siftUp(position) : siftDown(position);
+    }
+
+    void clear()
+    {
+        m_heap.clear();
+        m_positions.clear();
+    }
+
+    void shrink()
+    {
+        m_heap.shrink_to_fit();
+        m_positions.shrink_to_fit();
+    }
+
+    size_t size() const { return m_heap.size(); }
+    // entries in heap order, the biggest at 0 and the children of position p at 2p + 1 and 2p + 2
+    const Entry& operator[](size_t position) const { return m_heap[position]; }
+
+    size_t memoryBytes() const { return m_heap.capacity() * sizeof(Entry) + m_positions.capacity() * sizeof(Key); }
+
+private:
+    static constexpr Key npos = static_cast<Key>(-1);
+
+    void place(size_t position, const Entry& entry)
+    {
+        m_heap[position] = entry;
+        m_positions[entry.key] = static_cast<Key>(position);
+    }
+
+    void remove(size_t position)
+    {
+        m_positions[m_heap[position].key] = npos;
+        const Entry last = m_heap.back();
+        m_heap.pop_back();
+        if (position == m_heap.size()) {
+            return;
+        }
+        place(position, last);
+        siftUp(position);
+        siftDown(m_positions[last.key]);
+    }
+
+    void siftUp(size_t position)
+    {
+        const Entry entry = m_heap[position];
+        while (position > 0) {
+            const size_t parent = (position - 1) / 2;
+            if (!before(entry, m_heap[parent])) {
+                break;
+            }
+            place(position, m_heap[parent]);
+            position = parent;
+        }
+        place(position, entry);
+    }
+
+    void siftDown(size_t position)
+    {
+        const Entry entry = m_heap[position];
+        for (;;) {
+            size_t child = 2 * position + 1;
+            if (child >= m_heap.size()) {
+                break;
+            }
+            if (child + 1 < m_heap.size() && before(m_heap[child + 1], m_heap[child])) {
+                ++child;
+            }
+            if (!before(m_heap[child], entry)) {
+                break;
+            }
+            place(position, m_heap[child]);
+            position = child;
+        }
+        place(position, entry);
+    }
+
+    std::vector<Entry> m_heap;
+    // heap position by key, npos for keys which aren't in the heap
+    std::vector<Key> m_positions;
+};
+
+#endif // INDEXEDHEAP_HPP
@@ -0,0 +1,364 @@
+#include "journal.hpp"
+#include "mappedfile.hpp"
+#include "snapshotfile.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// kMagic and the first sequence number, the records follow
+constexpr size_t kHeaderSize = Journal::kMagic.size() + 8;
+// length and checksum of a record
+constexpr size_t kRecordHeaderSize = 8;
+
+// CRC-32 with the polynomial of zlib, crc continues the checksum of bytes before data
+constexpr std::array<uint32_t, 256> kCrcTable = [] {
+    std::array<uint32_t, 256> table {};
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+uint32_t crc32(std::string_view data, uint32_t crc = 0)
+{
+    crc = ~crc;
+    for (const char c : data) {
+        crc = kCrcTable[(crc ^ static_cast<unsigned char>(c)) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// reads the record at offset into event and returns the offset following it, 0 for a torn or damaged record
+size_t readRecord(std::string_view data, size_t offset, orderlog::Event& event)
+{
+    if (data.size() - offset < kRecordHeaderSize) {
+        return 0;
+    }
+    snapshotfile::Reader header(data.substr(offset, kRecordHeaderSize));
+    const uint32_t length = header.u32();
+    const uint32_t checksum = header.u32();
+    if (length == 0 || data.size() - offset - kRecordHeaderSize < length) {
+        return 0;
+    }
+    const std::string_view bytes = data.substr(offset + kRecordHeaderSize, length);
+    if (crc32(bytes, crc32(data.substr(offset, 4))) != checksum) {
+        return 0;
+    }
+    auto reader = orderlog::Reader::binaryEvents(bytes.data(), bytes.size());
+    try {
+        if (!reader.next(event) || reader.offset() != bytes.size()) {
+            return 0;
+        }
+    } catch (const std::runtime_error&) {
+        return 0;
+    }
+    return offset + kRecordHeaderSize + length;
+}
+
+struct Contents {
+    uint64_t firstSequence { 0 };
+    uint64_t nextSequence { 0 };
+    // bytes up to the end of the last complete event
+    size_t size { 0 };
+    // where the event with the requested sequence number starts
+    size_t offset { 0 };
+};
+
+// sequence number of the first event of a journal, checks the header
+uint64_t firstSequence(std::string_view data)
+{
+    if (data.size() < kHeaderSize || data.substr(0, Journal::kMagic.size()) != Journal::kMagic) {
+        throw std::runtime_error("not an order cache journal");
+    }
+    return snapshotfile::Reader(data.substr(Journal::kMagic.size(), 8)).u64();
+}
+
+// walks the events of a journal, f (if given) is called for the ones with sequence number >= from. A torn or damaged
+// event ends the journal.
+Contents scan(std::string_view data, uint64_t from, const std::function<void(const orderlog::Event&)>* f)
+{
+    Contents out;
+    out.firstSequence = firstSequence(data);
+    out.nextSequence = out.firstSequence;
+    out.size = kHeaderSize;
+    out.offset = out.size;
+    for (orderlog::Event event;;) {
+        if (out.nextSequence == from) {
+            out.offset = out.size;
+        }
+        const size_t end = readRecord(data, out.size, event);
+        if (end == 0) {
+            break;
+        }
+        if (f && out.nextSequence >= from) {
+            (*f)(event);
+        }
+        ++out.nextSequence;
+        out.size = end;
+    }
+    if (from >= out.nextSequence) {
+        out.offset = out.size;
+    }
+    return out;
+}
+
+bool exists(const std::string& path)
+{
+    struct stat info {};
+    return ::stat(path.c_str(), &info) == 0;
+}
+
+} // namespace
+
+Journal::Journal(const std::string& path, Options options, uint64_t firstSequence)
+    : m_path(path)
+    , m_options(options)
+{
+    Contents contents;
+    if (exists(path)) {
+        const MappedFile file(path);
+        contents = scan({ file.data(), file.size() }, 0, nullptr);
+    }
+
+    if (contents.size == 0 || contents.nextSequence < firstSequence) {
+        create(firstSequence, {});
+        m_firstSequence = firstSequence;
+        m_nextSequence = firstSequence;
+    } else if (contents.firstSequence > firstSequence) {
+        // events before the journal would be missing for good once events after them are appended
+        throw std::runtime_error(path + " starts at event " + std::to_string(contents.firstSequence) + ", events from "
+            + std::to_string(firstSequence) + " are missing");
+    } else {
+        m_fd = ::open(path.c_str(), O_WRONLY | O_APPEND);
+        // cut off a torn event left by a crash
+        if (m_fd < 0 || ::ftruncate(m_fd, contents.size) != 0) {
+            const int error = errno;
+            if (m_fd >= 0) {
+                ::close(m_fd);
+            }
+            throw std::system_error(error, std::generic_category(), path);
+        }
+        m_firstSequence = contents.firstSequence;
+        m_nextSequence = contents.nextSequence;
+    }
+    m_committedSequence = m_nextSequence;
+    m_writer = std::thread(&Journal::run, this);
+}
+
+Journal::~Journal()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeWriter.notify_one();
+    m_writer.join();
+    ::close(m_fd);
+}
+
+uint64_t Journal::append(const orderlog::Event& event)
+{
+    std::scoped_lock lock(m_mutex);
+    if (m_error) {
+        throw std::system_error(m_error, std::generic_category(), m_path);
+    }
+    if (m_batch.empty()) {
+        m_batchStart = std::chrono::steady_clock::now();
+        m_wakeWriter.notify_one();
+    }
+    // the record header is filled in once the length of the event is known
+    const size_t start = m_batch.size();
+    m_batch.append(kRecordHeaderSize, '\0');
+    try {
+        orderlog::appendBinary(m_batch, event);
+        if (m_batch.size() - start - kRecordHeaderSize > UINT32_MAX) {
+            throw std::length_error("journal event too long");
+        }
+    } catch (...) {
+        m_batch.resize(start);
+        throw;
+    }
+    std::string header;
+    snapshotfile::Writer(header).u32(static_cast<uint32_t>(m_batch.size() - start - kRecordHeaderSize));
+    const std::string_view bytes = std::string_view(m_batch).substr(start + kRecordHeaderSize);
+    snapshotfile::Writer(header).u32(crc32(bytes, crc32(header)));
+    m_batch.replace(start, kRecordHeaderSize, header);
+    if (m_batch.size() >= m_options.batchBytes) {
+        m_wakeWriter.notify_one();
+    }
+    return m_nextSequence++;
+}
+
+void Journal::wait(uint64_t sequence)
+{
+    if (!m_options.waitForCommit) {
+        return;
+    }
+
+    std::unique_lock lock(m_mutex);
+    if (m_committedSequence <= sequence) {
+        // whoever waits doesn't let the batch sit out maxDelay, events appended while this batch is being written
+        // make up the next one
+        m_flushRequested = true;
+        m_wakeWriter.notify_one();
+        m_committed.wait(lock, [this, sequence] { return m_committedSequence > sequence || m_error; });
+    }
+    if (m_error) {
+        throw std::system_error(m_error, std::generic_category(), m_path);
+    }
+}
+
+void Journal::flush()
+{
+    std::unique_lock lock(m_mutex);
+    const uint64_t sequence = m_nextSequence;
+    if (m_committedSequence < sequence) {
+        m_flushRequested = true;
+        m_wakeWriter.notify_one();
+        m_committed.wait(lock, [this, sequence] { return m_committedSequence >= sequence || m_error; });
+    }
+    if (m_error) {
+        throw std::system_error(m_error, std::generic_category(), m_path);
+    }
+}
+
+uint64_t Journal::nextSequence() const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_nextSequence;
+}
+
+void Journal::discardBefore(uint64_t sequence)
+{
+    std::unique_lock lock(m_mutex);
+    // appenders wait on the mutex while the current batch is written here and the file is replaced
+    m_committed.wait(lock, [this] { return !m_writing; });
+    if (!m_batch.empty() && !m_error) {
+        m_error = write(m_batch);
+        m_batch.clear();
+        m_committedSequence = m_nextSequence;
+        m_committed.notify_all();
+    }
+    if (m_error) {
+        throw std::system_error(m_error, std::generic_category(), m_path);
+    }
+    if (sequence <= m_firstSequence) {
+        return;
+    }
+    sequence = std::min(sequence, m_nextSequence);
+
+    const MappedFile file(m_path);
+    const std::string_view data(file.data(), file.size());
+    const Contents contents = scan(data, sequence, nullptr);
+    create(sequence, data.substr(contents.offset, contents.size - contents.offset));
+    m_firstSequence = sequence;
+}
+
+uint64_t Journal::replay(const std::string& path, uint64_t from, const std::function<void(const orderlog::Event&)>& f)
+{
+    if (!exists(path)) {
+        return from;
+    }
+    const MappedFile file(path);
+    const std::string_view data(file.data(), file.size());
+    const uint64_t first = firstSequence(data);
+    if (from < first) {
+        throw std::runtime_error(path + " starts at event " + std::to_string(first) + ", events from " + std::to_string(from)
+            + " are missing");
+    }
+    // a snapshot newer than the whole journal covers it
+    return std::max(from, scan(data, from, &f).nextSequence);
+}
+
+void Journal::run()
+{
+    std::unique_lock lock(m_mutex);
+    for (;;) {
+        if (m_batch.empty()) {
+            if (m_stop) {
+                return;
+            }
+            m_wakeWriter.wait(lock);
+            continue;
+        }
+        const auto deadline = m_batchStart + m_options.maxDelay;
+        if (!m_stop && !m_flushRequested && m_batch.size() < m_options.batchBytes && std::chrono::steady_clock::now() < deadline) {
+            m_wakeWriter.wait_until(lock, deadline);
+            continue;
+        }
+
+        std::swap(m_batch, m_spare);
+        const uint64_t committed = m_nextSequence;
+        m_flushRequested = false;
+        m_writing = true;
+        lock.unlock();
+        const int error = write(m_spare);
+        m_spare.clear();
+        lock.lock();
+        m_error = m_error ? m_error : error;
+        m_writing = false;
+        m_committedSequence = committed;
+        m_committed.notify_all();
+    }
+}
+
+int Journal::write(const std::string& batch) const
+{
+    for (size_t written = 0; written < batch.size();) {
+        const ssize_t result = ::write(m_fd, batch.data() + written, batch.size() - written);
+        if (result < 0 && errno != EINTR) {
+            return errno;
+        }
+        written += result > 0 ? result : 0;
+    }
+    return m_options.sync && ::fdatasync(m_fd) != 0 ? errno : 0;
+}
+
+void Journal::create(uint64_t firstSequence, std::string_view events)
+{
+    std::string header { kMagic };
+    snapshotfile::Writer(header).u64(firstSequence);
+
+    // written aside and renamed, so the journal is never found without its header
+    const std::string temporary = m_path + ".tmp";
+    const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0;
+    for (std::string_view part : { std::string_view(header), events }) {
+        ok = ok && ::write(fd, part.data(), part.size()) == static_cast<ssize_t>(part.size());
+    }
+    ok = ok && ::fsync(fd) == 0;
+    if (!ok || ::rename(temporary.c_str(), m_path.c_str()) != 0) {
+        const int error = errno;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        ::unlink(temporary.c_str());
+        throw std::system_error(error, std::generic_category(), m_path);
+    }
+    ::close(fd);
+    // the rename itself only becomes durable with the directory
+    snapshotfile::syncDirectory(m_path);
+
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+    // the descriptor of the renamed file appends to the journal
+    m_fd = ::open(m_path.c_str(), O_WRONLY | O_APPEND);
+    if (m_fd < 0) {
+        throw std::system_error(errno, std::generic_category(), m_path);
+    }
+}
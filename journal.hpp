@@ -0,0 +1,101 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include "orderlog.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Append-only write-ahead journal of cache mutations with group commit. Events are encoded as a binary order log
+// (orderlog.hpp) into an in-memory batch, a background thread writes a batch with one write() and one fdatasync()
+// once it is big enough or its oldest event waited long enough, so many operations share the cost of a single sync.
+// Every event gets a sequence number, the file starts at the first sequence it holds so events covered by a snapshot
+// can be dropped (discardBefore()).
+//
+// File: kMagic, the sequence number of the first event (uint64, little endian), then a record per event: its length
+// (uint32), a CRC-32 of the length and the event bytes (uint32) and the event encoded as in a binary order log, without
+// the log's magic. A crash in the middle of a write leaves a torn or zeroed tail behind, which fails the length or the
+// checksum check - the journal ends before it and opening the journal cuts it off.
+class Journal {
+public:
+    static constexpr std::string_view kMagic { "OCJRNL\x02\0", 8 };
+
+    struct Options {
+        // a batch is written once it holds that many bytes or its first event waited maxDelay
+        size_t batchBytes { 64 * 1024 };
+        std::chrono::microseconds maxDelay { 200 };
+        // fdatasync() every batch, otherwise written batches reach only the page cache
+        bool sync { true };
+        // wait() blocks until the batch of the event is written (and synced), otherwise a crash loses at most the
+        // last maxDelay worth of events
+        bool waitForCommit { true };
+    };
+
+    // Opens the journal for appending, creating it if it doesn't exist. firstSequence is the sequence number of the
+    // first event of a new journal - the one following the loaded snapshot, an existing journal ending before it
+    // holds only events the snapshot covers and is started anew. An existing journal starting after it misses the
+    // events in between, it throws std::runtime_error.
+    Journal(const std::string& path, Options options, uint64_t firstSequence = 0);
+    explicit Journal(const std::string& path)
+        : Journal(path, Options())
+    {
+    }
+    // writes what is left in the batch
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // adds the event to the current batch, returns its sequence number
+    uint64_t append(const orderlog::Event& event);
+    // blocks until the event with that sequence number is committed unless waitForCommit is off, throws
+    // std::system_error if writing the journal failed
+    void wait(uint64_t sequence);
+    // commits everything appended so far
+    void flush();
+
+    uint64_t nextSequence() const;
+
+    // drops events before sequence - they are covered by a snapshot - by rewriting the rest into a new file
+    void discardBefore(uint64_t sequence);
+
+    // calls f for every complete event of the journal at path with sequence number >= from, a missing file is an
+    // empty journal. Returns the sequence number following the last event (from if the journal ends before it).
+    // Throws std::runtime_error before calling f when the journal starts after from, the events in between are lost.
+    static uint64_t replay(const std::string& path, uint64_t from, const std::function<void(const orderlog::Event&)>& f);
+
+private:
+    void run();
+    // writes and syncs the batch, returns errno of a failure or 0
+    int write(const std::string& batch) const;
+    // replaces the file with a new one holding the given events, opens it for appending
+    void create(uint64_t firstSequence, std::string_view events);
+
+    const std::string m_path;
+    const Options m_options;
+    int m_fd { -1 };
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeWriter;
+    std::condition_variable m_committed;
+    std::string m_batch;
+    // the other buffer, swapped with m_batch when a batch is picked up for writing
+    std::string m_spare;
+    std::chrono::steady_clock::time_point m_batchStart;
+    uint64_t m_firstSequence { 0 };
+    uint64_t m_nextSequence { 0 };
+    uint64_t m_committedSequence { 0 };
+    bool m_writing { false };
+    bool m_flushRequested { false };
+    bool m_stop { false };
+    int m_error { 0 };
+    std::thread m_writer;
+};
+
+#endif // JOURNAL_HPP
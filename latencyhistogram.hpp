@@ -0,0 +1,85 @@
+#ifndef LATENCYHISTOGRAM_HPP
+#define LATENCYHISTOGRAM_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear histogram of latencies in nanoseconds (HdrHistogram-like). Every power of two range is split into 32
+// linear buckets, so a recorded value is known within ~3% whatever its magnitude. Recording is a couple of
+// instructions and doesn't allocate, histograms of many threads are merged afterwards.
+class LatencyHistogram {
+public:
+    static constexpr unsigned kSubBits = 5;
+    static constexpr unsigned kSubBuckets = 1u << kSubBits;
+    static constexpr size_t kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+    void record(uint64_t value)
+    {
+        ++m_counts[index(value)];
+        ++m_count;
+        m_sum += value;
+        m_max = value > m_max ? value : m_max;
+    }
+
+    void merge(const LatencyHistogram& other)
+    {
+        for (size_t i = 0; i < kBuckets; ++i) {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        m_max = other.m_max > m_max ? other.m_max : m_max;
+    }
+
+    void reset() { *this = {}; }
+
+    uint64_t count() const { return m_count; }
+    uint64_t max() const { return m_max; }
+    double mean() const { return m_count ? static_cast<double>(m_sum) / m_count : 0; }
+
+    // upper bound of the bucket holding the given percentile (0..100), never above max()
+    uint64_t percentile(double p) const
+    {
+        if (m_count == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(p / 100 * m_count + 0.5);
+        rank = rank == 0 ? 1 : rank;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += m_counts[i];
+            if (seen >= rank) {
+                const uint64_t bound = upperBound(i);
+                return bound < m_max ? bound : m_max;
+            }
+        }
+        return m_max;
+    }
+
+private:
+    static size_t index(uint64_t value)
+    {
+        if (value < 2 * kSubBuckets) {
+            return static_cast<size_t>(value);
+        }
+        const unsigned shift = 63 - __builtin_clzll(value) - kSubBits;
+        return (shift + 1) * kSubBuckets + static_cast<size_t>((value >> shift) - kSubBuckets);
+    }
+
+    static uint64_t upperBound(size_t index)
+    {
+        if (index < 2 * kSubBuckets) {
+            return index;
+        }
+        const unsigned shift = static_cast<unsigned>(index / kSubBuckets - 1);
+        return ((index % kSubBuckets + kSubBuckets + 1) << shift) - 1;
+    }
+
+    std::array<uint64_t, kBuckets> m_counts {};
+    uint64_t m_count { 0 };
+    uint64_t m_sum { 0 };
+    uint64_t m_max { 0 };
+};
+
+#endif // LATENCYHISTOGRAM_HPP
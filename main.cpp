@@ -1,4 +1,277 @@
-int main()
+// Replays a recorded order log (see orderlog.hpp) into an order cache and reports sustained events/sec and per event
+// type latency percentiles (ns). Matching sizes are summed into a checksum so two runs can be compared.
+//
+// usage: OrderCache <order log> [--impl OrderCacheImpl|ShardedOrderCache|BacktestOrderCache|SharedOrderCache] [--convert <output log>] [--stats text|json]
+//
+// The cache's memory footprint is reported after the replay, see memoryusage.hpp.
+// BacktestOrderCache is replayed through its own type, without locks and virtual calls, it has no --stats.
+// SharedOrderCache is replayed into a shared memory segment named after the process, removed after the replay.
+// Good-till-time orders (AE events) are added with their expiry, the replay doesn't tick - a journal has their expiries
+// as cancels already.
+// --convert rewrites the log in the other format (CSV <-> binary) instead of replaying it.
+// --stats dumps the cache's own instrumentation after the replay, see cachestats.hpp - it needs a build with
+// ORDERCACHE_STATS.
+
+#include "basicordercache.hpp"
+#include "cachestats.hpp"
+#include "latencyhistogram.hpp"
+#include "mappedfile.hpp"
+#include "memoryusage.hpp"
+#include "ordercacheimpl.hpp"
+#include "orderlog.hpp"
+#include "shardedordercache.hpp"
+#include "sharedordercache.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int usage()
 {
+    std::fprintf(stderr, "usage: OrderCache <order log> [--impl OrderCacheImpl|ShardedOrderCache|BacktestOrderCache|SharedOrderCache] [--convert <output log>] [--stats text|json]\n");
+    return 1;
+}
+
+void convert(orderlog::Reader& reader, const std::string& path)
+{
+    std::string out;
+    const bool binary = !reader.binary();
+    if (binary) {
+        out += orderlog::kBinaryMagic;
+    }
+    size_t count = 0;
+    for (orderlog::Event event; reader.next(event); ++count) {
+        binary ? orderlog::appendBinary(out, event) : orderlog::appendCsv(out, event);
+    }
+
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file || std::fwrite(out.data(), 1, out.size(), file) != out.size() || std::fclose(file) != 0) {
+        throw std::runtime_error("can't write " + path);
+    }
+    std::printf("%zu events written to %s (%s)\n", count, path.c_str(), binary ? "binary" : "CSV");
+}
+
+unsigned int filled(const std::vector<Fill>& fills)
+{
+    unsigned int out = 0;
+    for (const auto& fill : fills) {
+        out += fill.qty;
+    }
+    return out;
+}
+
+// matchSecurity isn't part of OrderCacheInterface, the caches with a balanced matching engine replay it
+unsigned int matchBalanced(OrderCacheInterface& cache, const std::string& securityId)
+{
+    if (auto* impl = dynamic_cast<OrderCacheImpl*>(&cache)) {
+        return filled(impl->matchSecurity(securityId, MatchingMode::Balanced));
+    }
+    if (auto* impl = dynamic_cast<ShardedOrderCache*>(&cache)) {
+        return filled(impl->matchSecurity(securityId, MatchingMode::Balanced));
+    }
+    throw std::runtime_error("the cache can't replay matchSecurity events");
+}
+
+unsigned int matchBalanced(BacktestOrderCache& cache, const std::string& securityId)
+{
+    return filled(cache.matchSecurity(securityId, MatchingMode::Balanced));
+}
+
+// the same for good-till-time orders
+void addExpiring(OrderCacheInterface& cache, Order order, expiry::Clock::time_point expiresAt)
+{
+    if (auto* impl = dynamic_cast<OrderCacheImpl*>(&cache)) {
+        return impl->addOrder(std::move(order), expiresAt);
+    }
+    if (auto* impl = dynamic_cast<ShardedOrderCache*>(&cache)) {
+        return impl->addOrder(std::move(order), expiresAt);
+    }
+    throw std::runtime_error("the cache can't replay addOrder events with an expiry");
+}
+
+void addExpiring(BacktestOrderCache& cache, Order order, expiry::Clock::time_point expiresAt)
+{
+    cache.addOrder(std::move(order), expiresAt);
+}
+
+// Cache is OrderCacheInterface or a compile time composed cache which gets every call inlined
+template <typename Cache>
+void replay(orderlog::Reader& reader, Cache& cache)
+{
+    std::vector<LatencyHistogram> histograms(orderlog::kEventTypes);
+    uint64_t checksum = 0;
+
+    auto timed = [&histograms](orderlog::EventType type, auto&& f) {
+        const auto start = Clock::now();
+        f();
+        histograms[static_cast<size_t>(type)].record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    };
+
+    const auto start = Clock::now();
+    for (orderlog::Event event; reader.next(event);) {
+        // the interface takes strings, building them is part of ingesting an event but not of the measured call
+        switch (event.type) {
+        case orderlog::EventType::Add: {
+            Order order(std::string(event.orderId), std::string(event.securityId), std::string(event.side), event.qty,
+                std::string(event.user), std::string(event.company));
+            timed(event.type, [&] { cache.addOrder(std::move(order)); });
+            continue;
+        }
+        case orderlog::EventType::Cancel: {
+            const std::string orderId(event.orderId);
+            timed(event.type, [&] { cache.cancelOrder(orderId); });
+            continue;
+        }
+        case orderlog::EventType::CancelForUser: {
+            const std::string user(event.user);
+            timed(event.type, [&] { cache.cancelOrdersForUser(user); });
+            continue;
+        }
+        case orderlog::EventType::CancelForSecIdWithMinimumQty: {
+            const std::string securityId(event.securityId);
+            timed(event.type, [&] { cache.cancelOrdersForSecIdWithMinimumQty(securityId, event.qty); });
+            continue;
+        }
+        case orderlog::EventType::MatchingSize: {
+            const std::string securityId(event.securityId);
+            timed(event.type, [&] { checksum += cache.getMatchingSizeForSecurity(securityId); });
+            continue;
+        }
+        case orderlog::EventType::MatchingSize2: {
+            const std::string securityId(event.securityId);
+            timed(event.type, [&] { checksum += cache.getMatchingSizeForSecurity2(securityId); });
+            continue;
+        }
+        case orderlog::EventType::MatchBalanced: {
+            const std::string securityId(event.securityId);
+            timed(event.type, [&] { checksum += matchBalanced(cache, securityId); });
+            continue;
+        }
+        case orderlog::EventType::AddWithExpiry: {
+            Order order(std::string(event.orderId), std::string(event.securityId), std::string(event.side), event.qty,
+                std::string(event.user), std::string(event.company));
+            const auto expiresAt = expiry::timePoint(event.expiresAt);
+            timed(event.type, [&] { addExpiring(cache, std::move(order), expiresAt); });
+            continue;
+        }
+        }
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    uint64_t events = 0;
+    for (const auto& histogram : histograms) {
+        events += histogram.count();
+    }
+    std::printf("%llu events in %.3f s, %.0f events/s, %zu orders left, matching size checksum %llu\n",
+        static_cast<unsigned long long>(events), seconds, seconds > 0 ? events / seconds : 0.0, cache.getAllOrders().size(),
+        static_cast<unsigned long long>(checksum));
+    std::printf("%-34s %10s %8s %8s %8s %8s %10s\n", "event", "count", "mean", "p50", "p99", "p99.9", "max");
+    for (size_t type = 0; type < orderlog::kEventTypes; ++type) {
+        const auto& histogram = histograms[type];
+        if (histogram.count()) {
+            std::printf("%-34s %10llu %8.0f %8llu %8llu %8llu %10llu\n", orderlog::name(static_cast<orderlog::EventType>(type)),
+                static_cast<unsigned long long>(histogram.count()), histogram.mean(),
+                static_cast<unsigned long long>(histogram.percentile(50)), static_cast<unsigned long long>(histogram.percentile(99)),
+                static_cast<unsigned long long>(histogram.percentile(99.9)), static_cast<unsigned long long>(histogram.max()));
+        }
+    }
+}
+
+void report(const MemoryUsage& usage)
+{
+    std::printf("memory %zu bytes (records %zu, orderId strings %zu, symbols %zu, indexes %zu), peak %zu, %.1f bytes/order, "
+                "%zu of %zu slots live\n",
+        usage.total(), usage.orderRecords, usage.orderIdStrings, usage.symbols, usage.indexes, usage.peak, usage.bytesPerOrder(),
+        usage.orders, usage.capacity);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc % 2 != 0) {
+        return usage();
+    }
+    std::string implementation = "OrderCacheImpl";
+    std::string output;
+    std::string statsFormat;
+    for (int i = 2; i < argc; i += 2) {
+        const std::string key = argv[i];
+        if (key == "--impl") {
+            implementation = argv[i + 1];
+        } else if (key == "--convert") {
+            output = argv[i + 1];
+        } else if (key == "--stats" && (std::string(argv[i + 1]) == "text" || std::string(argv[i + 1]) == "json")) {
+            statsFormat = argv[i + 1];
+        } else {
+            return usage();
+        }
+    }
+
+    std::unique_ptr<OrderCacheInterface> cache;
+    std::unique_ptr<BacktestOrderCache> backtestCache;
+    std::function<CacheStats()> stats;
+    std::function<MemoryUsage()> memory;
+    if (implementation == "BacktestOrderCache") {
+        backtestCache = std::make_unique<BacktestOrderCache>();
+        memory = [impl = backtestCache.get()] { return impl->memoryUsage(); };
+    } else if (implementation == "OrderCacheImpl") {
+        auto impl = std::make_unique<OrderCacheImpl>();
+        stats = [impl = impl.get()] { return impl->stats(); };
+        memory = [impl = impl.get()] { return impl->memoryUsage(); };
+        cache = std::move(impl);
+    } else if (implementation == "ShardedOrderCache") {
+        auto impl = std::make_unique<ShardedOrderCache>();
+        stats = [impl = impl.get()] { return impl->stats(); };
+        memory = [impl = impl.get()] { return impl->memoryUsage(); };
+        cache = std::move(impl);
+    } else if (implementation == "SharedOrderCache") {
+        auto impl = std::make_unique<SharedOrderCache>("/OrderCache." + std::to_string(::getpid()));
+        memory = [impl = impl.get()] { return impl->memoryUsage(); };
+        cache = std::move(impl);
+    } else {
+        return usage();
+    }
+    if (!statsFormat.empty() && !kStatsEnabled) {
+        std::fprintf(stderr, "OrderCache: --stats needs a build with ORDERCACHE_STATS\n");
+        return 1;
+    }
+    if (!statsFormat.empty() && !stats) {
+        std::fprintf(stderr, "OrderCache: %s has no --stats\n", implementation.c_str());
+        return 1;
+    }
+
+    try {
+        const MappedFile log(argv[1]);
+        orderlog::Reader reader(log.data(), log.size());
+        if (!output.empty()) {
+            convert(reader, output);
+        } else {
+            if (backtestCache) {
+                replay(reader, *backtestCache);
+            } else {
+                replay(reader, *cache);
+            }
+            report(memory());
+            if (!statsFormat.empty()) {
+                const CacheStats out = stats();
+                std::printf("%s\n", (statsFormat == "json" ? out.toJson() : out.toText()).c_str());
+            }
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "OrderCache: %s\n", e.what());
+        return 1;
+    }
     return 0;
 }
@@ -0,0 +1,47 @@
+#include "mappedfile.hpp"
+
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), path);
+    }
+
+    struct stat info {};
+    if (::fstat(fd, &info) < 0) {
+        const int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), path);
+    }
+
+    // mmap() of an empty file fails, there is nothing to map anyway
+    if (info.st_size > 0) {
+        void* data = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            const int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), path);
+        }
+        // the log is read once front to back
+        ::madvise(data, info.st_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const char*>(data);
+        m_size = info.st_size;
+    }
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data) {
+        ::munmap(const_cast<char*>(m_data), m_size);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <string>
+
+// Read-only memory mapping of a whole file (POSIX), the kernel pages it in as it is read so big logs are parsed in place
+// without copying them through stream buffers. Throws std::system_error when the file can't be opened or mapped.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const char* m_data { nullptr };
+    size_t m_size { 0 };
+};
+
+#endif // MAPPEDFILE_HPP
@@ -0,0 +1,48 @@
+#include "matchingaggregates.hpp"
+
+#include <algorithm>
+
+void MatchingAggregates::add(SymbolId company, bool sell, unsigned int qty)
+{
+    CompanyQty& totals = m_companies[company];
+    ++totals.orders;
+    (sell ? totals.sell : totals.buy) += qty;
+    (sell ? m_sell : m_buy) += qty;
+    if (m_dominantValid) {
+        m_dominant = std::max(m_dominant, totals.sell + totals.buy);
+    }
+}
+
+void MatchingAggregates::remove(SymbolId company, bool sell, unsigned int qty)
+{
+    auto it = m_companies.find(company);
+    shrinking(it->second);
+    (sell ? it->second.sell : it->second.buy) -= qty;
+    (sell ? m_sell : m_buy) -= qty;
+    if (--it->second.orders == 0) {
+        m_companies.erase(it);
+    }
+}
+
+void MatchingAggregates::reduce(SymbolId company, bool sell, unsigned int qty)
+{
+    CompanyQty& totals = m_companies.find(company)->second;
+    shrinking(totals);
+    (sell ? totals.sell : totals.buy) -= qty;
+    (sell ? m_sell : m_buy) -= qty;
+}
+
+unsigned int MatchingAggregates::matchingSize() const
+{
+    if (!m_dominantValid) {
+        m_dominant = 0;
+        for (const auto& [company, totals] : m_companies) {
+            m_dominant = std::max(m_dominant, totals.sell + totals.buy);
+        }
+        m_dominantValid = true;
+    }
+    if (!m_sell || !m_buy) {
+        return 0;
+    }
+    return static_cast<unsigned int>(std::min({ m_sell, m_buy, m_sell + m_buy - m_dominant }));
+}
@@ -0,0 +1,53 @@
+#ifndef MATCHINGAGGREGATES_HPP
+#define MATCHINGAGGREGATES_HPP
+
+#include "memoryusage.hpp"
+#include "symboltable.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+
+// Running per-company sell/buy quantity totals of a single security, maintained by the OrderBook on every add, cancel
+// and fill so the matching size can be answered without touching individual orders.
+//
+// A sell order can match any buy order of another company, thus the matchable quantity is a max flow in a bipartite graph
+// with company-exclusion edges. Its value is min(S, B, S + B - max(s_c + b_c)) where S/B are sell/buy totals and s_c/b_c
+// totals of a single company c - whatever isn't matched within the dominant company has to be matched outside of it.
+// The biggest s_c + b_c is cached: adds can only raise it, so it is recomputed in O(#companies of the security) only after
+// the dominant company itself shrank, otherwise matchingSize() is O(1).
+class MatchingAggregates {
+public:
+    void add(SymbolId company, bool sell, unsigned int qty);
+    // qty is the remaining quantity of the removed order
+    void remove(SymbolId company, bool sell, unsigned int qty);
+    // order stays in the book with a smaller quantity
+    void reduce(SymbolId company, bool sell, unsigned int qty);
+
+    unsigned int matchingSize() const;
+    bool empty() const { return m_companies.empty(); }
+    size_t companies() const { return m_companies.size(); }
+    size_t memoryBytes() const { return memory::hashMapBytes(m_companies); }
+
+private:
+    struct CompanyQty {
+        uint64_t sell { 0 };
+        uint64_t buy { 0 };
+        size_t orders { 0 };
+    };
+
+    // called before the company's totals go down
+    void shrinking(const CompanyQty& totals)
+    {
+        if (totals.sell + totals.buy == m_dominant) {
+            m_dominantValid = false;
+        }
+    }
+
+    std::unordered_map<SymbolId, CompanyQty> m_companies;
+    uint64_t m_sell { 0 };
+    uint64_t m_buy { 0 };
+    mutable uint64_t m_dominant { 0 };
+    mutable bool m_dominantValid { true };
+};
+
+#endif // MATCHINGAGGREGATES_HPP
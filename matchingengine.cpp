@@ -0,0 +1,163 @@
+#include "matchingengine.hpp"
+
+#include <algorithm>
+
+void BalancedMatcher::clear()
+{
+    for (const SymbolId company : m_companyIds) {
+        m_companyIndex[company] = npos;
+    }
+    m_companyIds.clear();
+    m_companies.clear();
+    m_remaining.clear();
+    m_next.clear();
+    m_sell = 0;
+    m_buy = 0;
+    m_all.clear();
+    m_sellers.clear();
+    m_buyers.clear();
+    m_executions.clear();
+}
+
+void BalancedMatcher::add(SymbolId company, bool sell, unsigned int qty)
+{
+    const uint32_t order = static_cast<uint32_t>(m_remaining.size());
+    m_remaining.push_back(qty);
+    m_next.push_back(npos);
+    if (!qty) {
+        return;
+    }
+
+    if (company >= m_companyIndex.size()) {
+        m_companyIndex.resize(company + 1, npos);
+    }
+    uint32_t& local = m_companyIndex[company];
+    if (local == npos) {
+        local = static_cast<uint32_t>(m_companies.size());
+        m_companies.emplace_back();
+        m_companyIds.push_back(company);
+    }
+    Company& entry = m_companies[local];
+    uint32_t& head = sell ? entry.sellHead : entry.buyHead;
+    uint32_t& tail = sell ? entry.sellTail : entry.buyTail;
+    if (tail == npos) {
+        head = order;
+    } else {
+        m_next[tail] = order;
+    }
+    tail = order;
+    (sell ? entry.sell : entry.buy) += qty;
+    (sell ? m_sell : m_buy) += qty;
+}
+
+const std::vector<BalancedMatcher::Execution>& BalancedMatcher::match()
+{
+    m_executions.clear();
+    for (uint32_t company = 0; company < m_companies.size(); ++company) {
+        rank(company);
+    }
+
+    while (m_sell && m_buy) {
+        const uint32_t dominant = best(m_all);
+        const uint64_t size = std::min({ m_sell, m_buy, m_sell + m_buy - m_companies[dominant].total() });
+        if (!size) {
+            break;
+        }
+        const Company& company = m_companies[dominant];
+        const bool sellFirst = company.sell >= company.buy;
+        bool traded = false;
+        for (const bool sell : { sellFirst, !sellFirst }) {
+            if (!(sell ? company.sell : company.buy)) {
+                continue;
+            }
+            const uint32_t counterparty = best(sell ? m_buyers : m_sellers, dominant);
+            if (counterparty == npos) {
+                continue;
+            }
+            // trading more would leave the third biggest company with less to match than it needs
+            const uint32_t third = best(m_all, dominant, counterparty);
+            const uint64_t cap = m_sell + m_buy - size - (third != npos ? m_companies[third].total() : 0);
+            if (cap) {
+                execute(dominant, sell, counterparty, cap);
+                traded = true;
+                break;
+            }
+        }
+        // a step is always possible while size > 0, this only guards against looping forever
+        if (!traded) {
+            break;
+        }
+    }
+    return m_executions;
+}
+
+size_t BalancedMatcher::memoryBytes() const
+{
+    return m_companyIndex.capacity() * sizeof(uint32_t) + m_companyIds.capacity() * sizeof(SymbolId)
+        + m_companies.capacity() * sizeof(Company) + m_remaining.capacity() * sizeof(unsigned int)
+        + m_next.capacity() * sizeof(uint32_t) + m_all.memoryBytes() + m_sellers.memoryBytes() + m_buyers.memoryBytes()
+        + m_executions.capacity() * sizeof(Execution);
+}
+
+void BalancedMatcher::shrink()
+{
+    clear();
+    m_companyIndex.clear();
+    m_companyIndex.shrink_to_fit();
+    m_companyIds.shrink_to_fit();
+    m_companies.shrink_to_fit();
+    m_remaining.shrink_to_fit();
+    m_next.shrink_to_fit();
+    m_all.shrink();
+    m_sellers.shrink();
+    m_buyers.shrink();
+    m_executions.shrink_to_fit();
+}
+
+void BalancedMatcher::execute(uint32_t company, bool sell, uint32_t counterparty, uint64_t cap)
+{
+    Company& seller = m_companies[sell ? company : counterparty];
+    Company& buyer = m_companies[sell ? counterparty : company];
+    const uint32_t sellOrder = seller.sellHead;
+    const uint32_t buyOrder = buyer.buyHead;
+    const unsigned int qty = static_cast<unsigned int>(
+        std::min<uint64_t>({ m_remaining[sellOrder], m_remaining[buyOrder], cap }));
+    m_executions.push_back({ sellOrder, buyOrder, qty });
+
+    m_remaining[sellOrder] -= qty;
+    m_remaining[buyOrder] -= qty;
+    seller.sell -= qty;
+    buyer.buy -= qty;
+    m_sell -= qty;
+    m_buy -= qty;
+    if (!m_remaining[sellOrder]) {
+        seller.sellHead = m_next[sellOrder];
+    }
+    if (!m_remaining[buyOrder]) {
+        buyer.buyHead = m_next[buyOrder];
+    }
+    rank(company);
+    rank(counterparty);
+}
+
+void BalancedMatcher::rank(uint32_t company)
+{
+    const Company& entry = m_companies[company];
+    m_all.update(company, entry.total());
+    m_sellers.update(company, entry.sell ? entry.total() : 0);
+    m_buyers.update(company, entry.buy ? entry.total() : 0);
+}
+
+uint32_t BalancedMatcher::best(const Heap& heap, uint32_t excluded, uint32_t other)
+{
+    // with at most two companies excluded the answer is one of the three biggest, those sit in the top three levels
+    const size_t end = std::min<size_t>(heap.size(), 7);
+    const Heap::Entry* out = nullptr;
+    for (size_t position = 0; position < end; ++position) {
+        const Heap::Entry& entry = heap[position];
+        if (entry.key != excluded && entry.key != other && (!out || Heap::before(entry, *out))) {
+            out = &entry;
+        }
+    }
+    return out ? out->key : npos;
+}
@@ -0,0 +1,100 @@
+#ifndef MATCHINGENGINE_HPP
+#define MATCHINGENGINE_HPP
+
+#include "indexedheap.hpp"
+#include "symboltable.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// an execution between a sell and a buy order of different companies
+struct Fill {
+    std::string sellOrderId;
+    std::string buyOrderId;
+    unsigned int qty { 0 };
+
+    bool operator==(const Fill& other) const
+    {
+        return qty == other.qty && sellOrderId == other.sellOrderId && buyOrderId == other.buyOrderId;
+    }
+};
+
+enum class MatchingMode : uint8_t {
+    // getMatchingSizeForSecurity2 as it always was: every sell order in insertion order walks the buy orders in
+    // insertion order, O(sells * buys). It can leave matchable quantity behind when it pairs up the wrong orders.
+    Greedy,
+    // BalancedMatcher, trades exactly the matching size of MatchingAggregates in O((S + B) log C)
+    Balanced,
+};
+
+// Fill-generating matching of a single security which trades the most quantity the company-exclusion rule allows.
+//
+// Orders are bucketed by company into sell and buy queues in insertion order. Every step takes the company with the
+// biggest remaining quantity (sells + buys) and matches the front order of its bigger side against the front order of
+// the biggest company with quantity on the other side. A step trades at most what keeps the third biggest company
+// matchable - min(S, B, S + B - max(s_c + b_c)) stays reachable after every step, so the matcher always ends at the
+// maximum. Every step fills an order or makes the third company binding, companies sit in indexed max-heaps keyed by
+// their totals, so matching S + B orders of C companies costs O((S + B) log C). The result only depends on the orders
+// and their insertion order, ties go to the company which showed up first.
+class BalancedMatcher {
+public:
+    struct Execution {
+        // indexes of the orders in the order they were added
+        uint32_t sell;
+        uint32_t buy;
+        unsigned int qty;
+    };
+
+    // forgets the orders of the previous match, buffers are kept
+    void clear();
+    // orders of the security in insertion order, orders with qty 0 don't take part
+    void add(SymbolId company, bool sell, unsigned int qty);
+    // executions in the order they happen, every order is filled at most up to its qty
+    const std::vector<Execution>& match();
+
+    size_t memoryBytes() const;
+    void shrink();
+
+private:
+    static constexpr uint32_t npos = static_cast<uint32_t>(-1);
+
+    struct Company {
+        uint64_t sell { 0 };
+        uint64_t buy { 0 };
+        // queues of order indexes threaded through m_next, npos when empty
+        uint32_t sellHead { npos };
+        uint32_t sellTail { npos };
+        uint32_t buyHead { npos };
+        uint32_t buyTail { npos };
+
+        uint64_t total() const { return sell + buy; }
+    };
+
+    // companies by their total, ties to the lower index
+    using Heap = IndexedHeap<uint32_t, uint64_t>;
+
+    // biggest company of the heap other than the excluded ones, npos when there is none
+    static uint32_t best(const Heap& heap, uint32_t excluded = npos, uint32_t other = npos);
+
+    void execute(uint32_t company, bool sell, uint32_t counterparty, uint64_t cap);
+    // refreshes the heaps after the company's totals went down
+    void rank(uint32_t company);
+
+    // local company index by SymbolId, npos for companies without orders in this match
+    std::vector<uint32_t> m_companyIndex;
+    std::vector<SymbolId> m_companyIds;
+    std::vector<Company> m_companies;
+    // remaining qty and the next order of the same company and side, by order index
+    std::vector<unsigned int> m_remaining;
+    std::vector<uint32_t> m_next;
+    uint64_t m_sell { 0 };
+    uint64_t m_buy { 0 };
+    Heap m_all;
+    Heap m_sellers;
+    Heap m_buyers;
+    std::vector<Execution> m_executions;
+};
+
+#endif // MATCHINGENGINE_HPP
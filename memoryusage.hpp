@@ -0,0 +1,61 @@
+#ifndef MEMORYUSAGE_HPP
+#define MEMORYUSAGE_HPP
+
+#include <cstddef>
+#include <string>
+
+// Footprint of a cache in bytes, split by component. Everything the cache holds is counted, including slack: reserved
+// but unused capacity, tombstones, pooled segments and free blocks of the arena - shrink() gives most of it back.
+// Segments kept alive only by snapshots belong to their readers and aren't counted.
+struct MemoryUsage {
+    // live orders and slots including tombstones
+    size_t orders { 0 };
+    size_t capacity { 0 };
+
+    // segment columns and posting list links, pooled segments included
+    size_t orderRecords { 0 };
+    // heap blocks of orderId strings too long for the small string buffer
+    size_t orderIdStrings { 0 };
+    // names, chunks and hash maps of the symbol tables
+    size_t symbols { 0 };
+    // orderId index (arena and bucket arrays), posting list heads, matching aggregates, scratch buffers and the
+    // orderId directory of a sharded cache
+    size_t indexes { 0 };
+
+    // highest total() seen so far, memory goes down only through shrink() which records the peak before releasing.
+    // A sharded cache sums peaks of its books and the directory, so it is an estimate there.
+    size_t peak { 0 };
+
+    size_t total() const { return orderRecords + orderIdStrings + symbols + indexes; }
+    double bytesPerOrder() const { return orders ? static_cast<double>(total()) / orders : 0.0; }
+
+    void merge(const MemoryUsage& other)
+    {
+        orders += other.orders;
+        capacity += other.capacity;
+        orderRecords += other.orderRecords;
+        orderIdStrings += other.orderIdStrings;
+        symbols += other.symbols;
+        indexes += other.indexes;
+        peak += other.peak;
+    }
+};
+
+namespace memory {
+
+// heap block of a string, 0 when it fits the small string buffer
+inline size_t heapBytes(const std::string& s)
+{
+    return s.capacity() > std::string().capacity() ? s.capacity() + 1 : 0;
+}
+
+// estimate for node based hash maps: the bucket array plus a node per element (next pointer and cached hash)
+template <typename Map>
+size_t hashMapBytes(const Map& map)
+{
+    return map.bucket_count() * sizeof(void*) + map.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void*));
+}
+
+} // namespace memory
+
+#endif // MEMORYUSAGE_HPP
@@ -0,0 +1,105 @@
+#ifndef MPSCRING_HPP
+#define MPSCRING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+// Bounded lock-free multi-producer single-consumer queue (Vyukov's bounded queue with a single consumer). Every cell
+// carries a sequence number telling whose turn it is: producers claim a position with one CAS on the tail and
+// publish the value by bumping the cell's sequence, the consumer reads cells in order without any atomic RMW.
+// Values are moved in and out, T has to be default constructible and move assignable.
+template <typename T>
+class MpscRing {
+public:
+    // capacity is rounded up to a power of two
+    explicit MpscRing(size_t capacity)
+        : m_mask(roundUp(capacity) - 1)
+        , m_cells(std::make_unique<Cell[]>(m_mask + 1))
+    {
+        for (size_t i = 0; i <= m_mask; ++i) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    // any thread, value is left untouched and false returned when the ring is full
+    bool tryPush(T&& value)
+    {
+        size_t position = m_tail.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &m_cells[position & m_mask];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // the consumer hasn't freed the cell from the previous lap yet
+                return false;
+            } else {
+                position = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // any thread, yields while the ring is full (back pressure)
+    void push(T value)
+    {
+        while (!tryPush(std::move(value))) {
+            std::this_thread::yield();
+        }
+    }
+
+    // consumer thread only
+    bool tryPop(T& out)
+    {
+        Cell& cell = m_cells[m_head & m_mask];
+        if (cell.sequence.load(std::memory_order_acquire) != m_head + 1) {
+            return false;
+        }
+        out = std::move(cell.value);
+        cell.value = T();
+        cell.sequence.store(m_head + m_mask + 1, std::memory_order_release);
+        ++m_head;
+        return true;
+    }
+
+    // consumer thread only
+    bool empty() const { return m_cells[m_head & m_mask].sequence.load(std::memory_order_acquire) != m_head + 1; }
+
+    size_t capacity() const { return m_mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence { 0 };
+        T value {};
+    };
+
+    static size_t roundUp(size_t capacity)
+    {
+        size_t out = 2;
+        while (out < capacity) {
+            out *= 2;
+        }
+        return out;
+    }
+
+    const size_t m_mask;
+    const std::unique_ptr<Cell[]> m_cells;
+    // producers and the consumer on their own cache lines
+    alignas(64) std::atomic<size_t> m_tail { 0 };
+    alignas(64) size_t m_head { 0 };
+};
+
+#endif // MPSCRING_HPP
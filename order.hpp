@@ -5,6 +5,7 @@
 
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class Order {
@@ -30,7 +31,15 @@ public:
     std::string company() const { return m_company; }
     unsigned int qty() const { return m_qty; }
 
-    // only change to this header by me - adding those two operators:
+    // non-owning views of the same fields, valid as long as the order lives - hot paths use these so reading an order
+    // doesn't copy its strings
+    std::string_view orderIdView() const { return m_orderId; }
+    std::string_view securityIdView() const { return m_securityId; }
+    std::string_view sideView() const { return m_side; }
+    std::string_view userView() const { return m_user; }
+    std::string_view companyView() const { return m_company; }
+
+    // changes to this header by me - the views above and those two operators:
     unsigned int operator+=(unsigned int qtyChange);
     unsigned int operator-=(unsigned int qtyChange);
 
@@ -0,0 +1,965 @@
+#include "orderbook.hpp"
+#include "scankernels.hpp"
+#include "snapshotfile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using ListKind = OrderStore::ListKind;
+
+OrderBook::OrderBook()
+    : m_sellSide(m_sides.intern("Sell"))
+{
+}
+
+bool OrderBook::add(const Order& order)
+{
+    return insert(order) != npos;
+}
+
+bool OrderBook::add(const Order& order, uint64_t expiry)
+{
+    const size_t slot = insert(order);
+    if (slot == npos) {
+        return false;
+    }
+    if (slot >= m_timers.size()) {
+        m_timers.resize(slot + 1, TimingWheel::npos);
+    }
+    m_timers[slot] = m_expiry.insert(static_cast<uint32_t>(slot), expiry);
+    return true;
+}
+
+size_t OrderBook::insert(const Order& order)
+{
+    const std::string_view orderId = order.orderIdView();
+    if (m_orderIds.count(orderId)) {
+        return npos;
+    }
+
+    const size_t slot = m_store.allocate();
+    auto* key = static_cast<char*>(m_arena.allocate(orderId.size(), 1));
+    std::memcpy(key, orderId.data(), orderId.size());
+    m_orderIds.emplace(std::string_view { key, orderId.size() }, slot);
+
+    const SymbolId securityId = m_securityIds.intern(order.securityIdView());
+    const SymbolId user = m_users.intern(order.userView());
+    m_store.setOrderId(slot, orderId);
+    m_store.setSecurity(slot, securityId);
+    m_store.setSide(slot, m_sides.intern(order.sideView()));
+    m_store.setUser(slot, user);
+    m_store.setCompany(slot, m_companies.intern(order.companyView()));
+    m_store.setQty(slot, order.qty());
+
+    if (user >= m_userOrders.size()) {
+        m_userOrders.resize(user + 1);
+    }
+    if (securityId >= m_securities.size()) {
+        m_securities.resize(securityId + 1);
+        // so marking securities dirty never allocates on cancels
+        m_dirtySecurities.reserve(m_securities.size());
+    }
+    if (m_store.company(slot) >= m_companyOrders.size()) {
+        m_companyOrders.resize(m_store.company(slot) + 1);
+    }
+
+    Security& security = m_securities[securityId];
+    link(m_userOrders[user], ListKind::User, slot);
+    link(security.orders, ListKind::Security, slot);
+    link(m_companyOrders[m_store.company(slot)], ListKind::Company, slot);
+    security.aggregates.add(m_store.company(slot), isSell(slot), m_store.qty(slot));
+    touch(securityId);
+    if (m_changes.active()) {
+        publish(OrderChange::Type::Add, slot);
+    }
+    rank();
+    countWork(0, 1);
+    return slot;
+}
+
+size_t OrderBook::add(const std::vector<Order>& orders)
+{
+    reserve(m_store.size() + orders.size());
+
+    size_t count = 0;
+    for (const auto& order : orders) {
+        count += add(order);
+    }
+    return count;
+}
+
+void OrderBook::reserve(size_t expectedOrders)
+{
+    m_store.reserve(expectedOrders);
+    m_orderIds.reserve(expectedOrders);
+    if (expectedOrders > m_orderIds.size()) {
+        m_arena.reserve((expectedOrders - m_orderIds.size()) * kIndexBytesPerOrder);
+    }
+    m_scanBuffer.reserve(expectedOrders);
+}
+
+size_t OrderBook::cancel(const std::string& orderId)
+{
+    auto it = m_orderIds.find(orderId);
+    if (it == m_orderIds.end()) {
+        return 0;
+    }
+    remove(it->second);
+    countWork(0, 1);
+    rank();
+    compactIfNeeded();
+    return 1;
+}
+
+size_t OrderBook::cancelForUser(const std::string& user, std::vector<std::string>* removedIds)
+{
+    const SymbolId id = m_users.find(user);
+    if (id == SymbolTable::npos) {
+        return 0;
+    }
+
+    const size_t count = m_userOrders[id].size;
+    countWork(count, count);
+    for (size_t slot = m_userOrders[id].head; slot != npos;) {
+        const size_t next = m_store.links(ListKind::User, slot).next;
+        remove(slot, removedIds);
+        slot = next;
+    }
+    rank();
+    compactIfNeeded();
+    return count;
+}
+
+size_t OrderBook::cancel(const std::vector<std::string>& orderIds)
+{
+    size_t count = 0;
+    for (const auto& orderId : orderIds) {
+        count += cancel(orderId);
+    }
+    return count;
+}
+
+size_t OrderBook::cancelForUsers(const std::vector<std::string>& users, std::vector<std::string>* removedIds)
+{
+    size_t count = 0;
+    for (const auto& user : users) {
+        count += cancelForUser(user, removedIds);
+    }
+    return count;
+}
+
+size_t OrderBook::cancelForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty, std::vector<std::string>* removedIds)
+{
+    const SymbolId id = m_securityIds.find(securityId);
+    if (id == SymbolTable::npos) {
+        return 0;
+    }
+
+    const Security& security = m_securities[id];
+    if (security.orders.size * kSweepRatio >= m_store.capacity()) {
+        m_scanBuffer.resize(m_store.capacity());
+        size_t count = 0;
+        for (size_t index = 0; index < m_store.segmentCount(); ++index) {
+            const auto& segment = m_store.segment(index);
+            const size_t base = index * OrderStore::kSegmentSlots;
+            const size_t found = scan::securityMinQty(segment.security.data(), segment.qty.data(), segment.live.data(),
+                std::min(OrderStore::kSegmentSlots, m_store.capacity() - base), id, minQty, m_scanBuffer.data() + count);
+            for (size_t i = count; i < count + found; ++i) {
+                m_scanBuffer[i] += static_cast<uint32_t>(base);
+            }
+            count += found;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            remove(m_scanBuffer[i], removedIds);
+        }
+        countWork(m_scanBuffer.size(), count);
+        rank();
+        compactIfNeeded();
+        return count;
+    }
+
+    size_t count = 0;
+    const size_t scanned = security.orders.size;
+    for (size_t slot = security.orders.head; slot != npos;) {
+        const size_t next = m_store.links(ListKind::Security, slot).next;
+        if (m_store.qty(slot) >= minQty) {
+            remove(slot, removedIds);
+            ++count;
+        }
+        slot = next;
+    }
+    countWork(scanned, count);
+    rank();
+    compactIfNeeded();
+    return count;
+}
+
+size_t OrderBook::cancelForCompany(const std::string& company, std::vector<std::string>* removedIds)
+{
+    const SymbolId id = m_companies.find(company);
+    if (id == SymbolTable::npos || id >= m_companyOrders.size()) {
+        return 0;
+    }
+
+    const size_t count = m_companyOrders[id].size;
+    countWork(count, count);
+    for (size_t slot = m_companyOrders[id].head; slot != npos;) {
+        const size_t next = m_store.links(ListKind::Company, slot).next;
+        remove(slot, removedIds);
+        slot = next;
+    }
+    rank();
+    compactIfNeeded();
+    return count;
+}
+
+size_t OrderBook::cancelMatching(const OrderFilter& filter, std::vector<std::string>* removedIds)
+{
+    // npos stands for "any", a name which was never interned matches nothing
+    auto resolve = [](const std::optional<std::string>& name, const SymbolTable& symbols, SymbolId& id) {
+        id = name ? symbols.find(*name) : SymbolTable::npos;
+        return !name || id != SymbolTable::npos;
+    };
+    SymbolId security, company, user, side;
+    if (!resolve(filter.securityId, m_securityIds, security) || !resolve(filter.company, m_companies, company)
+        || !resolve(filter.user, m_users, user) || !resolve(filter.side, m_sides, side) || filter.minQty > filter.maxQty) {
+        return 0;
+    }
+
+    auto matches = [&](size_t slot) {
+        const unsigned int qty = m_store.qty(slot);
+        return (security == SymbolTable::npos || m_store.security(slot) == security)
+            && (company == SymbolTable::npos || m_store.company(slot) == company)
+            && (user == SymbolTable::npos || m_store.user(slot) == user)
+            && (side == SymbolTable::npos || m_store.side(slot) == side) && qty >= filter.minQty && qty <= filter.maxQty;
+    };
+
+    // the shortest of the posting lists the filter pins down, lists of symbols without orders (yet) are empty
+    const List* list = nullptr;
+    ListKind kind = ListKind::Security;
+    const List empty;
+    auto consider = [&](SymbolId id, const auto& lists, ListKind listKind, auto get) {
+        if (id == SymbolTable::npos) {
+            return;
+        }
+        const List& candidate = id < lists.size() ? get(lists[id]) : empty;
+        if (!list || candidate.size < list->size) {
+            list = &candidate;
+            kind = listKind;
+        }
+    };
+    consider(security, m_securities, ListKind::Security, [](const Security& security) -> const List& { return security.orders; });
+    consider(company, m_companyOrders, ListKind::Company, [](const List& list) -> const List& { return list; });
+    consider(user, m_userOrders, ListKind::User, [](const List& list) -> const List& { return list; });
+
+    size_t count = 0;
+    size_t scanned = 0;
+    if (list) {
+        scanned = list->size;
+        for (size_t slot = list->head; slot != npos;) {
+            const size_t next = m_store.links(kind, slot).next;
+            if (matches(slot)) {
+                remove(slot, removedIds);
+                ++count;
+            }
+            slot = next;
+        }
+    } else {
+        // removing doesn't move slots, compaction waits until the sweep is done
+        scanned = m_store.capacity();
+        for (size_t slot = 0; slot < m_store.capacity(); ++slot) {
+            if (m_store.live(slot) && matches(slot)) {
+                remove(slot, removedIds);
+                ++count;
+            }
+        }
+    }
+    countWork(scanned, count);
+    rank();
+    compactIfNeeded();
+    return count;
+}
+
+size_t OrderBook::expire(uint64_t now, std::vector<std::string>* removedIds, const std::function<void()>& beforeRemove)
+{
+    m_scanBuffer.clear();
+    m_expiry.advance(now, m_scanBuffer);
+    if (beforeRemove) {
+        const size_t removedBefore = removedIds ? removedIds->size() : 0;
+        try {
+            for (size_t i = 0; removedIds && i < m_scanBuffer.size(); ++i) {
+                removedIds->push_back(m_store.orderId(m_scanBuffer[i]));
+            }
+            beforeRemove();
+        } catch (...) {
+            // the wheel already let the timers go, due again they expire on the next advance
+            for (const uint32_t slot : m_scanBuffer) {
+                m_timers[slot] = m_expiry.insert(slot, now);
+            }
+            if (removedIds) {
+                removedIds->resize(removedBefore);
+            }
+            throw;
+        }
+        // the orderIds are in already
+        removedIds = nullptr;
+    }
+    for (const uint32_t slot : m_scanBuffer) {
+        // the wheel already let the timer go
+        m_timers[slot] = TimingWheel::npos;
+        remove(slot, removedIds);
+    }
+    const size_t count = m_scanBuffer.size();
+    countWork(count, count);
+    rank();
+    compactIfNeeded();
+    return count;
+}
+
+unsigned int OrderBook::matchingSize(const std::string& securityId) const
+{
+    const Security* security = findSecurity(securityId);
+    if (!security) {
+        return 0;
+    }
+    countWork(security->aggregates.companies(), 0);
+    return security->aggregates.matchingSize();
+}
+
+unsigned int OrderBook::match(const std::string& securityId, std::vector<std::string>* removedIds,
+    std::vector<Fill>* fills, MatchingMode mode)
+{
+    Security* security = findSecurity(securityId);
+    if (!security) {
+        return 0;
+    }
+
+    const unsigned int out = mode == MatchingMode::Balanced ? balancedMatch(*security, fills) : greedyMatch(*security, fills);
+    touch(static_cast<SymbolId>(security - m_securities.data()));
+    size_t removed = 0;
+    for (size_t slot = security->orders.head; slot != npos;) {
+        const size_t next = m_store.links(ListKind::Security, slot).next;
+        if (m_store.qty(slot) == 0) {
+            remove(slot, removedIds);
+            ++removed;
+        }
+        slot = next;
+    }
+    countWork(0, removed);
+    rank();
+    compactIfNeeded();
+    return out;
+}
+
+std::vector<unsigned int> OrderBook::matchingSizes(const std::vector<std::string>& securityIds, WorkerPool* pool) const
+{
+    std::vector<SymbolId> ids;
+    ids.reserve(securityIds.size());
+    for (const auto& securityId : securityIds) {
+        ids.push_back(m_securityIds.find(securityId));
+    }
+    std::vector<unsigned int> out(ids.size());
+    matchingSizes(ids, out.data(), pool);
+    return out;
+}
+
+std::vector<std::pair<std::string, unsigned int>> OrderBook::matchingSizes(WorkerPool* pool) const
+{
+    std::vector<SymbolId> ids;
+    for (SymbolId id = 0; id < m_securities.size(); ++id) {
+        if (m_securities[id].orders.size) {
+            ids.push_back(id);
+        }
+    }
+    std::sort(ids.begin(), ids.end(), [this](SymbolId lhs, SymbolId rhs) { return m_securityIds.name(lhs) < m_securityIds.name(rhs); });
+    std::vector<unsigned int> sizes(ids.size());
+    matchingSizes(ids, sizes.data(), pool);
+
+    std::vector<std::pair<std::string, unsigned int>> out;
+    out.reserve(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        out.emplace_back(m_securityIds.name(ids[i]), sizes[i]);
+    }
+    return out;
+}
+
+std::vector<std::pair<std::string, unsigned int>> OrderBook::topMatchingSizes(size_t n) const
+{
+    std::vector<std::pair<std::string, unsigned int>> out;
+    const auto top = m_ranking.top(n);
+    out.reserve(top.size());
+    for (const auto& [security, size] : top) {
+        out.emplace_back(m_securityIds.name(security), size);
+    }
+    countWork(top.size(), 0);
+    return out;
+}
+
+std::vector<Order> OrderBook::orders() const
+{
+    std::vector<Order> out;
+    out.reserve(size());
+    for (size_t slot = 0; slot < m_store.capacity(); ++slot) {
+        if (m_store.live(slot)) {
+            out.emplace_back(m_store.orderId(slot), m_securityIds.name(m_store.security(slot)), m_sides.name(m_store.side(slot)),
+                m_store.qty(slot), m_users.name(m_store.user(slot)), m_companies.name(m_store.company(slot)));
+        }
+    }
+    return out;
+}
+
+OrderBookSnapshot OrderBook::snapshot() const
+{
+    OrderBookSnapshot out;
+    out.m_segments = m_store.segments();
+    out.m_capacity = m_store.capacity();
+    out.m_size = m_store.size();
+    out.m_securityIds = m_securityIds.view();
+    out.m_sides = m_sides.view();
+    out.m_users = m_users.view();
+    out.m_companies = m_companies.view();
+    return out;
+}
+
+size_t OrderBook::compact(size_t maxMoves)
+{
+    size_t moves = 0;
+    // after trim() the last slot is live, every tombstone left is a hole before it
+    for (m_store.trim(); m_store.tombstones() > 0 && moves < maxMoves; m_store.trim()) {
+        relocate(m_store.capacity() - 1);
+        ++moves;
+    }
+    return moves;
+}
+
+MemoryUsage OrderBook::memoryUsage() const
+{
+    MemoryUsage out;
+    out.orders = size();
+    out.capacity = capacity();
+    out.orderRecords = m_store.recordBytes();
+    out.orderIdStrings = m_store.orderIdBytes();
+    for (const SymbolTable* symbols : { &m_securityIds, &m_sides, &m_users, &m_companies }) {
+        out.symbols += symbols->memoryBytes();
+    }
+    out.indexes = m_arena.capacity() + m_arena.largeBytes() + (m_userOrders.capacity() + m_companyOrders.capacity()) * sizeof(List)
+        + m_securities.capacity() * sizeof(Security) + m_scanBuffer.capacity() * sizeof(uint32_t) + m_ranking.memoryBytes()
+        + m_dirtySecurities.capacity() * sizeof(SymbolId) + m_matcher.memoryBytes() + m_timers.capacity() * sizeof(uint32_t)
+        + m_expiry.memoryBytes();
+    for (const auto& security : m_securities) {
+        out.indexes += security.aggregates.memoryBytes();
+    }
+    m_peakBytes = std::max(m_peakBytes, out.total());
+    out.peak = m_peakBytes;
+    return out;
+}
+
+void OrderBook::shrink()
+{
+    // records the peak
+    memoryUsage();
+
+    compact();
+    m_store.shrink();
+    m_scanBuffer = {};
+    m_matcher.shrink();
+    m_timers.resize(std::min(m_timers.size(), m_store.capacity()));
+    m_timers.shrink_to_fit();
+    m_expiry.shrink();
+
+    // keys live in the arena which can't give single chunks back, so the index is rebuilt from the store
+    {
+        std::pmr::unordered_map<std::string_view, size_t> old { &m_arena };
+        old.swap(m_orderIds);
+    }
+    m_arena.release();
+    m_orderIds.reserve(m_store.size());
+    for (size_t slot = 0; slot < m_store.capacity(); ++slot) {
+        const std::string& orderId = m_store.orderId(slot);
+        auto* key = static_cast<char*>(m_arena.allocate(orderId.size(), 1));
+        std::memcpy(key, orderId.data(), orderId.size());
+        m_orderIds.emplace(std::string_view { key, orderId.size() }, slot);
+    }
+}
+
+namespace {
+
+constexpr uint32_t kBookMagic = 0x4b424f43; // "OCBK"
+constexpr uint32_t kBookVersion = 1;
+
+void saveSymbols(snapshotfile::Writer& writer, const SymbolTable& symbols)
+{
+    writer.u32(static_cast<uint32_t>(symbols.size()));
+    for (SymbolId id = 0; id < symbols.size(); ++id) {
+        writer.string(symbols.name(id));
+    }
+}
+
+// returns ids of the saved symbols in this book, they differ when the book interned other names before
+std::vector<SymbolId> loadSymbols(snapshotfile::Reader& reader, SymbolTable& symbols)
+{
+    std::vector<SymbolId> out(reader.u32());
+    for (auto& id : out) {
+        id = symbols.intern(reader.string());
+    }
+    return out;
+}
+
+} // namespace
+
+void OrderBook::save(std::string& out) const
+{
+    snapshotfile::Writer writer(out);
+    writer.u32(kBookMagic);
+    writer.u32(kBookVersion);
+    saveSymbols(writer, m_securityIds);
+    saveSymbols(writer, m_sides);
+    saveSymbols(writer, m_users);
+    saveSymbols(writer, m_companies);
+
+    // live slots are saved in slot order, position in the file becomes the slot after load
+    std::vector<uint32_t> position(m_store.capacity());
+    std::vector<size_t> slots;
+    slots.reserve(size());
+    for (size_t slot = 0; slot < m_store.capacity(); ++slot) {
+        if (m_store.live(slot)) {
+            position[slot] = static_cast<uint32_t>(slots.size());
+            slots.push_back(slot);
+        }
+    }
+
+    writer.u64(slots.size());
+    for (size_t slot : slots) {
+        writer.string(m_store.orderId(slot));
+    }
+    for (auto column : { &OrderStore::security, &OrderStore::side, &OrderStore::user, &OrderStore::company }) {
+        for (size_t slot : slots) {
+            writer.u32((m_store.*column)(slot));
+        }
+    }
+    for (size_t slot : slots) {
+        writer.u32(m_store.qty(slot));
+    }
+    // good-till-time orders by position, then their deadlines
+    std::vector<uint32_t> expiring;
+    for (uint32_t i = 0; i < slots.size(); ++i) {
+        if (slots[i] < m_timers.size() && m_timers[slots[i]] != TimingWheel::npos) {
+            expiring.push_back(i);
+        }
+    }
+    writer.u32(static_cast<uint32_t>(expiring.size()));
+    for (const uint32_t i : expiring) {
+        writer.u32(i);
+    }
+    for (const uint32_t i : expiring) {
+        writer.u64(m_expiry.deadline(m_timers[slots[i]]));
+    }
+
+    auto saveList = [&](const List& list, ListKind kind) {
+        writer.u32(static_cast<uint32_t>(list.size));
+        for (size_t slot = list.head; slot != npos; slot = m_store.links(kind, slot).next) {
+            writer.u32(position[slot]);
+        }
+    };
+    writer.u32(static_cast<uint32_t>(m_securities.size()));
+    for (const auto& security : m_securities) {
+        saveList(security.orders, ListKind::Security);
+    }
+    writer.u32(static_cast<uint32_t>(m_userOrders.size()));
+    for (const auto& user : m_userOrders) {
+        saveList(user, ListKind::User);
+    }
+}
+
+void OrderBook::load(std::string_view data)
+{
+    compact();
+    if (m_store.capacity() != 0) {
+        throw std::logic_error("snapshot can be loaded only into an empty book");
+    }
+
+    try {
+        snapshotfile::Reader reader(data);
+        if (reader.u32() != kBookMagic || reader.u32() != kBookVersion) {
+            throw std::runtime_error("not an order book snapshot or unsupported version");
+        }
+        const auto securityIds = loadSymbols(reader, m_securityIds);
+        const auto sides = loadSymbols(reader, m_sides);
+        const auto users = loadSymbols(reader, m_users);
+        const auto companies = loadSymbols(reader, m_companies);
+
+        const uint64_t count = reader.u64();
+        // every order takes at least 24 bytes, don't reserve memory for a count the data can't hold
+        if (count > data.size() / 24) {
+            throw std::runtime_error("corrupted snapshot, bad order count");
+        }
+        reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            const std::string_view orderId = reader.string();
+            const size_t slot = m_store.allocate();
+            auto* key = static_cast<char*>(m_arena.allocate(orderId.size(), 1));
+            std::memcpy(key, orderId.data(), orderId.size());
+            if (!m_orderIds.emplace(std::string_view { key, orderId.size() }, slot).second) {
+                m_arena.deallocate(key, orderId.size(), 1);
+                throw std::runtime_error("corrupted snapshot, duplicated orderId");
+            }
+            m_store.setOrderId(slot, orderId);
+        }
+
+        auto symbol = [&reader](const std::vector<SymbolId>& ids) {
+            const uint32_t id = reader.u32();
+            if (id >= ids.size()) {
+                throw std::runtime_error("corrupted snapshot, unknown symbol");
+            }
+            return ids[id];
+        };
+        for (size_t slot = 0; slot < count; ++slot) {
+            m_store.setSecurity(slot, symbol(securityIds));
+        }
+        for (size_t slot = 0; slot < count; ++slot) {
+            m_store.setSide(slot, symbol(sides));
+        }
+        for (size_t slot = 0; slot < count; ++slot) {
+            m_store.setUser(slot, symbol(users));
+        }
+        for (size_t slot = 0; slot < count; ++slot) {
+            m_store.setCompany(slot, symbol(companies));
+        }
+        for (size_t slot = 0; slot < count; ++slot) {
+            m_store.setQty(slot, reader.u32());
+        }
+        const uint32_t expiring = reader.u32();
+        if (expiring > count) {
+            throw std::runtime_error("corrupted snapshot, bad expiry count");
+        }
+        std::vector<uint32_t> expiringSlots(expiring);
+        for (auto& slot : expiringSlots) {
+            slot = reader.u32();
+        }
+        m_timers.resize(std::max<size_t>(m_timers.size(), expiring ? count : 0), TimingWheel::npos);
+        for (const uint32_t slot : expiringSlots) {
+            if (slot >= count || m_timers[slot] != TimingWheel::npos) {
+                throw std::runtime_error("corrupted snapshot, bad expiry");
+            }
+            // deadlines which passed meanwhile are due, the next expire() removes those orders
+            m_timers[slot] = m_expiry.insert(slot, reader.u64());
+        }
+
+        // every slot has to be on exactly one list of each kind, the one of its own security and user
+        auto loadLists = [&](auto& lists, ListKind kind, const SymbolTable& symbols, const std::vector<SymbolId>& ids, auto id, auto list) {
+            const uint32_t listCount = reader.u32();
+            if (listCount > ids.size()) {
+                throw std::runtime_error("corrupted snapshot, unknown symbol");
+            }
+            lists.resize(std::max(lists.size(), symbols.size()));
+            size_t linked = 0;
+            for (uint32_t i = 0; i < listCount; ++i) {
+                const SymbolId owner = ids[i];
+                const uint32_t size = reader.u32();
+                for (uint32_t j = 0; j < size; ++j) {
+                    const uint32_t slot = reader.u32();
+                    if (slot >= count || (m_store.*id)(slot) != owner || m_store.links(kind, slot).prev != npos
+                        || list(lists[owner]).head == slot) {
+                        throw std::runtime_error("corrupted snapshot, bad posting list");
+                    }
+                    link(list(lists[owner]), kind, slot);
+                }
+                linked += size;
+            }
+            if (linked != count) {
+                throw std::runtime_error("corrupted snapshot, bad posting list");
+            }
+        };
+        loadLists(m_securities, ListKind::Security, m_securityIds, securityIds, &OrderStore::security, [](Security& security) -> List& { return security.orders; });
+        loadLists(m_userOrders, ListKind::User, m_users, users, &OrderStore::user, [](List& list) -> List& { return list; });
+        if (!reader.empty()) {
+            throw std::runtime_error("corrupted snapshot, trailing bytes");
+        }
+
+        // company lists aren't saved, slot order is close enough to insertion order for them
+        m_companyOrders.resize(std::max(m_companyOrders.size(), m_companies.size()));
+        for (size_t slot = 0; slot < count; ++slot) {
+            m_securities[m_store.security(slot)].aggregates.add(m_store.company(slot), isSell(slot), m_store.qty(slot));
+            link(m_companyOrders[m_store.company(slot)], ListKind::Company, slot);
+        }
+        m_dirtySecurities.reserve(m_securities.size());
+        for (SymbolId security = 0; security < m_securities.size(); ++security) {
+            touch(security);
+        }
+        rank();
+    } catch (...) {
+        // leave the book empty again, symbols are never removed anyway
+        for (const auto& [key, slot] : m_orderIds) {
+            m_arena.deallocate(const_cast<char*>(key.data()), key.size(), 1);
+        }
+        m_orderIds.clear();
+        for (size_t slot = 0; slot < m_store.capacity(); ++slot) {
+            if (m_store.live(slot)) {
+                m_store.release(slot);
+            }
+        }
+        m_store.trim();
+        for (auto& security : m_securities) {
+            security.orders = {};
+        }
+        for (auto& user : m_userOrders) {
+            user = {};
+        }
+        for (auto& company : m_companyOrders) {
+            company = {};
+        }
+        m_ranking.clear();
+        m_dirtySecurities.clear();
+        for (auto& timer : m_timers) {
+            if (timer != TimingWheel::npos) {
+                m_expiry.cancel(timer);
+                timer = TimingWheel::npos;
+            }
+        }
+        throw;
+    }
+}
+
+void OrderBook::matchingSizes(const std::vector<SymbolId>& ids, unsigned int* out, WorkerPool* pool) const
+{
+    const size_t chunks = (ids.size() + kMatchingChunk - 1) / kMatchingChunk;
+    // per chunk, m_work isn't written from the workers
+    std::vector<size_t> scanned(chunks);
+    auto chunk = [&](size_t index) {
+        const size_t end = std::min(ids.size(), (index + 1) * kMatchingChunk);
+        for (size_t i = index * kMatchingChunk; i < end; ++i) {
+            if (ids[i] == SymbolTable::npos) {
+                out[i] = 0;
+                continue;
+            }
+            const MatchingAggregates& aggregates = m_securities[ids[i]].aggregates;
+            scanned[index] += aggregates.companies();
+            out[i] = aggregates.matchingSize();
+        }
+    };
+    if (pool && chunks > 1) {
+        pool->run(chunks, chunk);
+    } else {
+        for (size_t index = 0; index < chunks; ++index) {
+            chunk(index);
+        }
+    }
+    for (const size_t count : scanned) {
+        countWork(count, 0);
+    }
+}
+
+void OrderBook::link(List& list, ListKind kind, size_t slot)
+{
+    OrderStore::Links& node = m_store.links(kind, slot);
+    node.prev = list.tail;
+    node.next = npos;
+    if (list.tail != npos) {
+        m_store.links(kind, list.tail).next = slot;
+    } else {
+        list.head = slot;
+    }
+    list.tail = slot;
+    ++list.size;
+}
+
+void OrderBook::unlink(List& list, ListKind kind, size_t slot)
+{
+    OrderStore::Links& node = m_store.links(kind, slot);
+    if (node.prev != npos) {
+        m_store.links(kind, node.prev).next = node.next;
+    } else {
+        list.head = node.next;
+    }
+    if (node.next != npos) {
+        m_store.links(kind, node.next).prev = node.prev;
+    } else {
+        list.tail = node.prev;
+    }
+    node = {};
+    --list.size;
+}
+
+OrderBook::Security* OrderBook::findSecurity(const std::string& securityId)
+{
+    const SymbolId id = m_securityIds.find(securityId);
+    return id != SymbolTable::npos ? &m_securities[id] : nullptr;
+}
+
+const OrderBook::Security* OrderBook::findSecurity(const std::string& securityId) const
+{
+    const SymbolId id = m_securityIds.find(securityId);
+    return id != SymbolTable::npos ? &m_securities[id] : nullptr;
+}
+
+void OrderBook::remove(size_t slot, std::vector<std::string>* removedIds)
+{
+    if (removedIds) {
+        removedIds->push_back(m_store.orderId(slot));
+    }
+    if (m_changes.active()) {
+        publish(OrderChange::Type::Remove, slot);
+    }
+
+    if (slot < m_timers.size() && m_timers[slot] != TimingWheel::npos) {
+        m_expiry.cancel(m_timers[slot]);
+        m_timers[slot] = TimingWheel::npos;
+    }
+
+    Security& security = m_securities[m_store.security(slot)];
+    unlink(m_userOrders[m_store.user(slot)], ListKind::User, slot);
+    unlink(security.orders, ListKind::Security, slot);
+    unlink(m_companyOrders[m_store.company(slot)], ListKind::Company, slot);
+    security.aggregates.remove(m_store.company(slot), isSell(slot), m_store.qty(slot));
+    touch(m_store.security(slot));
+    auto it = m_orderIds.find(m_store.orderId(slot));
+    const std::string_view key = it->first;
+    m_orderIds.erase(it);
+    m_arena.deallocate(const_cast<char*>(key.data()), key.size(), 1);
+
+    m_store.release(slot);
+}
+
+void OrderBook::publish(OrderChange::Type type, size_t slot)
+{
+    m_changes.publish(type, m_store.qty(slot), m_store.orderId(slot), m_securityIds.name(m_store.security(slot)),
+        m_sides.name(m_store.side(slot)), m_users.name(m_store.user(slot)), m_companies.name(m_store.company(slot)));
+}
+
+void OrderBook::relocate(size_t from)
+{
+    const size_t to = m_store.relocate(from);
+    relink(m_userOrders[m_store.user(to)], ListKind::User, to);
+    relink(m_securities[m_store.security(to)].orders, ListKind::Security, to);
+    relink(m_companyOrders[m_store.company(to)], ListKind::Company, to);
+    m_orderIds.find(m_store.orderId(to))->second = to;
+    if (from < m_timers.size() && m_timers[from] != TimingWheel::npos) {
+        // compaction fills holes from the end, to is below from
+        m_timers[to] = m_timers[from];
+        m_timers[from] = TimingWheel::npos;
+        m_expiry.rebind(m_timers[to], static_cast<uint32_t>(to));
+    }
+    countWork(0, 1);
+}
+
+// points the neighbours of a relocated slot to it
+void OrderBook::relink(List& list, ListKind kind, size_t slot)
+{
+    const OrderStore::Links node = m_store.links(kind, slot);
+    if (node.prev != npos) {
+        m_store.links(kind, node.prev).next = slot;
+    } else {
+        list.head = slot;
+    }
+    if (node.next != npos) {
+        m_store.links(kind, node.next).prev = slot;
+    } else {
+        list.tail = slot;
+    }
+}
+
+void OrderBook::touch(SymbolId security)
+{
+    if (!m_securities[security].dirty) {
+        m_securities[security].dirty = true;
+        m_dirtySecurities.push_back(security);
+    }
+}
+
+void OrderBook::rank()
+{
+    for (const SymbolId security : m_dirtySecurities) {
+        m_securities[security].dirty = false;
+        m_ranking.update(security, m_securities[security].aggregates.matchingSize());
+    }
+    m_dirtySecurities.clear();
+}
+
+void OrderBook::compactIfNeeded()
+{
+    if (!m_compacting) {
+        m_compacting = m_compactionThreshold > 0 && m_store.capacity() >= kMinCompactionSlots
+            && m_store.tombstones() > m_compactionThreshold * m_store.capacity();
+    }
+    if (m_compacting) {
+        compact(kCompactionMoves);
+        m_compacting = m_store.tombstones() > 0;
+    }
+}
+
+unsigned int OrderBook::greedyMatch(Security& security, std::vector<Fill>* fills)
+{
+    // sell slots from the front and buy slots from the back of the scratch buffer, both in insertion order when read
+    // from their end, so matching doesn't allocate once the buffer has grown
+    m_scanBuffer.resize(std::max(m_scanBuffer.size(), security.orders.size));
+    size_t sells = 0;
+    size_t buys = 0;
+    for (size_t slot = security.orders.head; slot != npos; slot = m_store.links(ListKind::Security, slot).next) {
+        if (isSell(slot)) {
+            m_scanBuffer[sells++] = static_cast<uint32_t>(slot);
+        } else {
+            m_scanBuffer[security.orders.size - ++buys] = static_cast<uint32_t>(slot);
+        }
+    }
+    countWork(sells + buys, 0);
+
+    const uint32_t* sell_orders = m_scanBuffer.data();
+    const uint32_t* buy_orders_end = m_scanBuffer.data() + security.orders.size;
+    unsigned int out = 0;
+    for (size_t sell = 0; sell < sells; ++sell) {
+        const size_t sell_order = sell_orders[sell];
+        for (size_t buy = 1; buy <= buys; ++buy) {
+            const size_t buy_order = *(buy_orders_end - buy);
+            if (m_store.company(sell_order) != m_store.company(buy_order)) {
+                // exhausted buy orders stay in the list until the match is over, they trade 0
+                const unsigned int transaction_qty = std::min(m_store.qty(sell_order), m_store.qty(buy_order));
+                fill(security, sell_order, buy_order, transaction_qty, fills);
+                out += transaction_qty;
+
+                if (m_store.qty(sell_order) == 0) {
+                    break;
+                }
+            }
+        }
+    }
+    return out;
+}
+
+unsigned int OrderBook::balancedMatch(Security& security, std::vector<Fill>* fills)
+{
+    // the matcher refers to orders by their position in the security list
+    m_scanBuffer.resize(std::max(m_scanBuffer.size(), security.orders.size));
+    m_matcher.clear();
+    size_t count = 0;
+    for (size_t slot = security.orders.head; slot != npos; slot = m_store.links(ListKind::Security, slot).next) {
+        m_scanBuffer[count++] = static_cast<uint32_t>(slot);
+        m_matcher.add(m_store.company(slot), isSell(slot), m_store.qty(slot));
+    }
+    countWork(count, 0);
+
+    unsigned int out = 0;
+    for (const BalancedMatcher::Execution& execution : m_matcher.match()) {
+        fill(security, m_scanBuffer[execution.sell], m_scanBuffer[execution.buy], execution.qty, fills);
+        out += execution.qty;
+    }
+    return out;
+}
+
+void OrderBook::fill(Security& security, size_t sell, size_t buy, unsigned int qty, std::vector<Fill>* fills)
+{
+    m_store.setQty(sell, m_store.qty(sell) - qty);
+    m_store.setQty(buy, m_store.qty(buy) - qty);
+    security.aggregates.reduce(m_store.company(sell), true, qty);
+    security.aggregates.reduce(m_store.company(buy), false, qty);
+    if (qty > 0) {
+        if (m_changes.active()) {
+            publish(OrderChange::Type::Fill, sell);
+            publish(OrderChange::Type::Fill, buy);
+        }
+        if (fills) {
+            fills->push_back({ m_store.orderId(sell), m_store.orderId(buy), qty });
+        }
+    }
+    countWork(0, 2);
+}
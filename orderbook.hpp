@@ -0,0 +1,231 @@
+#ifndef ORDERBOOK_HPP
+#define ORDERBOOK_HPP
+
+#include "arena.hpp"
+#include "cachestats.hpp"
+#include "changefeed.hpp"
+#include "matchingaggregates.hpp"
+#include "matchingengine.hpp"
+#include "memoryusage.hpp"
+#include "order.hpp"
+#include "orderfilter.hpp"
+#include "orderbooksnapshot.hpp"
+#include "orderstore.hpp"
+#include "securityranking.hpp"
+#include "symboltable.hpp"
+#include "timingwheel.hpp"
+#include "workerpool.hpp"
+
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Indexed storage engine used by OrderCacheImpl, it is not thread safe - locking is up to the owner.
+//
+// Orders are kept in stable slots of a columnar OrderStore, a cancelled slot becomes a tombstone which is reused by the next
+// add, so removing an order never shifts other orders around. Securities, sides, users and companies are interned into
+// SymbolTables when an order is added and slots hold only the ids, Order objects are rebuilt at the edge by orders().
+// Every live slot is indexed by its orderId and threaded on three intrusive doubly linked lists (posting lists) - one for
+// its user, one for its security and one for its company. Thanks to that cancels cost O(k) where k is the number of removed orders and the lists
+// keep insertion order which the matching relies on. When a security holds a big part of the book its min qty cancel sweeps
+// the qty/security columns with the scan kernels instead of chasing list links all over the memory.
+// Besides that per-security MatchingAggregates are kept up to date so the matching size is known without visiting orders,
+// and securities are ranked by it - every operation re-ranks the securities it touched (see SecurityRanking).
+// The orderId index (nodes, buckets and key bytes) is allocated from an Arena owned by the book, reserve() preallocates
+// it together with the store so the book can grow to the expected size without malloc calls or page faults.
+// Cancels and fills only turn slots into tombstones. Once tombstones make up more than the compaction threshold of the
+// store, every following cancel also moves a few orders from the end of the store into holes (incremental compaction)
+// until the store is dense again, so sweeps and snapshots don't carry dead slots around and cancel latency stays bounded.
+// compact() does the whole pass at once, e.g. from a maintenance thread of the owner.
+// Good-till-time orders get a timer in a TimingWheel, expire() removes the ones due in a batch like any mass cancel.
+class OrderBook {
+public:
+    static constexpr size_t npos = OrderStore::npos;
+
+    // security posting lists at least 1/kSweepRatio of all slots long are scanned column-wise
+    static constexpr size_t kSweepRatio = 16;
+
+    OrderBook();
+
+    // returns false and leaves the book untouched when an order with the same orderId is already in the book
+    bool add(const Order& order);
+    // batch add, storage and the orderId index are grown once for the whole batch, returns the number of added orders
+    size_t add(const std::vector<Order>& orders);
+    // good-till-time order, the first expire(now) with now >= expiry removes it unless it is gone by then. The unit is
+    // up to the owner (the caches use milliseconds, see timingwheel.hpp), scheduling and cancelling the timer is O(1).
+    // save() keeps the expiries, load() schedules them again - orders due by then expire on the next expire().
+    bool add(const Order& order, uint64_t expiry);
+
+    // preallocates and touches memory for that many orders in total
+    void reserve(size_t expectedOrders);
+
+    bool contains(const std::string& orderId) const { return m_orderIds.count(orderId); }
+
+    // all cancel functions return the number of removed orders, functions removing many orders append orderIds of
+    // the removed ones to removedIds if given
+    size_t cancel(const std::string& orderId);
+    size_t cancel(const std::vector<std::string>& orderIds);
+    size_t cancelForUser(const std::string& user, std::vector<std::string>* removedIds = nullptr);
+    size_t cancelForUsers(const std::vector<std::string>& users, std::vector<std::string>* removedIds = nullptr);
+    size_t cancelForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty, std::vector<std::string>* removedIds = nullptr);
+    size_t cancelForCompany(const std::string& company, std::vector<std::string>* removedIds = nullptr);
+    // walks the shortest posting list among the filter's security, company and user and checks the rest of the
+    // conditions on it, so the cost is bound by the most selective of them. Only a filter without any of those
+    // sweeps the whole store.
+    size_t cancelMatching(const OrderFilter& filter, std::vector<std::string>* removedIds = nullptr);
+
+    // removes the orders which expired by now, see add(order, expiry). beforeRemove runs once their orderIds are in
+    // removedIds and before any of them is removed, e.g. to journal the cancels - if it throws, the book is left as it
+    // was and the orders expire on the next expire().
+    size_t expire(uint64_t now, std::vector<std::string>* removedIds = nullptr,
+        const std::function<void()>& beforeRemove = {});
+    // orders waiting for their expiry
+    size_t expiring() const { return m_expiry.size(); }
+
+    // total qty of the security that can match between sell and buy orders of different companies, the book is not changed
+    unsigned int matchingSize(const std::string& securityId) const;
+    // matches sell orders against buy orders of other companies for the security, quantities of matched orders are
+    // decreased and fully filled orders (qty == 0) of the security are removed afterwards. Greedy walks the orders in
+    // insertion order, Balanced trades matchingSize() - see matchingengine.hpp. The executions are appended to fills
+    // if given, in the order they happen.
+    unsigned int match(const std::string& securityId, std::vector<std::string>* removedIds = nullptr,
+        std::vector<Fill>* fills = nullptr, MatchingMode mode = MatchingMode::Greedy);
+
+    // matchingSize() of many securities at once (unknown ones get 0) and of every security with orders, sorted by
+    // securityId. Securities are split into chunks which run in parallel on the pool if one is given - the book is
+    // only read so the owner's lock covers all of them.
+    std::vector<unsigned int> matchingSizes(const std::vector<std::string>& securityIds, WorkerPool* pool = nullptr) const;
+    std::vector<std::pair<std::string, unsigned int>> matchingSizes(WorkerPool* pool = nullptr) const;
+
+    // <securityId, matching size> of the n securities with the biggest matching size, biggest first, securities with
+    // nothing to match are left out. O(n log n), the ranking is kept up to date by every operation.
+    std::vector<std::pair<std::string, unsigned int>> topMatchingSizes(size_t n) const;
+
+    std::vector<Order> orders() const;
+    size_t size() const { return m_store.size(); }
+
+    // frozen view of the current state which can be read without any lock, see OrderBookSnapshot
+    OrderBookSnapshot snapshot() const;
+
+    // ratio of tombstones to all slots which starts incremental compaction, 0 disables it
+    void setCompactionThreshold(double deadRatio) { m_compactionThreshold = deadRatio; }
+    // moves up to maxMoves orders into holes and drops tombstones from the end of the store, returns the number of moves
+    size_t compact(size_t maxMoves = npos);
+    // number of slots including tombstones
+    size_t capacity() const { return m_store.capacity(); }
+
+    // Footprint of the book by component, see memoryusage.hpp. It visits every slot and symbol, O(capacity).
+    MemoryUsage memoryUsage() const;
+    // Gives slack back to the allocator: compacts the store, frees pooled segments and scratch buffers, shrinks strings
+    // and rebuilds the orderId index into a fresh arena. It costs a pass over the book, meant for quiet periods.
+    void shrink();
+
+    // Appends the whole state - symbols, live orders, expiries and the order of the posting lists - to out, see
+    // snapshotfile.hpp.
+    // load() rebuilds it into an empty book in bulk: orders go to consecutive slots in the saved order and posting lists
+    // are linked straight from the saved order without any lookups, so orders() and matching behave exactly as in the
+    // saved book. Corrupted input throws std::runtime_error and leaves the book empty, loading into a non empty book
+    // throws std::logic_error.
+    void save(std::string& out) const;
+    void load(std::string_view data);
+
+    // Adds, fills and removals of orders are published here as they happen, the owner subscribes and flushes the
+    // changes of an operation once it is done, see changefeed.hpp. load() doesn't publish the loaded orders.
+    ChangePublisher& changes() { return m_changes; }
+
+    // orders scanned and touched by all operations so far, counted only with ORDERCACHE_STATS - see cachestats.hpp
+    const WorkCounters& work() const { return m_work; }
+
+private:
+    struct List {
+        size_t head { npos };
+        size_t tail { npos };
+        size_t size { 0 };
+    };
+
+    struct Security {
+        List orders;
+        MatchingAggregates aggregates;
+        // on m_dirtySecurities
+        bool dirty { false };
+    };
+
+    void link(List& list, OrderStore::ListKind kind, size_t slot);
+    void unlink(List& list, OrderStore::ListKind kind, size_t slot);
+
+    // adds the order and returns its slot, npos when the orderId is taken
+    size_t insert(const Order& order);
+    bool isSell(size_t slot) const { return m_store.side(slot) == m_sellSide; }
+    Security* findSecurity(const std::string& securityId);
+    const Security* findSecurity(const std::string& securityId) const;
+
+    void remove(size_t slot, std::vector<std::string>* removedIds = nullptr);
+    void publish(OrderChange::Type type, size_t slot);
+    void relocate(size_t from);
+    void relink(List& list, OrderStore::ListKind kind, size_t slot);
+    // marks the security's matching size as changed, rank() updates the ranking of all marked ones
+    void touch(SymbolId security);
+    void rank();
+    void compactIfNeeded();
+    unsigned int greedyMatch(Security& security, std::vector<Fill>* fills);
+    unsigned int balancedMatch(Security& security, std::vector<Fill>* fills);
+    // trades qty between the sell and the buy slot, orders stay in the book until the match is over
+    void fill(Security& security, size_t sell, size_t buy, unsigned int qty, std::vector<Fill>* fills);
+    // out[i] = matching size of ids[i], npos ids get 0
+    void matchingSizes(const std::vector<SymbolId>& ids, unsigned int* out, WorkerPool* pool) const;
+    void countWork(size_t scanned, size_t touched) const
+    {
+        if constexpr (kStatsEnabled) {
+            m_work.scanned += scanned;
+            m_work.touched += touched;
+        }
+    }
+
+    // books smaller than a segment are never compacted incrementally, orders moved per cancel once compaction started
+    static constexpr size_t kMinCompactionSlots = OrderStore::kSegmentSlots;
+    static constexpr size_t kCompactionMoves = 32;
+    // securities per task of a parallel matchingSizes()
+    static constexpr size_t kMatchingChunk = 1024;
+
+    OrderStore m_store;
+    // scratch slots of the min qty sweep and of the matching, grown once and reused
+    std::vector<uint32_t> m_scanBuffer;
+    BalancedMatcher m_matcher;
+    // matchingSize() is const yet it scans the aggregates
+    mutable WorkCounters m_work;
+    mutable size_t m_peakBytes { 0 };
+    double m_compactionThreshold { 0.25 };
+    bool m_compacting { false };
+
+    // estimate of the orderId index memory per order: a hash node with a cached hash plus the key bytes
+    static constexpr size_t kIndexBytesPerOrder = 80;
+
+    Arena m_arena;
+    // keys are views of orderId copies allocated from m_arena
+    std::pmr::unordered_map<std::string_view, size_t> m_orderIds { &m_arena };
+
+    SymbolTable m_securityIds;
+    SymbolTable m_sides;
+    SymbolTable m_users;
+    SymbolTable m_companies;
+    SymbolId m_sellSide;
+
+    // indexed by SymbolId
+    std::vector<List> m_userOrders;
+    std::vector<List> m_companyOrders;
+    std::vector<Security> m_securities;
+    SecurityRanking m_ranking;
+    std::vector<SymbolId> m_dirtySecurities;
+
+    ChangePublisher m_changes;
+
+    // timer by slot, TimingWheel::npos for orders without expiry - it grows only up to the last slot which had one
+    std::vector<uint32_t> m_timers;
+    TimingWheel m_expiry;
+};
+
+#endif // ORDERBOOK_HPP
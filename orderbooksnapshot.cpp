@@ -0,0 +1,11 @@
+#include "orderbooksnapshot.hpp"
+
+std::vector<Order> OrderBookSnapshot::orders() const
+{
+    std::vector<Order> out;
+    out.reserve(size());
+    forEach([&out](const Entry& order) {
+        out.emplace_back(order.orderId, order.securityId, order.side, order.qty, order.user, order.company);
+    });
+    return out;
+}
@@ -0,0 +1,59 @@
+#ifndef ORDERBOOKSNAPSHOT_HPP
+#define ORDERBOOKSNAPSHOT_HPP
+
+#include "order.hpp"
+#include "orderstore.hpp"
+#include "symboltable.hpp"
+
+#include <string>
+#include <vector>
+
+// Consistent point-in-time view of an OrderBook taken by OrderBook::snapshot(). It shares the book's segments and
+// symbol chunks (see OrderStore and SymbolTable::View) so taking one costs O(#segments) under the owner's lock and
+// reading it needs no lock at all - the book copies a segment before writing to it while a snapshot holds it.
+// Memory of old segment versions is reclaimed when the last snapshot referencing them is destroyed.
+class OrderBookSnapshot {
+public:
+    struct Entry {
+        const std::string& orderId;
+        const std::string& securityId;
+        const std::string& side;
+        unsigned int qty;
+        const std::string& user;
+        const std::string& company;
+    };
+
+    OrderBookSnapshot() = default;
+
+    size_t size() const { return m_size; }
+
+    // calls f(const Entry&) for every order of the snapshot
+    template <typename F>
+    void forEach(F&& f) const
+    {
+        for (size_t slot = 0; slot < m_capacity; ++slot) {
+            const auto& segment = *m_segments[slot / OrderStore::kSegmentSlots];
+            const size_t i = slot % OrderStore::kSegmentSlots;
+            if (segment.live[i]) {
+                f(Entry { segment.orderId[i], m_securityIds.name(segment.security[i]), m_sides.name(segment.side[i]),
+                    segment.qty[i], m_users.name(segment.user[i]), m_companies.name(segment.company[i]) });
+            }
+        }
+    }
+
+    std::vector<Order> orders() const;
+
+private:
+    friend class OrderBook;
+
+    OrderStore::Segments m_segments;
+    size_t m_capacity { 0 };
+    size_t m_size { 0 };
+
+    SymbolTable::View m_securityIds;
+    SymbolTable::View m_sides;
+    SymbolTable::View m_users;
+    SymbolTable::View m_companies;
+};
+
+#endif // ORDERBOOKSNAPSHOT_HPP
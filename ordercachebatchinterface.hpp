@@ -0,0 +1,22 @@
+#ifndef ORDER_CACHE_BATCH_INTERFACE_HPP
+#define ORDER_CACHE_BATCH_INTERFACE_HPP
+
+#include "order.hpp"
+
+#include <string>
+#include <vector>
+
+// Batch counterparts of the OrderCacheInterface mutations. The outcome is the same as applying the operations one by
+// one in the given order, yet locks are taken once per batch (or once per shard) and storage and indexes are grown
+// once up front instead of on every insert.
+class OrderCacheBatchInterface {
+
+public:
+    virtual ~OrderCacheBatchInterface() = default;
+
+    virtual void addOrders(const std::vector<Order>& orders) = 0;
+    virtual void cancelOrders(const std::vector<std::string>& orderIds) = 0;
+    virtual void cancelOrdersForUsers(const std::vector<std::string>& users) = 0;
+};
+
+#endif // ORDER_CACHE_BATCH_INTERFACE_HPP
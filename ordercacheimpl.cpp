@@ -1,173 +1,437 @@
 #include "ordercacheimpl.hpp"
+#include "mappedfile.hpp"
+#include "snapshotfile.hpp"
 
-#include <algorithm>
+#include <stdexcept>
 
-void OrderCacheImpl::addOrder(Order order) { m_orders.push_back(std::move(order)); }
+#include <unistd.h>
+
+void OrderCacheImpl::addOrder(Order order)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::AddOrder);
+    StatsLock lock(m_mutex, call, &m_book.work());
+    const uint64_t sequence = journal(order);
+    m_book.add(order);
+    m_book.changes().flush();
+    lock.unlock();
+    commit(sequence);
+}
+
+void OrderCacheImpl::addOrder(Order order, expiry::Clock::time_point expiresAt)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::AddOrder);
+    StatsLock lock(m_mutex, call, &m_book.work());
+    const uint64_t deadline = expiry::deadline(expiresAt);
+    const uint64_t sequence = journal(order, deadline);
+    m_book.add(order, deadline);
+    m_book.changes().flush();
+    lock.unlock();
+    commit(sequence);
+}
+
+std::vector<std::string> OrderCacheImpl::tick(expiry::Clock::time_point now)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::ExpireOrders);
+    StatsLock lock(m_mutex, call, &m_book.work());
+    if (m_expiryError) {
+        std::rethrow_exception(std::exchange(m_expiryError, nullptr));
+    }
+    std::vector<std::string> removedIds;
+    uint64_t sequence = kNotJournaled;
+    m_book.expire(expiry::reading(now), &removedIds, [&] { sequence = journalCancels(removedIds); });
+    m_book.changes().flush();
+    lock.unlock();
+    commit(sequence);
+    return removedIds;
+}
+
+void OrderCacheImpl::startExpiry(std::chrono::milliseconds interval)
+{
+    m_expiryTicker = std::make_unique<Ticker>(interval, [this] {
+        try {
+            tick(expiry::Clock::now());
+        } catch (...) {
+            std::scoped_lock lock(m_mutex);
+            m_expiryError = std::current_exception();
+            throw;
+        }
+    });
+}
+
+void OrderCacheImpl::stopExpiry()
+{
+    m_expiryTicker.reset();
+    std::unique_lock lock(m_mutex);
+    if (m_expiryError) {
+        const std::exception_ptr error = std::exchange(m_expiryError, nullptr);
+        lock.unlock();
+        std::rethrow_exception(error);
+    }
+}
 
 void OrderCacheImpl::cancelOrder(const std::string& orderId)
 {
-    std::scoped_lock lock(m_remove_order_mutex);
-    m_orders.erase(
-        std::find_if(m_orders.begin(), m_orders.end(), [&orderId](auto& order) { return orderId == order.orderId(); }));
+    StatsRecorder::Call call(m_stats, CacheOperation::CancelOrder);
+    StatsLock lock(m_mutex, call, &m_book.work());
+    const uint64_t sequence = journal(orderlog::EventType::Cancel, orderId);
+    m_book.cancel(orderId);
+    m_book.changes().flush();
+    lock.unlock();
+    commit(sequence);
 }
 
 void OrderCacheImpl::cancelOrdersForUser(const std::string& user)
 {
-    std::scoped_lock lock(m_remove_order_mutex);
-    auto it { m_orders.begin() };
-    while (it != m_orders.end()) {
-        it = m_orders.erase(std::find_if(m_orders.begin(), m_orders.end(), [&user](auto& order) { return user == order.user(); }));
-    }
+    StatsRecorder::Call call(m_stats, CacheOperation::CancelOrdersForUser);
+    StatsLock lock(m_mutex, call, &m_book.work());
+    const uint64_t sequence = journal(orderlog::EventType::CancelForUser, user);
+    m_book.cancelForUser(user);
+    m_book.changes().flush();
+    lock.unlock();
+    commit(sequence);
 }
 
 void OrderCacheImpl::cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty)
 {
-    std::scoped_lock lock(m_remove_order_mutex);
-    m_orders.erase(std::remove_if(m_orders.begin(), m_orders.end(), [&securityId, minQty](const Order& order) {
-        return securityId == order.securityId() && order.qty() >= minQty;
-    }),
-        m_orders.end());
+    StatsRecorder::Call call(m_stats, CacheOperation::CancelOrdersForSecIdWithMinimumQty);
+    StatsLock lock(m_mutex, call, &m_book.work());
+    const uint64_t sequence = journal(orderlog::EventType::CancelForSecIdWithMinimumQty, securityId, minQty);
+    m_book.cancelForSecIdWithMinimumQty(securityId, minQty);
+    m_book.changes().flush();
+    lock.unlock();
+    commit(sequence);
 }
 
-std::pair<std::vector<size_t>, std::vector<size_t>> OrderCacheImpl::splitOrdersIdsByOrderType(std::vector<size_t>& ordersIds)
+unsigned int OrderCacheImpl::getMatchingSizeForSecurity(const std::string& securityId)
 {
-    auto it = std::stable_partition(ordersIds.begin(), ordersIds.end(), [&orders = m_orders](auto elem) { return orders[elem].side() == "Sell"; });
-    std::vector<size_t> buyOrdersIds(it, ordersIds.end());
+    StatsRecorder::Call call(m_stats, CacheOperation::GetMatchingSizeForSecurity);
+    StatsLock lock(m_mutex, call, &m_book.work());
+    return m_book.matchingSize(securityId);
+}
 
-    ordersIds.erase(it, ordersIds.end());
+unsigned int OrderCacheImpl::getMatchingSizeForSecurity2(const std::string& securityId)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::GetMatchingSizeForSecurity2);
+    StatsLock lock(m_mutex, call, &m_book.work());
+    const uint64_t sequence = journal(orderlog::EventType::MatchingSize2, securityId);
+    // this implementation does cleanup by removing fully filled orders of the security from the book
+    const unsigned int out = m_book.match(securityId);
+    m_book.changes().flush();
+    lock.unlock();
+    commit(sequence);
+    return out;
+}
 
-    return { ordersIds, buyOrdersIds };
+std::vector<Fill> OrderCacheImpl::matchSecurity(const std::string& securityId, MatchingMode mode)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::MatchSecurity);
+    StatsLock lock(m_mutex, call, &m_book.work());
+    const uint64_t sequence = journal(mode == MatchingMode::Balanced ? orderlog::EventType::MatchBalanced : orderlog::EventType::MatchingSize2, securityId);
+    std::vector<Fill> fills;
+    m_book.match(securityId, nullptr, &fills, mode);
+    m_book.changes().flush();
+    lock.unlock();
+    commit(sequence);
+    return fills;
 }
 
-std::pair<std::vector<size_t>, std::vector<size_t>> OrderCacheImpl::getOrdersIdsFor(const std::string& securityId)
+std::vector<std::string> OrderCacheImpl::cancelOrdersForCompany(const std::string& company)
 {
-    std::vector<size_t> ordersIds;
-    for (auto it = m_orders.begin(); it != m_orders.end();) {
-        it = std::find_if(it, m_orders.end(), [&securityId](const Order& order) { return order.securityId() == securityId; });
-        if (it != m_orders.end()) {
-            ordersIds.emplace_back(std::distance(m_orders.begin(), it));
-            it++;
-        }
+    StatsRecorder::Call call(m_stats, CacheOperation::CancelOrdersForCompany);
+    StatsLock lock(m_mutex, call, &m_book.work());
+    std::vector<std::string> removedIds;
+    m_book.cancelForCompany(company, &removedIds);
+    const uint64_t sequence = journalCancels(removedIds);
+    m_book.changes().flush();
+    lock.unlock();
+    commit(sequence);
+    return removedIds;
+}
+
+std::vector<std::string> OrderCacheImpl::cancelOrdersMatching(const OrderFilter& filter)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::CancelOrdersMatching);
+    StatsLock lock(m_mutex, call, &m_book.work());
+    std::vector<std::string> removedIds;
+    m_book.cancelMatching(filter, &removedIds);
+    const uint64_t sequence = journalCancels(removedIds);
+    m_book.changes().flush();
+    lock.unlock();
+    commit(sequence);
+    return removedIds;
+}
+
+std::vector<unsigned int> OrderCacheImpl::getMatchingSizes(const std::vector<std::string>& securityIds)
+{
+    std::scoped_lock lock(m_mutex);
+    return m_book.matchingSizes(securityIds, &m_workers);
+}
+
+std::vector<std::pair<std::string, unsigned int>> OrderCacheImpl::getMatchingSizes()
+{
+    std::scoped_lock lock(m_mutex);
+    return m_book.matchingSizes(&m_workers);
+}
+
+std::vector<std::pair<std::string, unsigned int>> OrderCacheImpl::getTopMatchingSizes(size_t n) const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_book.topMatchingSizes(n);
+}
+
+std::vector<Order> OrderCacheImpl::getAllOrders() const
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::GetAllOrders);
+    StatsLock lock(m_mutex, call);
+    const OrderBookSnapshot snapshot = m_book.snapshot();
+    lock.unlock();
+    return snapshot.orders();
+}
+
+void OrderCacheImpl::addOrders(const std::vector<Order>& orders)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::AddOrders);
+    StatsLock lock(m_mutex, call, &m_book.work());
+    uint64_t sequence = kNotJournaled;
+    for (const auto& order : orders) {
+        sequence = journal(order);
     }
-    return splitOrdersIdsByOrderType(ordersIds);
+    m_book.add(orders);
+    m_book.changes().flush();
+    lock.unlock();
+    commit(sequence);
 }
 
-unsigned int OrderCacheImpl::getMatchingSizeForSecurity(const std::string& securityId)
+void OrderCacheImpl::cancelOrders(const std::vector<std::string>& orderIds)
 {
-    // adding orders doesn't seem to require a locking, if new order would be added after getOrdersFor() call then
-    // won't be calculated within this getMatchingSizeForSecurity() call
-    // removing is more complicated scenario cause it invalidates indexes
-    std::scoped_lock lock(m_remove_order_mutex);
-    auto [sell_orders, buy_orders] = getOrdersIdsFor(securityId);
-    if (!sell_orders.size() || !buy_orders.size()) {
-        return 0;
-    }
-
-    unsigned int out = 0;
-    for (auto& sell_order : sell_orders) {
-        for (auto& buy_order : buy_orders) {
-            if (m_orders[sell_order].company() != m_orders[buy_order].company()) {
-                unsigned int transaction_qty = 0;
-                if (m_orders[sell_order].qty() >= m_orders[buy_order].qty()) {
-                    transaction_qty = m_orders[buy_order].qty();
-                    m_orders[sell_order] -= transaction_qty;
-                    m_orders[buy_order] -= transaction_qty;
-                } else {
-                    transaction_qty = m_orders[sell_order].qty();
-                    m_orders[buy_order] -= transaction_qty;
-                    m_orders[sell_order] -= transaction_qty;
-                }
-
-                out += transaction_qty;
-
-                if (m_orders[sell_order].qty() == 0) {
-                    break;
-                }
-            }
-        }
+    StatsRecorder::Call call(m_stats, CacheOperation::CancelOrders);
+    StatsLock lock(m_mutex, call, &m_book.work());
+    uint64_t sequence = kNotJournaled;
+    for (const auto& orderId : orderIds) {
+        sequence = journal(orderlog::EventType::Cancel, orderId);
     }
+    m_book.cancel(orderIds);
+    m_book.changes().flush();
+    lock.unlock();
+    commit(sequence);
+}
 
-    return out;
-    // in such implementation (more API desing) it might be good to schedule some kind of cleaner execution here
-    // to get rid of all orders where qty == 0 now, we probably don't want to bother those in next iteration
-    // it could be done here since getMatchingSizeForSecurity() is not const yet, probably we woud be interested in good
-    // performacne here, on the other hand dox didn't say anything about that.
+void OrderCacheImpl::cancelOrdersForUsers(const std::vector<std::string>& users)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::CancelOrdersForUsers);
+    StatsLock lock(m_mutex, call, &m_book.work());
+    uint64_t sequence = kNotJournaled;
+    for (const auto& user : users) {
+        sequence = journal(orderlog::EventType::CancelForUser, user);
+    }
+    m_book.cancelForUsers(users);
+    m_book.changes().flush();
+    lock.unlock();
+    commit(sequence);
 }
 
-std::pair<std::vector<Order>, std::vector<Order>> OrderCacheImpl::splitOrdersByType(std::vector<Order>& orders)
+void OrderCacheImpl::reserve(size_t expectedOrders)
 {
-    auto it = std::stable_partition(orders.begin(), orders.end(), [](const auto& order) { return order.side() == "Sell"; });
-    std::vector<Order> buyOrders;
-    std::move(it, orders.end(), std::back_inserter(buyOrders));
+    std::scoped_lock lock(m_mutex);
+    m_book.reserve(expectedOrders);
+}
 
-    orders.erase(it, orders.end());
+void OrderCacheImpl::setCompactionThreshold(double deadRatio)
+{
+    std::scoped_lock lock(m_mutex);
+    m_book.setCompactionThreshold(deadRatio);
+}
 
-    return { orders, buyOrders };
+void OrderCacheImpl::compact()
+{
+    std::scoped_lock lock(m_mutex);
+    m_book.compact();
 }
 
-std::pair<std::vector<Order>, std::vector<Order>> OrderCacheImpl::getOrdersFor(const std::string& securityId)
+MemoryUsage OrderCacheImpl::memoryUsage() const
 {
-    std::unique_lock ulock(m_remove_order_mutex);
-    std::vector<Order> ordersIds;
-    for (auto it = m_orders.begin(); it != m_orders.end();) {
-        it = std::find_if(it, m_orders.end(), [&securityId](const Order& order) { return order.securityId() == securityId; });
-        if (it != m_orders.end()) {
-            ordersIds.push_back(std::move(*it));
-            m_orders.erase(it);
-            it = m_orders.begin();
-        }
+    std::scoped_lock lock(m_mutex);
+    return m_book.memoryUsage();
+}
+
+void OrderCacheImpl::shrink()
+{
+    std::scoped_lock lock(m_mutex);
+    m_book.shrink();
+}
+
+void OrderCacheImpl::saveSnapshot(const std::string& path) const
+{
+    writeSnapshot(path);
+}
+
+void OrderCacheImpl::loadSnapshot(const std::string& path)
+{
+    const MappedFile file(path);
+    const auto contents = snapshotfile::read({ file.data(), file.size() });
+    if (contents.books.size() != 1) {
+        throw std::runtime_error("snapshot of " + std::to_string(contents.books.size()) + " books can't be loaded into OrderCacheImpl");
     }
-    ulock.unlock();
-    return splitOrdersByType(ordersIds);
+    std::scoped_lock lock(m_mutex);
+    m_book.load(contents.books.front());
+    m_journalSequence = contents.journalSequence;
 }
 
-unsigned int OrderCacheImpl::getMatchingSizeForSecurity2(const std::string& securityId)
+void OrderCacheImpl::recover(const std::string& snapshotPath, const std::string& journalPath)
 {
-    auto [sell_orders, buy_orders] = getOrdersFor(securityId);
-
-    unsigned int out = 0;
-    if (sell_orders.size() and buy_orders.size()) {
-
-        for (auto& sell_order : sell_orders) {
-            for (auto& buy_order : buy_orders) {
-                if (sell_order.company() != buy_order.company()) {
-                    unsigned int transaction_qty = 0;
-                    if (sell_order.qty() >= buy_order.qty()) {
-                        transaction_qty = buy_order.qty();
-                        sell_order -= transaction_qty;
-                        buy_order -= transaction_qty;
-                    } else {
-                        transaction_qty = sell_order.qty();
-                        buy_order -= transaction_qty;
-                        sell_order -= transaction_qty;
-                    }
-
-                    out += transaction_qty;
-
-                    if (sell_order.qty() == 0) {
-                        break;
-                    }
-                }
-            }
-        }
+    if (::access(snapshotPath.c_str(), F_OK) == 0) {
+        loadSnapshot(snapshotPath);
     }
-    insertOrders(sell_orders);
-    insertOrders(buy_orders);
+    std::scoped_lock lock(m_mutex);
+    m_journalSequence = Journal::replay(journalPath, m_journalSequence, [this](const orderlog::Event& event) { apply(event); });
+    m_book.changes().flush();
+}
 
-    return out;
-    // this implementation does cleanup by moving elements in getOrdersFor() function
+void OrderCacheImpl::startJournal(const std::string& path, Journal::Options options)
+{
+    std::scoped_lock lock(m_mutex);
+    m_journal = std::make_unique<Journal>(path, options, m_journalSequence);
 }
 
-void OrderCacheImpl::insertOrders(std::vector<Order>& orders)
+void OrderCacheImpl::checkpoint(const std::string& snapshotPath)
 {
-    for (auto& order : orders) {
-        if (order.qty() > 0) {
-            m_orders.push_back(std::move(order));
-        }
+    const uint64_t sequence = writeSnapshot(snapshotPath);
+    if (m_journal) {
+        m_journal->discardBefore(sequence);
     }
 }
 
-std::vector<Order> OrderCacheImpl::getAllOrders() const
+std::shared_ptr<ChangeSubscription> OrderCacheImpl::subscribe(ChangeFilter filter, size_t capacity, OrderBookSnapshot* snapshot)
+{
+    auto subscription = std::make_shared<ChangeSubscription>(std::move(filter), capacity);
+    std::scoped_lock lock(m_mutex);
+    m_book.changes().subscribe(subscription);
+    if (snapshot) {
+        *snapshot = m_book.snapshot();
+    }
+    return subscription;
+}
+
+void OrderCacheImpl::unsubscribe(const std::shared_ptr<ChangeSubscription>& subscription)
 {
-    return m_orders;
+    std::scoped_lock lock(m_mutex);
+    m_book.changes().unsubscribe(subscription.get());
+}
+
+CacheStats OrderCacheImpl::stats() const
+{
+    return m_stats.stats();
+}
+
+void OrderCacheImpl::resetStats()
+{
+    m_stats.reset();
+}
+
+OrderBookSnapshot OrderCacheImpl::snapshot() const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_book.snapshot();
+}
+
+uint64_t OrderCacheImpl::writeSnapshot(const std::string& path) const
+{
+    std::vector<std::string> books(1);
+    uint64_t sequence = 0;
+    {
+        std::scoped_lock lock(m_mutex);
+        m_book.save(books.front());
+        sequence = m_journal ? m_journal->nextSequence() : m_journalSequence;
+    }
+    snapshotfile::write(path, books, sequence);
+    return sequence;
+}
+
+uint64_t OrderCacheImpl::journal(const Order& order, std::optional<uint64_t> deadline)
+{
+    if (!m_journal) {
+        return kNotJournaled;
+    }
+    orderlog::Event event;
+    event.type = deadline ? orderlog::EventType::AddWithExpiry : orderlog::EventType::Add;
+    event.expiresAt = deadline.value_or(0);
+    event.orderId = order.orderIdView();
+    event.securityId = order.securityIdView();
+    event.side = order.sideView();
+    event.qty = order.qty();
+    event.user = order.userView();
+    event.company = order.companyView();
+    return m_journal->append(event);
+}
+
+uint64_t OrderCacheImpl::journal(orderlog::EventType type, const std::string& name, unsigned int qty)
+{
+    if (!m_journal) {
+        return kNotJournaled;
+    }
+    orderlog::Event event;
+    event.type = type;
+    event.qty = qty;
+    switch (type) {
+    case orderlog::EventType::Cancel:
+        event.orderId = name;
+        break;
+    case orderlog::EventType::CancelForUser:
+        event.user = name;
+        break;
+    default:
+        event.securityId = name;
+        break;
+    }
+    return m_journal->append(event);
+}
+
+// the journal has no events for these cancels, they are logged by orderId once the book knows which orders they hit -
+// still under the mutex, so nothing can be journaled in between
+uint64_t OrderCacheImpl::journalCancels(const std::vector<std::string>& orderIds)
+{
+    uint64_t sequence = kNotJournaled;
+    for (const auto& orderId : orderIds) {
+        sequence = journal(orderlog::EventType::Cancel, orderId);
+    }
+    return sequence;
+}
+
+void OrderCacheImpl::commit(uint64_t sequence)
+{
+    if (sequence != kNotJournaled) {
+        m_journal->wait(sequence);
+    }
+}
+
+void OrderCacheImpl::apply(const orderlog::Event& event)
+{
+    switch (event.type) {
+    case orderlog::EventType::Add:
+        m_book.add({ std::string(event.orderId), std::string(event.securityId), std::string(event.side), event.qty,
+            std::string(event.user), std::string(event.company) });
+        break;
+    case orderlog::EventType::Cancel:
+        m_book.cancel(std::string(event.orderId));
+        break;
+    case orderlog::EventType::CancelForUser:
+        m_book.cancelForUser(std::string(event.user));
+        break;
+    case orderlog::EventType::CancelForSecIdWithMinimumQty:
+        m_book.cancelForSecIdWithMinimumQty(std::string(event.securityId), event.qty);
+        break;
+    case orderlog::EventType::MatchingSize:
+        break;
+    case orderlog::EventType::MatchingSize2:
+        m_book.match(std::string(event.securityId));
+        break;
+    case orderlog::EventType::MatchBalanced:
+        m_book.match(std::string(event.securityId), nullptr, nullptr, MatchingMode::Balanced);
+        break;
+    case orderlog::EventType::AddWithExpiry:
+        m_book.add({ std::string(event.orderId), std::string(event.securityId), std::string(event.side), event.qty,
+                       std::string(event.user), std::string(event.company) },
+            event.expiresAt);
+        break;
+    }
 }
@@ -1,57 +1,168 @@
 #ifndef ORDERCACHEIMPL1_HPP
 #define ORDERCACHEIMPL1_HPP
 
+#include "cachestats.hpp"
+#include "changefeed.hpp"
+#include "journal.hpp"
+#include "memoryusage.hpp"
+#include "orderfilter.hpp"
+#include "ordercachebatchinterface.hpp"
 #include "ordercacheinterface.hpp"
+#include "orderbook.hpp"
+#include "ticker.hpp"
+#include "timingwheel.hpp"
 
+#include <chrono>
+#include <exception>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
 #include <vector>
 
-class OrderCacheImpl : public OrderCacheInterface {
+class OrderCacheImpl : public OrderCacheInterface, public OrderCacheBatchInterface {
 public:
     ~OrderCacheImpl() = default;
 
     // OrderCacheInterface interface
+    // orders with an orderId which is already in the cache are rejected (ignored)
     void addOrder(Order order) override;
     void cancelOrder(const std::string& orderId) override;
     void cancelOrdersForUser(const std::string& user) override;
     void cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty) override;
 
-    // This particular impl will not cancel/update matching orders yet I left the comment in code where cleanup shall be done if needed.
+    // This particular impl will not cancel/update matching orders, the size is computed from per-security aggregates
+    // in O(#companies of the security) - see matchingaggregates.hpp.
     unsigned int getMatchingSizeForSecurity(const std::string& securityId) override;
 
     // additional impl providing the same functionality but changes the state of the object, the container with orders
-    // will have updated orders and removed fully matched (qty == 0) after each call to that function but thanks to that
-    // the scope of locks is decreased significantly, unfortunatelly provided example data is too small to measure the difference
-    // yet it was fun task to implement that.
+    // will have updated orders and removed fully matched (qty == 0) after each call to that function.
     unsigned int getMatchingSizeForSecurity2(const std::string& securityId) override;
 
+    // Matches the security like getMatchingSizeForSecurity2 and returns the executions, see matchingengine.hpp. Greedy
+    // gives exactly what getMatchingSizeForSecurity2 would do (and is journaled as one), so the two engines can be
+    // diffed on the same book. Balanced trades getMatchingSizeForSecurity in O((S + B) log C).
+    std::vector<Fill> matchSecurity(const std::string& securityId, MatchingMode mode = MatchingMode::Balanced);
+
+    // Mass cancels (e.g. a kill switch pulling every order of a company) walking the company posting list or the most
+    // selective posting list of the filter, see OrderBook::cancelMatching. All removals happen under one lock
+    // acquisition, orderIds of the cancelled orders are returned. They are journaled as single order cancels.
+    std::vector<std::string> cancelOrdersForCompany(const std::string& company);
+    std::vector<std::string> cancelOrdersMatching(const OrderFilter& filter);
+
+    // getMatchingSizeForSecurity of many securities (unknown ones get 0) or of every security with orders (sorted by
+    // securityId) under a single lock, big requests are split across a worker pool started by the first of them
+    std::vector<unsigned int> getMatchingSizes(const std::vector<std::string>& securityIds);
+    std::vector<std::pair<std::string, unsigned int>> getMatchingSizes();
+
+    // <securityId, matching size> of the n securities with the most matchable quantity, biggest first - read from a
+    // ranking the book keeps up to date, O(n log n) regardless of the book size. Nothing is matched or changed.
+    std::vector<std::pair<std::string, unsigned int>> getTopMatchingSizes(size_t n) const;
+
+    // built from a snapshot, the mutex is held only while the snapshot is taken
     std::vector<Order> getAllOrders() const override;
+
+    // Good-till-time orders: an order added with an expiry is cancelled by the first tick(now) with now >= expiresAt,
+    // at millisecond resolution. Timers sit in the book's TimingWheel (see timingwheel.hpp) so adding and cancelling
+    // them is O(1), tick() removes what expired in one batch and returns the orderIds. Either call tick() from an own
+    // clock (e.g. simulated time of a backtest) or startExpiry() a background thread which ticks with the wall clock.
+    // The journal keeps such an order with its deadline and its expiry as a cancel, snapshots keep the deadlines too -
+    // recovered and loaded orders expire as they would have, the ones due meanwhile on the first tick().
+    // tick() journals the cancels before it removes anything, an order whose cancel couldn't be journaled stays. An
+    // error of the background thread stops it and is rethrown by the next tick() or stopExpiry().
+    void addOrder(Order order, expiry::Clock::time_point expiresAt);
+    std::vector<std::string> tick(expiry::Clock::time_point now);
+    void startExpiry(std::chrono::milliseconds interval = std::chrono::milliseconds(10));
+    void stopExpiry();
+
+    // OrderCacheBatchInterface interface
+    void addOrders(const std::vector<Order>& orders) override;
+    void cancelOrders(const std::vector<std::string>& orderIds) override;
+    void cancelOrdersForUsers(const std::vector<std::string>& users) override;
+
+    // preallocates and touches memory for that many orders, meant to be called at startup so the first minutes of
+    // trading don't pay for malloc calls and page faults
+    void reserve(size_t expectedOrders);
+
+    // cancels compact the book incrementally once tombstones pass the threshold (ratio of all slots), 0 disables it
+    // and leaves compaction to compact() which can be called e.g. periodically from a background thread
+    void setCompactionThreshold(double deadRatio);
+    void compact();
+
+    // footprint of the cache by component along with its peak, see memoryusage.hpp - it walks the whole book under
+    // the mutex. shrink() gives slack (tombstones, pooled segments, oversized buffers) back to the allocator.
+    MemoryUsage memoryUsage() const;
+    void shrink();
+
+    // Binary snapshot of the whole cache for warm restarts, see snapshotfile.hpp. The state is serialized into memory
+    // under the mutex and written out after it is released. loadSnapshot() maps the file and rebuilds the book in bulk,
+    // it is meant for an empty cache at startup (std::logic_error otherwise), a bad file throws std::runtime_error.
+    void saveSnapshot(const std::string& path) const;
+    void loadSnapshot(const std::string& path);
+
+    // Durability through a write-ahead journal (see journal.hpp), all of it is meant to be called at startup before
+    // the cache is shared with other threads.
+    // recover() loads the snapshot and replays the journal events it doesn't cover, either file may be missing. A
+    // journal starting after the snapshot's events throws std::runtime_error, the events in between are lost.
+    // startJournal() journals every mutation from then on - adds, cancels and fills of getMatchingSizeForSecurity2
+    // and matchSecurity, getMatchingSizeForSecurity doesn't change the book so it isn't journaled. A mutation is journaled before it is
+    // applied, with Journal::Options::waitForCommit the call returns once its group commit is synced.
+    // checkpoint() saves a snapshot and drops the journal events it covers, recovery needs that very snapshot then.
+    void recover(const std::string& snapshotPath, const std::string& journalPath);
+    void startJournal(const std::string& path, Journal::Options options = {});
+    void checkpoint(const std::string& snapshotPath);
+
+    // Change data capture, see changefeed.hpp. A subscription gets a batch of changes per operation which touched orders
+    // it is interested in, starting with the state stored to snapshot if one is given (taken under the same lock).
+    // Changes are buffered under the mutex and handed over before it is released, the subscriber drains them without
+    // touching the cache. Snapshot loads aren't published.
+    std::shared_ptr<ChangeSubscription> subscribe(ChangeFilter filter = {}, size_t capacity = 1024, OrderBookSnapshot* snapshot = nullptr);
+    void unsubscribe(const std::shared_ptr<ChangeSubscription>& subscription);
+
+    // consistent point-in-time view of the cache which can be iterated without blocking writers
+    OrderBookSnapshot snapshot() const;
+
+    // per operation latencies, lock wait/hold times and work counters, see cachestats.hpp - all zero unless built
+    // with ORDERCACHE_STATS
+    CacheStats stats() const;
+    void resetStats();
     /*notes:
      * The interface could be improved - adding, canceling orders could return an information if operation succeded.
      * getMatchingSizeForSecurity is not marked as const which makes the interface bit ambigous cause docs are not sharing more details about the state of orders when matched,
      * shall those be updated or cancelled/removed from the list of pending orders ?
      *
-     * This impl utilizes a std::vector as a container for orders yet if the performance would be the key factor probably unordered_multimap would be better,
-     * but the problem with unordered_multimap is that the requested API doesn't express which property of Order shall be used as a Key,
-     * i.e. it looks like the implememtation should focus on getMatchingSizeForSecurity's performance so securityId could be used as a Key
-     * but if there would be many calls to cancelOrder() or cancelOrdersForUser() then it would anyway require traversing through whole map slowing down the execution.
-     * Ofc it could always be implemented in other ways yet it would require better understanding of the requirements so I didn't spend time on that.
+     * Orders are kept in an OrderBook which indexes them by orderId and keeps per-user and per-security posting lists,
+     * so none of the operations has to traverse the whole book - see orderbook.hpp for details.
      *
-     * Additional note, this impl is not designed to work correctly with concurrent calls to both getMatchingSizeForSecurity() and getMatchingSizeForSecurity2()
-     * It may work yet I didn't test and thought about that during implementing those. It's kind of use One-or-Another API extention.
+     * Every operation takes the same mutex so concurrent calls are safe, yet they are serialized. Waiting for a journal
+     * commit happens after the mutex is released, so concurrent writers share group commits.
      */
 private:
-    // <sell_orders, buy_orders>
-    std::pair<std::vector<size_t>, std::vector<size_t>> getOrdersIdsFor(const std::string& securityId);
-    std::pair<std::vector<size_t>, std::vector<size_t>> splitOrdersIdsByOrderType(std::vector<size_t>& ordersIds);
-
-    std::pair<std::vector<Order>, std::vector<Order>> getOrdersFor(const std::string& securityId);
-    std::pair<std::vector<Order>, std::vector<Order>> splitOrdersByType(std::vector<Order>& orders);
+    static constexpr uint64_t kNotJournaled = static_cast<uint64_t>(-1);
 
-    void insertOrders(std::vector<Order>& orders);
+    // saves the book along with the sequence number of the next journal event, which is returned
+    uint64_t writeSnapshot(const std::string& path) const;
+    // append to the journal if there is one, called under m_mutex before the mutation, return the sequence number
+    uint64_t journal(const Order& order, std::optional<uint64_t> deadline = std::nullopt);
+    uint64_t journal(orderlog::EventType type, const std::string& name, unsigned int qty = 0);
+    uint64_t journalCancels(const std::vector<std::string>& orderIds);
+    // waits for the group commit of the event, called after m_mutex is released
+    void commit(uint64_t sequence);
+    // replays a journaled mutation, called under m_mutex
+    void apply(const orderlog::Event& event);
 
-    std::vector<Order> m_orders;
-    std::mutex m_remove_order_mutex;
+    OrderBook m_book;
+    mutable std::mutex m_mutex;
+    mutable StatsRecorder m_stats;
+    WorkerPool m_workers;
+    std::unique_ptr<Journal> m_journal;
+    // sequence number of the next journal event, as far as loaded snapshots and replayed journals tell
+    uint64_t m_journalSequence { 0 };
+    // what stopped the expiry thread, guarded by m_mutex until tick() or stopExpiry() rethrows it
+    std::exception_ptr m_expiryError;
+    // last member, it is stopped before the rest goes away
+    std::unique_ptr<Ticker> m_expiryTicker;
 };
 
 #endif // ORDERCACHEIMPL1_HPP
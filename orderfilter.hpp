@@ -0,0 +1,19 @@
+#ifndef ORDERFILTER_HPP
+#define ORDERFILTER_HPP
+
+#include <limits>
+#include <optional>
+#include <string>
+
+// Predicate of a mass cancel, an order is cancelled when it meets all of the given conditions - e.g. every Buy order of
+// a security with qty in [100, 500]. Conditions left empty match anything, names never seen by the cache match nothing.
+struct OrderFilter {
+    std::optional<std::string> securityId;
+    std::optional<std::string> company;
+    std::optional<std::string> user;
+    std::optional<std::string> side;
+    unsigned int minQty { 0 };
+    unsigned int maxQty { std::numeric_limits<unsigned int>::max() };
+};
+
+#endif // ORDERFILTER_HPP
@@ -0,0 +1,368 @@
+#include "orderlog.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+namespace orderlog {
+
+namespace {
+
+// the whole text has to be a number
+template <typename T>
+bool parse(std::string_view text, T& out)
+{
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), out);
+    return error == std::errc() && end == text.data() + text.size() && !text.empty();
+}
+
+} // namespace
+
+const char* name(EventType type)
+{
+    switch (type) {
+    case EventType::Add:
+        return "addOrder";
+    case EventType::Cancel:
+        return "cancelOrder";
+    case EventType::CancelForUser:
+        return "cancelOrdersForUser";
+    case EventType::CancelForSecIdWithMinimumQty:
+        return "cancelOrdersForSecIdWithMinimumQty";
+    case EventType::MatchingSize:
+        return "getMatchingSizeForSecurity";
+    case EventType::MatchingSize2:
+        return "getMatchingSizeForSecurity2";
+    case EventType::MatchBalanced:
+        return "matchSecurity";
+    case EventType::AddWithExpiry:
+        return "addOrder(expiresAt)";
+    }
+    return "unknown";
+}
+
+Reader::Reader(const char* data, size_t size)
+    : m_data(data)
+    , m_size(size)
+{
+    if (size >= kBinaryMagic.size() && std::string_view(data, kBinaryMagic.size()) == kBinaryMagic) {
+        m_binary = true;
+        m_offset = kBinaryMagic.size();
+    }
+}
+
+Reader Reader::binaryEvents(const char* data, size_t size)
+{
+    Reader out(data, size);
+    out.m_binary = true;
+    out.m_offset = 0;
+    return out;
+}
+
+bool Reader::next(Event& event)
+{
+    return m_binary ? nextBinary(event) : nextCsv(event);
+}
+
+bool Reader::nextCsv(Event& event)
+{
+    while (m_offset < m_size) {
+        const char* begin = m_data + m_offset;
+        const char* end = static_cast<const char*>(std::memchr(begin, '\n', m_size - m_offset));
+        end = end ? end : m_data + m_size;
+        m_offset = end - m_data + 1;
+        ++m_line;
+
+        std::string_view line(begin, end - begin);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+
+        const std::string_view type = field(line);
+        event = {};
+        if (type == "A") {
+            event.type = EventType::Add;
+            event.orderId = field(line);
+            event.securityId = field(line);
+            event.side = field(line);
+            event.qty = number(field(line));
+            event.user = field(line);
+            event.company = field(line);
+        } else if (type == "C") {
+            event.type = EventType::Cancel;
+            event.orderId = field(line);
+        } else if (type == "U") {
+            event.type = EventType::CancelForUser;
+            event.user = field(line);
+        } else if (type == "S") {
+            event.type = EventType::CancelForSecIdWithMinimumQty;
+            event.securityId = field(line);
+            event.qty = number(field(line));
+        } else if (type == "M") {
+            event.type = EventType::MatchingSize;
+            event.securityId = field(line);
+        } else if (type == "M2") {
+            event.type = EventType::MatchingSize2;
+            event.securityId = field(line);
+        } else if (type == "MB") {
+            event.type = EventType::MatchBalanced;
+            event.securityId = field(line);
+        } else if (type == "AE") {
+            event.type = EventType::AddWithExpiry;
+            event.orderId = field(line);
+            event.securityId = field(line);
+            event.side = field(line);
+            event.qty = number(field(line));
+            event.user = field(line);
+            event.company = field(line);
+            event.expiresAt = timestamp(field(line));
+        } else {
+            fail("unknown event type '" + std::string(type) + "'");
+        }
+        if (line.data()) {
+            fail("too many fields");
+        }
+        return true;
+    }
+    return false;
+}
+
+// consumes the next comma separated field, line.data() becomes null once the last field is consumed
+std::string_view Reader::field(std::string_view& line) const
+{
+    if (!line.data()) {
+        fail("missing field");
+    }
+    const size_t comma = line.find(',');
+    std::string_view out = line.substr(0, comma);
+    line = comma == std::string_view::npos ? std::string_view() : line.substr(comma + 1);
+    return out;
+}
+
+unsigned int Reader::number(std::string_view text) const
+{
+    unsigned int out = 0;
+    if (!parse(text, out)) {
+        fail("bad quantity '" + std::string(text) + "'");
+    }
+    return out;
+}
+
+uint64_t Reader::timestamp(std::string_view text) const
+{
+    uint64_t out = 0;
+    if (!parse(text, out)) {
+        fail("bad expiry '" + std::string(text) + "'");
+    }
+    return out;
+}
+
+bool Reader::nextBinary(Event& event)
+{
+    if (m_offset == m_size) {
+        return false;
+    }
+
+    const auto type = static_cast<uint8_t>(m_data[m_offset]);
+    if (type >= kEventTypes) {
+        fail("unknown event type " + std::to_string(type));
+    }
+    ++m_offset;
+    ++m_line;
+
+    event = {};
+    event.type = static_cast<EventType>(type);
+    switch (event.type) {
+    case EventType::Add:
+        event.orderId = string();
+        event.securityId = string();
+        event.side = string();
+        event.qty = varint();
+        event.user = string();
+        event.company = string();
+        break;
+    case EventType::Cancel:
+        event.orderId = string();
+        break;
+    case EventType::CancelForUser:
+        event.user = string();
+        break;
+    case EventType::CancelForSecIdWithMinimumQty:
+        event.securityId = string();
+        event.qty = varint();
+        break;
+    case EventType::MatchingSize:
+    case EventType::MatchingSize2:
+    case EventType::MatchBalanced:
+        event.securityId = string();
+        break;
+    case EventType::AddWithExpiry:
+        event.orderId = string();
+        event.securityId = string();
+        event.side = string();
+        event.qty = varint();
+        event.user = string();
+        event.company = string();
+        event.expiresAt = varint64();
+        break;
+    }
+    return true;
+}
+
+uint32_t Reader::varint()
+{
+    const uint64_t out = varint64();
+    if (out > UINT32_MAX) {
+        fail("varint out of range");
+    }
+    return static_cast<uint32_t>(out);
+}
+
+uint64_t Reader::varint64()
+{
+    uint64_t out = 0;
+    for (unsigned shift = 0;; shift += 7) {
+        if (m_offset == m_size) {
+            fail("truncated event");
+        }
+        const auto byte = static_cast<uint8_t>(m_data[m_offset++]);
+        if (shift == 63 && byte > 0x01) {
+            fail("varint out of range");
+        }
+        out |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return out;
+        }
+    }
+}
+
+std::string_view Reader::string()
+{
+    const size_t size = varint();
+    if (m_size - m_offset < size) {
+        fail("truncated event");
+    }
+    std::string_view out(m_data + m_offset, size);
+    m_offset += size;
+    return out;
+}
+
+void Reader::fail(const std::string& what) const
+{
+    throw std::runtime_error(m_binary ? "order log event " + std::to_string(m_line) + ": " + what
+                                      : "order log line " + std::to_string(m_line) + ": " + what);
+}
+
+void appendCsv(std::string& out, const Event& event)
+{
+    auto append = [&out](std::string_view field) {
+        out += ',';
+        out += field;
+    };
+
+    switch (event.type) {
+    case EventType::Add:
+        out += 'A';
+        append(event.orderId);
+        append(event.securityId);
+        append(event.side);
+        append(std::to_string(event.qty));
+        append(event.user);
+        append(event.company);
+        break;
+    case EventType::Cancel:
+        out += 'C';
+        append(event.orderId);
+        break;
+    case EventType::CancelForUser:
+        out += 'U';
+        append(event.user);
+        break;
+    case EventType::CancelForSecIdWithMinimumQty:
+        out += 'S';
+        append(event.securityId);
+        append(std::to_string(event.qty));
+        break;
+    case EventType::MatchingSize:
+        out += 'M';
+        append(event.securityId);
+        break;
+    case EventType::MatchingSize2:
+        out += "M2";
+        append(event.securityId);
+        break;
+    case EventType::MatchBalanced:
+        out += "MB";
+        append(event.securityId);
+        break;
+    case EventType::AddWithExpiry:
+        out += "AE";
+        append(event.orderId);
+        append(event.securityId);
+        append(event.side);
+        append(std::to_string(event.qty));
+        append(event.user);
+        append(event.company);
+        append(std::to_string(event.expiresAt));
+        break;
+    }
+    out += '\n';
+}
+
+void appendBinary(std::string& out, const Event& event)
+{
+    auto varint = [&out](uint64_t value) {
+        for (; value >= 0x80; value >>= 7) {
+            out += static_cast<char>(value | 0x80);
+        }
+        out += static_cast<char>(value);
+    };
+    auto string = [&out, &varint](std::string_view field) {
+        if (field.size() > UINT32_MAX) {
+            throw std::length_error("order log field too long");
+        }
+        varint(static_cast<uint32_t>(field.size()));
+        out += field;
+    };
+
+    out += static_cast<char>(event.type);
+    switch (event.type) {
+    case EventType::Add:
+        string(event.orderId);
+        string(event.securityId);
+        string(event.side);
+        varint(event.qty);
+        string(event.user);
+        string(event.company);
+        break;
+    case EventType::Cancel:
+        string(event.orderId);
+        break;
+    case EventType::CancelForUser:
+        string(event.user);
+        break;
+    case EventType::CancelForSecIdWithMinimumQty:
+        string(event.securityId);
+        varint(event.qty);
+        break;
+    case EventType::MatchingSize:
+    case EventType::MatchingSize2:
+    case EventType::MatchBalanced:
+        string(event.securityId);
+        break;
+    case EventType::AddWithExpiry:
+        string(event.orderId);
+        string(event.securityId);
+        string(event.side);
+        varint(event.qty);
+        string(event.user);
+        string(event.company);
+        varint(event.expiresAt);
+        break;
+    }
+}
+
+} // namespace orderlog
@@ -0,0 +1,97 @@
+#ifndef ORDERLOG_HPP
+#define ORDERLOG_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Recorded order flow which the OrderCache executable replays. A log is either text (CSV) or binary, the reader tells
+// them apart by the binary magic.
+//
+// CSV, one event per line, empty lines and lines starting with '#' are skipped:
+//     A,<orderId>,<securityId>,<side>,<qty>,<user>,<company>    addOrder
+//     C,<orderId>                                                cancelOrder
+//     U,<user>                                                   cancelOrdersForUser
+//     S,<securityId>,<minQty>                                    cancelOrdersForSecIdWithMinimumQty
+//     M,<securityId>                                             getMatchingSizeForSecurity
+//     M2,<securityId>                                            getMatchingSizeForSecurity2
+//     MB,<securityId>                                            matchSecurity with MatchingMode::Balanced
+//     AE,<orderId>,<securityId>,<side>,<qty>,<user>,<company>,<expiresAt>
+//                                                                addOrder of a good-till-time order, expiresAt in ms
+//                                                                since the Unix epoch (see timingwheel.hpp)
+//
+// Binary: kBinaryMagic followed by records of a type byte (EventType) and the same fields in the same order. Quantities,
+// expiresAt and string lengths are LEB128 varints (7 bits per byte, low bits first) so typical events take a few bytes
+// per field.
+namespace orderlog {
+
+constexpr std::string_view kBinaryMagic { "OCLOG\x01\0\0", 8 };
+
+enum class EventType : uint8_t {
+    Add,
+    Cancel,
+    CancelForUser,
+    CancelForSecIdWithMinimumQty,
+    MatchingSize,
+    MatchingSize2,
+    MatchBalanced,
+    AddWithExpiry,
+};
+
+constexpr size_t kEventTypes = 8;
+
+const char* name(EventType type);
+
+// fields not used by the event type are empty, qty holds minQty of min qty cancels. Views point into the parsed buffer.
+struct Event {
+    EventType type { EventType::Add };
+    std::string_view orderId;
+    std::string_view securityId;
+    std::string_view side;
+    std::string_view user;
+    std::string_view company;
+    unsigned int qty { 0 };
+    uint64_t expiresAt { 0 };
+};
+
+// Parses events straight out of a buffer (e.g. a mapped file) without copying, malformed input throws
+// std::runtime_error naming the line (CSV) or the offset (binary) of the bad event.
+class Reader {
+public:
+    Reader(const char* data, size_t size);
+    // binary events without the leading kBinaryMagic, e.g. an event framed by a journal record
+    static Reader binaryEvents(const char* data, size_t size);
+
+    bool binary() const { return m_binary; }
+    // bytes consumed so far, after a failed next() it points into the bad event
+    size_t offset() const { return m_offset; }
+
+    // false at the end of the log
+    bool next(Event& event);
+
+private:
+    bool nextCsv(Event& event);
+    bool nextBinary(Event& event);
+
+    std::string_view field(std::string_view& line) const;
+    unsigned int number(std::string_view text) const;
+    uint64_t timestamp(std::string_view text) const;
+    uint32_t varint();
+    uint64_t varint64();
+    std::string_view string();
+    [[noreturn]] void fail(const std::string& what) const;
+
+    const char* m_data;
+    size_t m_size;
+    size_t m_offset { 0 };
+    size_t m_line { 0 };
+    bool m_binary { false };
+};
+
+// appends the event in the given format, binary logs start with kBinaryMagic
+void appendCsv(std::string& out, const Event& event);
+void appendBinary(std::string& out, const Event& event);
+
+} // namespace orderlog
+
+#endif // ORDERLOG_HPP
@@ -0,0 +1,243 @@
+#include "orderstore.hpp"
+#include "memoryusage.hpp"
+
+#include <atomic>
+#include <mutex>
+
+// Segments released by the store or by snapshots (possibly on other threads) are kept for reuse. The pool lives as long
+// as any segment it handed out, every segment's deleter holds a reference to it.
+class OrderStore::SegmentPool : public std::enable_shared_from_this<SegmentPool> {
+public:
+    // the contents of a reused segment are whatever it held before
+    std::shared_ptr<Segment> acquire()
+    {
+        std::unique_ptr<Segment> segment;
+        {
+            std::scoped_lock lock(m_mutex);
+            if (!m_free.empty()) {
+                segment = std::move(m_free.back());
+                m_free.pop_back();
+            }
+        }
+        if (!segment) {
+            segment = std::make_unique<Segment>();
+        }
+        return { segment.release(), [pool = shared_from_this()](Segment* released) { pool->recycle(released); } };
+    }
+
+    void reserve(size_t segments)
+    {
+        std::scoped_lock lock(m_mutex);
+        while (m_free.size() < segments) {
+            // value-initialized, so all the pages are written now rather than on first use
+            m_free.push_back(std::make_unique<Segment>());
+        }
+    }
+
+    // <segments, heap bytes of their orderId strings>
+    std::pair<size_t, size_t> bytes() const
+    {
+        std::scoped_lock lock(m_mutex);
+        size_t strings = 0;
+        for (const auto& segment : m_free) {
+            for (const auto& orderId : segment->orderId) {
+                strings += memory::heapBytes(orderId);
+            }
+        }
+        return { m_free.size() * sizeof(Segment), strings };
+    }
+
+    void clear()
+    {
+        std::vector<std::unique_ptr<Segment>> free;
+        {
+            std::scoped_lock lock(m_mutex);
+            free.swap(m_free);
+        }
+    }
+
+private:
+    void recycle(Segment* segment)
+    {
+        std::scoped_lock lock(m_mutex);
+        m_free.emplace_back(segment);
+    }
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Segment>> m_free;
+};
+
+OrderStore::OrderStore()
+    : m_pool(std::make_shared<SegmentPool>())
+{
+}
+
+OrderStore::~OrderStore() = default;
+
+size_t OrderStore::allocate()
+{
+    size_t slot = m_freeHead;
+    if (slot != npos) {
+        unlinkFree(slot);
+    } else {
+        slot = m_capacity++;
+        if (slot == m_segments.size() * kSegmentSlots) {
+            auto segment = m_pool->acquire();
+            for (auto& orderId : segment->orderId) {
+                orderId.clear();
+            }
+            segment->security.fill(SymbolTable::npos);
+            segment->side.fill(SymbolTable::npos);
+            segment->user.fill(SymbolTable::npos);
+            segment->company.fill(SymbolTable::npos);
+            segment->qty.fill(0);
+            segment->live.fill(0);
+            m_segments.push_back(std::move(segment));
+        }
+        m_userLinks.emplace_back();
+        m_securityLinks.emplace_back();
+        m_companyLinks.emplace_back();
+    }
+
+    writable(slot).live[slot % kSegmentSlots] = 1;
+    ++m_size;
+    return slot;
+}
+
+void OrderStore::release(size_t slot)
+{
+    Segment& segment = writable(slot);
+    const size_t i = slot % kSegmentSlots;
+    segment.orderId[i].clear();
+    segment.security[i] = SymbolTable::npos;
+    segment.qty[i] = 0;
+    segment.live[i] = 0;
+
+    m_securityLinks[slot] = {};
+    m_companyLinks[slot] = {};
+    m_userLinks[slot] = { npos, m_freeHead };
+    if (m_freeHead != npos) {
+        m_userLinks[m_freeHead].prev = slot;
+    }
+    m_freeHead = slot;
+    --m_size;
+}
+
+size_t OrderStore::relocate(size_t from)
+{
+    const size_t to = allocate();
+    Segment& segment = writable(to);
+    // read after writable(to), it may have just copied the segment both slots live in
+    const Segment& source = at(from);
+    const size_t i = to % kSegmentSlots;
+    const size_t j = from % kSegmentSlots;
+    segment.orderId[i] = source.orderId[j];
+    segment.security[i] = source.security[j];
+    segment.side[i] = source.side[j];
+    segment.user[i] = source.user[j];
+    segment.company[i] = source.company[j];
+    segment.qty[i] = source.qty[j];
+    m_userLinks[to] = m_userLinks[from];
+    m_securityLinks[to] = m_securityLinks[from];
+    m_companyLinks[to] = m_companyLinks[from];
+
+    release(from);
+    return to;
+}
+
+size_t OrderStore::trim()
+{
+    const size_t capacity = m_capacity;
+    while (m_capacity > 0 && !live(m_capacity - 1)) {
+        unlinkFree(--m_capacity);
+        if (m_capacity == (m_segments.size() - 1) * kSegmentSlots) {
+            m_segments.pop_back();
+        }
+    }
+    // vectors keep their memory, growing back doesn't allocate
+    m_userLinks.resize(m_capacity);
+    m_securityLinks.resize(m_capacity);
+    m_companyLinks.resize(m_capacity);
+    return capacity - m_capacity;
+}
+
+void OrderStore::reserve(size_t slots)
+{
+    const size_t segments = (slots + kSegmentSlots - 1) / kSegmentSlots;
+    if (segments > m_segments.size()) {
+        m_pool->reserve(segments - m_segments.size());
+    }
+    m_segments.reserve(segments);
+
+    // growing to the full size and back keeps the capacity but writes every page once
+    for (auto* links : { &m_userLinks, &m_securityLinks, &m_companyLinks }) {
+        const size_t size = links->size();
+        if (slots > size) {
+            links->resize(slots);
+            links->resize(size);
+        }
+    }
+}
+
+size_t OrderStore::recordBytes() const
+{
+    return m_segments.capacity() * sizeof(m_segments[0]) + m_segments.size() * sizeof(Segment) + m_pool->bytes().first
+        + (m_userLinks.capacity() + m_securityLinks.capacity() + m_companyLinks.capacity()) * sizeof(Links);
+}
+
+size_t OrderStore::orderIdBytes() const
+{
+    size_t out = m_pool->bytes().second;
+    for (const auto& segment : m_segments) {
+        for (const auto& orderId : segment->orderId) {
+            out += memory::heapBytes(orderId);
+        }
+    }
+    return out;
+}
+
+void OrderStore::shrink()
+{
+    for (size_t slot = 0; slot < m_segments.size() * kSegmentSlots; ++slot) {
+        const std::string& orderId = at(slot).orderId[slot % kSegmentSlots];
+        // only strings with a heap block, so shared segments aren't copied for nothing
+        if (memory::heapBytes(orderId) && orderId.capacity() > orderId.size()) {
+            writable(slot).orderId[slot % kSegmentSlots].shrink_to_fit();
+        }
+    }
+    m_pool->clear();
+    m_segments.shrink_to_fit();
+    m_userLinks.shrink_to_fit();
+    m_securityLinks.shrink_to_fit();
+    m_companyLinks.shrink_to_fit();
+}
+
+void OrderStore::unlinkFree(size_t slot)
+{
+    const Links node = m_userLinks[slot];
+    if (node.prev != npos) {
+        m_userLinks[node.prev].next = node.next;
+    } else {
+        m_freeHead = node.next;
+    }
+    if (node.next != npos) {
+        m_userLinks[node.next].prev = node.prev;
+    }
+    m_userLinks[slot] = {};
+}
+
+OrderStore::Segment& OrderStore::writable(size_t slot)
+{
+    auto& segment = m_segments[slot / kSegmentSlots];
+    // new references are only handed out by segments() which is called by the owner, so when nobody else holds
+    // the segment now nobody can start sharing it concurrently
+    if (segment.use_count() > 1) {
+        auto copy = m_pool->acquire();
+        *copy = *segment;
+        segment = std::move(copy);
+    } else {
+        // pairs with the release of the last reader's reference, its reads happen before our writes
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *segment;
+}
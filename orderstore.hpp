@@ -0,0 +1,130 @@
+#ifndef ORDERSTORE_HPP
+#define ORDERSTORE_HPP
+
+#include "symboltable.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Columnar (struct-of-arrays) storage of order records. Every field lives in its own contiguous array indexed by slot,
+// so scans that read only a couple of fields (security, qty, live) stream through a few bytes per order instead of
+// whole records - see scankernels.hpp.
+//
+// Columns are split into fixed size segments shared through shared_ptr. segments() hands out the current ones to
+// snapshots and a segment still referenced by a snapshot is copied before it is written (copy-on-write), so readers
+// see a frozen book while the owner keeps mutating it. Old versions are freed when their last reader is gone.
+// Posting list links are used only by the owner and are kept out of the segments.
+//
+// Segments come from a pool shared with the snapshots, a segment whose last user is gone goes back to the pool and is
+// reused by the next segment allocation or copy, reserve() fills the pool up front.
+//
+// A released slot becomes a tombstone (live == 0) and is put on an intrusive doubly linked free list threaded through its
+// user links, the next allocate() reuses it. Slots stay where they are until the owner compacts the store - relocate()
+// moves the last live slot into a hole and trim() drops tombstones from the end, giving emptied segments back to the pool.
+class OrderStore {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    static constexpr size_t kSegmentSlots = 4096;
+
+    struct Segment {
+        std::array<std::string, kSegmentSlots> orderId;
+        std::array<SymbolId, kSegmentSlots> security;
+        std::array<SymbolId, kSegmentSlots> side;
+        std::array<SymbolId, kSegmentSlots> user;
+        std::array<SymbolId, kSegmentSlots> company;
+        std::array<unsigned int, kSegmentSlots> qty;
+        std::array<uint8_t, kSegmentSlots> live;
+    };
+
+    using Segments = std::vector<std::shared_ptr<const Segment>>;
+
+    struct Links {
+        size_t prev { npos };
+        size_t next { npos };
+    };
+
+    enum class ListKind { User, Security, Company };
+
+    OrderStore();
+    ~OrderStore();
+
+    size_t allocate();
+    void release(size_t slot);
+    // makes room for that many slots in total, segments are preallocated and all the memory is touched so growing up
+    // to it doesn't allocate nor page fault
+    void reserve(size_t slots);
+
+    // moves a live slot into a free one and returns the new slot, the old one is released. Links are copied as they
+    // are, pointing their neighbours to the new slot is up to the caller. There has to be a free slot.
+    size_t relocate(size_t from);
+    // drops tombstones from the end of the store, returns the number of dropped slots
+    size_t trim();
+
+    // number of slots including tombstones
+    size_t capacity() const { return m_capacity; }
+    size_t size() const { return m_size; }
+    size_t tombstones() const { return m_capacity - m_size; }
+
+    bool live(size_t slot) const { return at(slot).live[slot % kSegmentSlots]; }
+    const std::string& orderId(size_t slot) const { return at(slot).orderId[slot % kSegmentSlots]; }
+    SymbolId security(size_t slot) const { return at(slot).security[slot % kSegmentSlots]; }
+    SymbolId side(size_t slot) const { return at(slot).side[slot % kSegmentSlots]; }
+    SymbolId user(size_t slot) const { return at(slot).user[slot % kSegmentSlots]; }
+    SymbolId company(size_t slot) const { return at(slot).company[slot % kSegmentSlots]; }
+    unsigned int qty(size_t slot) const { return at(slot).qty[slot % kSegmentSlots]; }
+
+    void setOrderId(size_t slot, std::string_view orderId) { writable(slot).orderId[slot % kSegmentSlots] = orderId; }
+    void setSecurity(size_t slot, SymbolId id) { writable(slot).security[slot % kSegmentSlots] = id; }
+    void setSide(size_t slot, SymbolId id) { writable(slot).side[slot % kSegmentSlots] = id; }
+    void setUser(size_t slot, SymbolId id) { writable(slot).user[slot % kSegmentSlots] = id; }
+    void setCompany(size_t slot, SymbolId id) { writable(slot).company[slot % kSegmentSlots] = id; }
+    void setQty(size_t slot, unsigned int qty) { writable(slot).qty[slot % kSegmentSlots] = qty; }
+
+    Links& links(ListKind kind, size_t slot) { return linkColumn(kind)[slot]; }
+    const Links& links(ListKind kind, size_t slot) const { return linkColumn(kind)[slot]; }
+
+    // bytes of the columns (including segments waiting in the pool) and links, and heap blocks of orderId strings
+    size_t recordBytes() const;
+    size_t orderIdBytes() const;
+    // Gives slack back: pooled segments are freed, link vectors and orderId strings are shrunk to fit. Meant to be
+    // called after the store was compacted, tombstones keep their slots.
+    void shrink();
+
+    // segments for the scan kernels, the last one is filled up to capacity()
+    size_t segmentCount() const { return m_segments.size(); }
+    const Segment& segment(size_t index) const { return *m_segments[index]; }
+
+    // shares the current segments, any of them written afterwards gets copied first
+    Segments segments() const { return Segments(m_segments.begin(), m_segments.end()); }
+
+private:
+    class SegmentPool;
+
+    const Segment& at(size_t slot) const { return *m_segments[slot / kSegmentSlots]; }
+    Segment& writable(size_t slot);
+    void unlinkFree(size_t slot);
+    std::vector<Links>& linkColumn(ListKind kind)
+    {
+        return kind == ListKind::User ? m_userLinks : kind == ListKind::Security ? m_securityLinks : m_companyLinks;
+    }
+    const std::vector<Links>& linkColumn(ListKind kind) const
+    {
+        return kind == ListKind::User ? m_userLinks : kind == ListKind::Security ? m_securityLinks : m_companyLinks;
+    }
+
+    std::shared_ptr<SegmentPool> m_pool;
+    std::vector<std::shared_ptr<Segment>> m_segments;
+    std::vector<Links> m_userLinks;
+    std::vector<Links> m_securityLinks;
+    std::vector<Links> m_companyLinks;
+
+    size_t m_capacity { 0 };
+    size_t m_size { 0 };
+    size_t m_freeHead { npos };
+};
+
+#endif // ORDERSTORE_HPP
@@ -0,0 +1,85 @@
+#include "scankernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_KERNELS_X86 1
+#endif
+
+namespace scan {
+
+size_t securityMinQtyScalar(const SymbolId* security, const unsigned int* qty, const uint8_t* live, size_t count,
+    SymbolId securityId, unsigned int minQty, uint32_t* out)
+{
+    size_t found = 0;
+    for (size_t i = 0; i < count; ++i) {
+        // branchless so the compiler can keep the loop tight, out[found] is overwritten until a match sticks
+        out[found] = static_cast<uint32_t>(i);
+        found += (security[i] == securityId) & (qty[i] >= minQty) & (live[i] != 0);
+    }
+    return found;
+}
+
+#ifdef SCAN_KERNELS_X86
+
+__attribute__((target("avx2"))) size_t securityMinQtyAvx2(const SymbolId* security, const unsigned int* qty,
+    const uint8_t* live, size_t count, SymbolId securityId, unsigned int minQty, uint32_t* out)
+{
+    const __m256i wantedSecurity = _mm256_set1_epi32(static_cast<int>(securityId));
+    const __m256i wantedQty = _mm256_set1_epi32(static_cast<int>(minQty));
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t found = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i securities = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(security + i));
+        const __m256i quantities = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(qty + i));
+        const __m256i alive = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(live + i)));
+
+        // there is no unsigned compare in AVX2, qty >= minQty <=> max(qty, minQty) == qty
+        const __m256i sameSecurity = _mm256_cmpeq_epi32(securities, wantedSecurity);
+        const __m256i enoughQty = _mm256_cmpeq_epi32(_mm256_max_epu32(quantities, wantedQty), quantities);
+        const __m256i dead = _mm256_cmpeq_epi32(alive, zero);
+        const __m256i selected = _mm256_andnot_si256(dead, _mm256_and_si256(sameSecurity, enoughQty));
+
+        unsigned int mask = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_castsi256_ps(selected)));
+        while (mask) {
+            out[found++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    // the remainder goes through the scalar loop, its indexes are relative to i
+    const size_t tail = securityMinQtyScalar(security + i, qty + i, live + i, count - i, securityId, minQty, out + found);
+    for (size_t t = found; t < found + tail; ++t) {
+        out[t] += static_cast<uint32_t>(i);
+    }
+    return found + tail;
+}
+
+bool avx2Supported()
+{
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+#else
+
+size_t securityMinQtyAvx2(const SymbolId* security, const unsigned int* qty, const uint8_t* live, size_t count,
+    SymbolId securityId, unsigned int minQty, uint32_t* out)
+{
+    return securityMinQtyScalar(security, qty, live, count, securityId, minQty, out);
+}
+
+bool avx2Supported() { return false; }
+
+#endif
+
+size_t securityMinQty(const SymbolId* security, const unsigned int* qty, const uint8_t* live, size_t count,
+    SymbolId securityId, unsigned int minQty, uint32_t* out)
+{
+    using Kernel = size_t (*)(const SymbolId*, const unsigned int*, const uint8_t*, size_t, SymbolId, unsigned int, uint32_t*);
+    static const Kernel kernel = avx2Supported() ? &securityMinQtyAvx2 : &securityMinQtyScalar;
+    return kernel(security, qty, live, count, securityId, minQty, out);
+}
+
+} // namespace scan
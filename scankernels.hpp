@@ -0,0 +1,29 @@
+#ifndef SCANKERNELS_HPP
+#define SCANKERNELS_HPP
+
+#include "symboltable.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// Predicate scan kernels over OrderStore columns. Every kernel writes indexes of the matching live slots to out
+// (which has to have room for count elements) in ascending order and returns how many were written.
+//
+// The AVX2 variants process 8 slots per step, the dispatching functions pick AVX2 at runtime when the CPU supports
+// it and fall back to the scalar loop otherwise.
+namespace scan {
+
+// security[i] == securityId && qty[i] >= minQty && live[i]
+size_t securityMinQty(const SymbolId* security, const unsigned int* qty, const uint8_t* live, size_t count,
+    SymbolId securityId, unsigned int minQty, uint32_t* out);
+
+size_t securityMinQtyScalar(const SymbolId* security, const unsigned int* qty, const uint8_t* live, size_t count,
+    SymbolId securityId, unsigned int minQty, uint32_t* out);
+size_t securityMinQtyAvx2(const SymbolId* security, const unsigned int* qty, const uint8_t* live, size_t count,
+    SymbolId securityId, unsigned int minQty, uint32_t* out);
+
+bool avx2Supported();
+
+} // namespace scan
+
+#endif // SCANKERNELS_HPP
@@ -0,0 +1,39 @@
+#include "securityranking.hpp"
+
+#include <algorithm>
+#include <queue>
+
+void SecurityRanking::update(SymbolId security, unsigned int size)
+{
+    m_heap.update(security, size);
+}
+
+void SecurityRanking::clear()
+{
+    m_heap.clear();
+}
+
+std::vector<std::pair<SymbolId, unsigned int>> SecurityRanking::top(size_t n) const
+{
+    std::vector<std::pair<SymbolId, unsigned int>> out;
+    n = std::min(n, m_heap.size());
+    out.reserve(n);
+
+    // heap positions whose parents were already taken, the best of them is the next biggest security
+    auto worse = [this](size_t lhs, size_t rhs) { return Heap::before(m_heap[rhs], m_heap[lhs]); };
+    std::vector<size_t> storage;
+    storage.reserve(2 * n + 1);
+    std::priority_queue<size_t, std::vector<size_t>, decltype(worse)> frontier(worse, std::move(storage));
+    if (n) {
+        frontier.push(0);
+    }
+    while (out.size() < n) {
+        const size_t position = frontier.top();
+        frontier.pop();
+        out.emplace_back(m_heap[position].key, m_heap[position].priority);
+        for (size_t child = 2 * position + 1; child <= 2 * position + 2 && child < m_heap.size(); ++child) {
+            frontier.push(child);
+        }
+    }
+    return out;
+}
@@ -0,0 +1,34 @@
+#ifndef SECURITYRANKING_HPP
+#define SECURITYRANKING_HPP
+
+#include "indexedheap.hpp"
+#include "symboltable.hpp"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Securities ranked by matching size, kept by the OrderBook as orders come and go. It is an indexed binary max-heap
+// (IndexedHeap): a changed size is sifted into place in O(log S), and the n biggest are read in O(n log n) by
+// expanding the heap from its root - no sweep over the securities nor the orders.
+// Securities with nothing to match (size 0) aren't ranked.
+class SecurityRanking {
+public:
+    // sets the matching size of the security
+    void update(SymbolId security, unsigned int size);
+    void clear();
+
+    // <security, matching size> of the n biggest, biggest first, ties go to the security interned first
+    std::vector<std::pair<SymbolId, unsigned int>> top(size_t n) const;
+
+    // number of ranked securities
+    size_t size() const { return m_heap.size(); }
+    size_t memoryBytes() const { return m_heap.memoryBytes(); }
+
+private:
+    using Heap = IndexedHeap<SymbolId, unsigned int>;
+
+    Heap m_heap;
+};
+
+#endif // SECURITYRANKING_HPP
@@ -0,0 +1,617 @@
+#include "shardedordercache.hpp"
+#include "mappedfile.hpp"
+#include "snapshotfile.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+
+ShardedOrderCache::ShardedOrderCache(size_t shards, size_t directoryStripes)
+{
+    for (size_t i = 0; i < std::max<size_t>(shards, 1); ++i) {
+        m_shards.push_back(std::make_unique<Shard>());
+    }
+    for (size_t i = 0; i < std::max<size_t>(directoryStripes, 1); ++i) {
+        m_directory.push_back(std::make_unique<DirectoryStripe>());
+    }
+}
+
+void ShardedOrderCache::addOrder(Order order)
+{
+    add(order, std::nullopt);
+}
+
+void ShardedOrderCache::addOrder(Order order, expiry::Clock::time_point expiresAt)
+{
+    add(order, expiry::deadline(expiresAt));
+}
+
+std::vector<std::string> ShardedOrderCache::tick(expiry::Clock::time_point now)
+{
+    rethrowExpiryError();
+    StatsRecorder::Call call(m_stats, CacheOperation::ExpireOrders);
+    std::vector<std::string> out;
+    std::vector<std::string> removedIds;
+    for (size_t i = 0; i < m_shards.size(); ++i) {
+        {
+            StatsLock lock(m_shards[i]->mutex, call, &m_shards[i]->book.work());
+            m_shards[i]->book.expire(expiry::reading(now), &removedIds);
+            m_shards[i]->book.changes().flush();
+        }
+        forget(i, removedIds, call);
+        out.insert(out.end(), std::make_move_iterator(removedIds.begin()), std::make_move_iterator(removedIds.end()));
+        removedIds.clear();
+    }
+    return out;
+}
+
+void ShardedOrderCache::startExpiry(std::chrono::milliseconds interval)
+{
+    m_expiryTicker = std::make_unique<Ticker>(interval, [this] {
+        try {
+            tick(expiry::Clock::now());
+        } catch (...) {
+            std::scoped_lock lock(m_expiryMutex);
+            m_expiryError = std::current_exception();
+            throw;
+        }
+    });
+}
+
+void ShardedOrderCache::stopExpiry()
+{
+    m_expiryTicker.reset();
+    rethrowExpiryError();
+}
+
+void ShardedOrderCache::rethrowExpiryError()
+{
+    std::unique_lock lock(m_expiryMutex);
+    if (m_expiryError) {
+        const std::exception_ptr error = std::exchange(m_expiryError, nullptr);
+        lock.unlock();
+        std::rethrow_exception(error);
+    }
+}
+
+void ShardedOrderCache::add(const Order& order, std::optional<uint64_t> deadline)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::AddOrder);
+    DirectoryStripe& entries = stripe(order.orderIdView());
+    StatsLock directoryLock(entries.mutex, call);
+    auto [it, inserted] = entries.shards.try_emplace(std::string(order.orderIdView()), shardIndex(order.securityIdView()));
+    if (!inserted) {
+        return;
+    }
+
+    Shard& shard = *m_shards[it->second];
+    StatsLock lock(shard.mutex, call, &shard.book.work());
+    deadline ? shard.book.add(order, *deadline) : shard.book.add(order);
+    shard.book.changes().flush();
+}
+
+void ShardedOrderCache::cancelOrder(const std::string& orderId)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::CancelOrder);
+    DirectoryStripe& entries = stripe(orderId);
+    StatsLock directoryLock(entries.mutex, call);
+    auto it = entries.shards.find(orderId);
+    if (it == entries.shards.end()) {
+        return;
+    }
+
+    Shard& shard = *m_shards[it->second];
+    {
+        StatsLock lock(shard.mutex, call, &shard.book.work());
+        shard.book.cancel(orderId);
+        shard.book.changes().flush();
+    }
+    entries.shards.erase(it);
+}
+
+void ShardedOrderCache::cancelOrdersForUser(const std::string& user)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::CancelOrdersForUser);
+    std::vector<std::string> removedIds;
+    for (size_t i = 0; i < m_shards.size(); ++i) {
+        {
+            StatsLock lock(m_shards[i]->mutex, call, &m_shards[i]->book.work());
+            m_shards[i]->book.cancelForUser(user, &removedIds);
+            m_shards[i]->book.changes().flush();
+        }
+        forget(i, removedIds, call);
+        removedIds.clear();
+    }
+}
+
+void ShardedOrderCache::cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::CancelOrdersForSecIdWithMinimumQty);
+    const size_t index = shardIndex(securityId);
+    std::vector<std::string> removedIds;
+    {
+        StatsLock lock(m_shards[index]->mutex, call, &m_shards[index]->book.work());
+        m_shards[index]->book.cancelForSecIdWithMinimumQty(securityId, minQty, &removedIds);
+        m_shards[index]->book.changes().flush();
+    }
+    forget(index, removedIds, call);
+}
+
+unsigned int ShardedOrderCache::getMatchingSizeForSecurity(const std::string& securityId)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::GetMatchingSizeForSecurity);
+    const Shard& shard = *m_shards[shardIndex(securityId)];
+    StatsLock lock(shard.mutex, call, &shard.book.work());
+    return shard.book.matchingSize(securityId);
+}
+
+unsigned int ShardedOrderCache::getMatchingSizeForSecurity2(const std::string& securityId)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::GetMatchingSizeForSecurity2);
+    const size_t index = shardIndex(securityId);
+    std::vector<std::string> removedIds;
+    unsigned int out = 0;
+    {
+        StatsLock lock(m_shards[index]->mutex, call, &m_shards[index]->book.work());
+        out = m_shards[index]->book.match(securityId, &removedIds);
+        m_shards[index]->book.changes().flush();
+    }
+    forget(index, removedIds, call);
+    return out;
+}
+
+std::vector<unsigned int> ShardedOrderCache::getMatchingSizes(const std::vector<std::string>& securityIds)
+{
+    // positions of the securities of every shard
+    std::vector<std::vector<size_t>> positions(m_shards.size());
+    for (size_t i = 0; i < securityIds.size(); ++i) {
+        positions[shardIndex(securityIds[i])].push_back(i);
+    }
+
+    std::vector<unsigned int> out(securityIds.size());
+    m_workers.run(m_shards.size(), [&](size_t index) {
+        if (positions[index].empty()) {
+            return;
+        }
+        std::vector<std::string> ids;
+        ids.reserve(positions[index].size());
+        for (const size_t position : positions[index]) {
+            ids.push_back(securityIds[position]);
+        }
+        std::vector<unsigned int> sizes;
+        {
+            std::scoped_lock lock(m_shards[index]->mutex);
+            sizes = m_shards[index]->book.matchingSizes(ids);
+        }
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            out[positions[index][i]] = sizes[i];
+        }
+    });
+    return out;
+}
+
+std::vector<std::pair<std::string, unsigned int>> ShardedOrderCache::getMatchingSizes()
+{
+    std::vector<std::vector<std::pair<std::string, unsigned int>>> shards(m_shards.size());
+    m_workers.run(m_shards.size(), [&](size_t index) {
+        std::scoped_lock lock(m_shards[index]->mutex);
+        shards[index] = m_shards[index]->book.matchingSizes();
+    });
+
+    // a security lives in a single shard, merging the sorted parts is enough
+    std::vector<std::pair<std::string, unsigned int>> out;
+    for (auto& shard : shards) {
+        const size_t middle = out.size();
+        std::move(shard.begin(), shard.end(), std::back_inserter(out));
+        std::inplace_merge(out.begin(), out.begin() + middle, out.end());
+    }
+    return out;
+}
+
+std::vector<Order> ShardedOrderCache::getAllOrders() const
+{
+    // only the latency is recorded, locking all shards for the snapshot isn't timed
+    StatsRecorder::Call call(m_stats, CacheOperation::GetAllOrders);
+    const auto snapshots = snapshot();
+    std::vector<Order> out;
+    size_t size = 0;
+    for (const auto& shard : snapshots) {
+        size += shard.size();
+    }
+    out.reserve(size);
+    for (const auto& shard : snapshots) {
+        shard.forEach([&out](const OrderBookSnapshot::Entry& order) {
+            out.emplace_back(order.orderId, order.securityId, order.side, order.qty, order.user, order.company);
+        });
+    }
+    return out;
+}
+
+std::vector<Fill> ShardedOrderCache::matchSecurity(const std::string& securityId, MatchingMode mode)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::MatchSecurity);
+    const size_t index = shardIndex(securityId);
+    std::vector<std::string> removedIds;
+    std::vector<Fill> fills;
+    {
+        StatsLock lock(m_shards[index]->mutex, call, &m_shards[index]->book.work());
+        m_shards[index]->book.match(securityId, &removedIds, &fills, mode);
+        m_shards[index]->book.changes().flush();
+    }
+    forget(index, removedIds, call);
+    return fills;
+}
+
+std::vector<std::pair<std::string, unsigned int>> ShardedOrderCache::getTopMatchingSizes(size_t n) const
+{
+    std::vector<std::pair<std::string, unsigned int>> out;
+    for (const auto& shard : m_shards) {
+        std::scoped_lock lock(shard->mutex);
+        auto top = shard->book.topMatchingSizes(n);
+        out.insert(out.end(), std::make_move_iterator(top.begin()), std::make_move_iterator(top.end()));
+    }
+    // a security lives in a single shard, so the n biggest overall are among the n biggest of every shard
+    auto bigger = [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second || (lhs.second == rhs.second && lhs.first < rhs.first); };
+    const size_t count = std::min(n, out.size());
+    std::partial_sort(out.begin(), out.begin() + count, out.end(), bigger);
+    out.resize(count);
+    return out;
+}
+
+void ShardedOrderCache::addOrders(const std::vector<Order>& orders)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::AddOrders);
+    std::vector<std::string> orderIds;
+    orderIds.reserve(orders.size());
+    for (const auto& order : orders) {
+        orderIds.emplace_back(order.orderIdView());
+    }
+
+    const auto entries = byStripe(orderIds);
+    // <shard, order> accepted by the directory within a stripe group
+    std::vector<std::pair<size_t, const Order*>> accepted;
+    for (auto group = entries.begin(); group != entries.end();) {
+        auto groupEnd = std::find_if(group, entries.end(), [&group](const auto& entry) { return entry.first != group->first; });
+
+        DirectoryStripe& directory = *m_directory[group->first];
+        StatsLock directoryLock(directory.mutex, call);
+
+        // in batch order, so the first of duplicated orderIds wins as it would when added one by one
+        accepted.clear();
+        for (; group != groupEnd; ++group) {
+            const Order& order = orders[group->second];
+            auto [it, inserted] = directory.shards.try_emplace(orderIds[group->second], shardIndex(order.securityIdView()));
+            if (inserted) {
+                accepted.emplace_back(it->second, &order);
+            }
+        }
+        std::stable_sort(accepted.begin(), accepted.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+        for (auto run = accepted.begin(); run != accepted.end();) {
+            Shard& shard = *m_shards[run->first];
+            StatsLock lock(shard.mutex, call, &shard.book.work());
+            for (const size_t index = run->first; run != accepted.end() && run->first == index; ++run) {
+                shard.book.add(*run->second);
+            }
+            shard.book.changes().flush();
+        }
+    }
+}
+
+void ShardedOrderCache::cancelOrders(const std::vector<std::string>& orderIds)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::CancelOrders);
+    const auto entries = byStripe(orderIds);
+    // <shard, orderId> found in the directory within a stripe group
+    std::vector<std::pair<size_t, const std::string*>> found;
+    for (auto group = entries.begin(); group != entries.end();) {
+        auto groupEnd = std::find_if(group, entries.end(), [&group](const auto& entry) { return entry.first != group->first; });
+
+        DirectoryStripe& directory = *m_directory[group->first];
+        StatsLock directoryLock(directory.mutex, call);
+
+        found.clear();
+        for (; group != groupEnd; ++group) {
+            const std::string& orderId = orderIds[group->second];
+            if (auto it = directory.shards.find(orderId); it != directory.shards.end()) {
+                found.emplace_back(it->second, &orderId);
+            }
+        }
+        std::sort(found.begin(), found.end());
+
+        for (auto run = found.begin(); run != found.end();) {
+            Shard& shard = *m_shards[run->first];
+            StatsLock lock(shard.mutex, call, &shard.book.work());
+            for (const size_t index = run->first; run != found.end() && run->first == index; ++run) {
+                shard.book.cancel(*run->second);
+                directory.shards.erase(*run->second);
+            }
+            shard.book.changes().flush();
+        }
+    }
+}
+
+void ShardedOrderCache::cancelOrdersForUsers(const std::vector<std::string>& users)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::CancelOrdersForUsers);
+    std::vector<std::string> removedIds;
+    for (size_t i = 0; i < m_shards.size(); ++i) {
+        {
+            StatsLock lock(m_shards[i]->mutex, call, &m_shards[i]->book.work());
+            m_shards[i]->book.cancelForUsers(users, &removedIds);
+            m_shards[i]->book.changes().flush();
+        }
+        forget(i, removedIds, call);
+        removedIds.clear();
+    }
+}
+
+std::vector<std::string> ShardedOrderCache::cancelOrdersForCompany(const std::string& company)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::CancelOrdersForCompany);
+    std::vector<std::string> out;
+    std::vector<std::string> removedIds;
+    for (size_t i = 0; i < m_shards.size(); ++i) {
+        {
+            StatsLock lock(m_shards[i]->mutex, call, &m_shards[i]->book.work());
+            m_shards[i]->book.cancelForCompany(company, &removedIds);
+            m_shards[i]->book.changes().flush();
+        }
+        forget(i, removedIds, call);
+        out.insert(out.end(), std::make_move_iterator(removedIds.begin()), std::make_move_iterator(removedIds.end()));
+        removedIds.clear();
+    }
+    return out;
+}
+
+std::vector<std::string> ShardedOrderCache::cancelOrdersMatching(const OrderFilter& filter)
+{
+    StatsRecorder::Call call(m_stats, CacheOperation::CancelOrdersMatching);
+    std::vector<std::string> out;
+    std::vector<std::string> removedIds;
+    const size_t first = filter.securityId ? shardIndex(*filter.securityId) : 0;
+    const size_t last = filter.securityId ? first + 1 : m_shards.size();
+    for (size_t i = first; i < last; ++i) {
+        {
+            StatsLock lock(m_shards[i]->mutex, call, &m_shards[i]->book.work());
+            m_shards[i]->book.cancelMatching(filter, &removedIds);
+            m_shards[i]->book.changes().flush();
+        }
+        forget(i, removedIds, call);
+        out.insert(out.end(), std::make_move_iterator(removedIds.begin()), std::make_move_iterator(removedIds.end()));
+        removedIds.clear();
+    }
+    return out;
+}
+
+void ShardedOrderCache::reserve(size_t expectedOrders)
+{
+    const size_t perShard = expectedOrders / m_shards.size();
+    for (auto& shard : m_shards) {
+        std::scoped_lock lock(shard->mutex);
+        shard->book.reserve(perShard + perShard / 4);
+    }
+
+    const size_t perStripe = expectedOrders / m_directory.size();
+    for (auto& stripe : m_directory) {
+        std::scoped_lock lock(stripe->mutex);
+        stripe->shards.reserve(perStripe + perStripe / 4);
+    }
+}
+
+void ShardedOrderCache::setCompactionThreshold(double deadRatio)
+{
+    for (auto& shard : m_shards) {
+        std::scoped_lock lock(shard->mutex);
+        shard->book.setCompactionThreshold(deadRatio);
+    }
+}
+
+void ShardedOrderCache::compact()
+{
+    for (auto& shard : m_shards) {
+        std::scoped_lock lock(shard->mutex);
+        shard->book.compact();
+    }
+}
+
+MemoryUsage ShardedOrderCache::memoryUsage() const
+{
+    MemoryUsage out;
+    for (const auto& shard : m_shards) {
+        std::scoped_lock lock(shard->mutex);
+        out.merge(shard->book.memoryUsage());
+    }
+    size_t directory = 0;
+    for (const auto& stripe : m_directory) {
+        std::scoped_lock lock(stripe->mutex);
+        directory += memory::hashMapBytes(stripe->shards);
+        for (const auto& entry : stripe->shards) {
+            directory += memory::heapBytes(entry.first);
+        }
+    }
+    out.indexes += directory;
+    // the directory shrinks too, its size is recorded here before shrink() as well
+    out.peak = std::max(out.peak + directory, out.total());
+    for (size_t peak = m_peakBytes.load(); peak < out.peak && !m_peakBytes.compare_exchange_weak(peak, out.peak);) {
+    }
+    out.peak = std::max(out.peak, m_peakBytes.load());
+    return out;
+}
+
+void ShardedOrderCache::shrink()
+{
+    // records the peak
+    memoryUsage();
+    for (auto& shard : m_shards) {
+        std::scoped_lock lock(shard->mutex);
+        shard->book.shrink();
+    }
+    for (auto& stripe : m_directory) {
+        std::scoped_lock lock(stripe->mutex);
+        stripe->shards.rehash(0);
+    }
+}
+
+void ShardedOrderCache::saveSnapshot(const std::string& path) const
+{
+    std::vector<std::string> books(m_shards.size());
+    {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        for (const auto& shard : m_shards) {
+            locks.emplace_back(shard->mutex);
+        }
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            m_shards[i]->book.save(books[i]);
+        }
+    }
+    snapshotfile::write(path, books);
+}
+
+void ShardedOrderCache::loadSnapshot(const std::string& path)
+{
+    const MappedFile file(path);
+    const auto books = snapshotfile::read({ file.data(), file.size() }).books;
+    if (books.size() != m_shards.size()) {
+        throw std::runtime_error("snapshot of " + std::to_string(books.size()) + " books can't be loaded into " + std::to_string(m_shards.size()) + " shards");
+    }
+
+    // stripes and then shards in index order, the cache is expected to be idle anyway
+    std::vector<std::unique_lock<std::mutex>> locks;
+    for (auto& stripe : m_directory) {
+        locks.emplace_back(stripe->mutex);
+    }
+    for (auto& shard : m_shards) {
+        locks.emplace_back(shard->mutex);
+        if (shard->book.size() != 0) {
+            throw std::logic_error("snapshot can be loaded only into an empty cache");
+        }
+    }
+
+    try {
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            OrderBook& book = m_shards[i]->book;
+            book.load(books[i]);
+            book.snapshot().forEach([this, i](const OrderBookSnapshot::Entry& order) {
+                if (shardIndex(order.securityId) != i) {
+                    throw std::runtime_error("snapshot was saved with different sharding");
+                }
+                if (!m_directory[stripeIndex(order.orderId)]->shards.emplace(order.orderId, i).second) {
+                    throw std::runtime_error("corrupted snapshot, orderId in many shards");
+                }
+            });
+        }
+    } catch (...) {
+        // leave the cache empty again
+        for (auto& shard : m_shards) {
+            std::vector<std::string> orderIds;
+            shard->book.snapshot().forEach([&orderIds](const OrderBookSnapshot::Entry& order) { orderIds.push_back(order.orderId); });
+            shard->book.cancel(orderIds);
+            shard->book.changes().flush();
+        }
+        for (auto& stripe : m_directory) {
+            stripe->shards.clear();
+        }
+        throw;
+    }
+}
+
+std::shared_ptr<ChangeSubscription> ShardedOrderCache::subscribe(ChangeFilter filter, size_t capacity, std::vector<OrderBookSnapshot>* snapshot)
+{
+    auto subscription = std::make_shared<ChangeSubscription>(std::move(filter), capacity);
+    // every shard is locked for the whole subscription so the snapshot and the changes line up across shards
+    const size_t first = subscription->filter().securityId ? shardIndex(*subscription->filter().securityId) : 0;
+    const size_t last = subscription->filter().securityId ? first + 1 : m_shards.size();
+    std::vector<std::unique_lock<std::mutex>> locks;
+    for (auto& shard : m_shards) {
+        locks.emplace_back(shard->mutex);
+    }
+    for (size_t i = first; i < last; ++i) {
+        m_shards[i]->book.changes().subscribe(subscription);
+    }
+    if (snapshot) {
+        snapshot->clear();
+        for (const auto& shard : m_shards) {
+            snapshot->push_back(shard->book.snapshot());
+        }
+    }
+    return subscription;
+}
+
+void ShardedOrderCache::unsubscribe(const std::shared_ptr<ChangeSubscription>& subscription)
+{
+    for (auto& shard : m_shards) {
+        std::scoped_lock lock(shard->mutex);
+        shard->book.changes().unsubscribe(subscription.get());
+    }
+}
+
+CacheStats ShardedOrderCache::stats() const
+{
+    return m_stats.stats();
+}
+
+void ShardedOrderCache::resetStats()
+{
+    m_stats.reset();
+}
+
+std::vector<OrderBookSnapshot> ShardedOrderCache::snapshot() const
+{
+    // shards are locked in index order, nothing else ever holds a shard while waiting for another one
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(m_shards.size());
+    for (const auto& shard : m_shards) {
+        locks.emplace_back(shard->mutex);
+    }
+
+    std::vector<OrderBookSnapshot> out;
+    out.reserve(m_shards.size());
+    for (const auto& shard : m_shards) {
+        out.push_back(shard->book.snapshot());
+    }
+    return out;
+}
+
+size_t ShardedOrderCache::shardIndex(std::string_view securityId) const
+{
+    return std::hash<std::string_view> {}(securityId) % m_shards.size();
+}
+
+size_t ShardedOrderCache::stripeIndex(std::string_view orderId) const
+{
+    return std::hash<std::string_view> {}(orderId) % m_directory.size();
+}
+
+std::vector<std::pair<size_t, size_t>> ShardedOrderCache::byStripe(const std::vector<std::string>& orderIds) const
+{
+    std::vector<std::pair<size_t, size_t>> out;
+    out.reserve(orderIds.size());
+    for (size_t i = 0; i < orderIds.size(); ++i) {
+        out.emplace_back(stripeIndex(orderIds[i]), i);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+void ShardedOrderCache::forget(size_t shard, const std::vector<std::string>& orderIds, StatsRecorder::Call& call)
+{
+    // grouped by stripe so every stripe and the shard are locked once per group rather than once per order
+    const auto entries = byStripe(orderIds);
+    for (auto group = entries.begin(); group != entries.end();) {
+        auto groupEnd = std::find_if(group, entries.end(), [&group](const auto& entry) { return entry.first != group->first; });
+
+        DirectoryStripe& directory = *m_directory[group->first];
+        StatsLock directoryLock(directory.mutex, call);
+        StatsLock lock(m_shards[shard]->mutex, call);
+        for (; group != groupEnd; ++group) {
+            const std::string& orderId = orderIds[group->second];
+            auto it = directory.shards.find(orderId);
+            // the orderId might have been cancelled and added again after the shard lock was released
+            if (it != directory.shards.end() && it->second == shard && !m_shards[shard]->book.contains(orderId)) {
+                directory.shards.erase(it);
+            }
+        }
+    }
+}
@@ -0,0 +1,140 @@
+#ifndef SHARDEDORDERCACHE_HPP
+#define SHARDEDORDERCACHE_HPP
+
+#include "cachestats.hpp"
+#include "changefeed.hpp"
+#include "ordercachebatchinterface.hpp"
+#include "ordercacheinterface.hpp"
+#include "orderbook.hpp"
+#include "orderfilter.hpp"
+#include "ticker.hpp"
+#include "timingwheel.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Thread safe OrderCacheInterface implementation for many concurrent writers. The book is partitioned by securityId
+// hash across shards, every shard is an OrderBook with its own mutex, so operations on different securities don't
+// contend. cancelOrdersForUser locks shards one at a time - it is not atomic across shards. getAllOrders reads
+// a snapshot for which all shards are locked just long enough to share their segments.
+//
+// orderIds are unique across the cache thanks to a directory mapping orderId to its shard, the directory is striped
+// by orderId hash with a mutex per stripe. Lock order is always stripe -> shard. Mass cancels remove orders from a
+// shard first and then drop their directory entries, an add racing a mass cancel of the same orderId may hence be
+// rejected as a duplicate.
+class ShardedOrderCache : public OrderCacheInterface, public OrderCacheBatchInterface {
+public:
+    explicit ShardedOrderCache(size_t shards = 16, size_t directoryStripes = 64);
+    ~ShardedOrderCache() = default;
+
+    // OrderCacheInterface interface
+    void addOrder(Order order) override;
+    void cancelOrder(const std::string& orderId) override;
+    void cancelOrdersForUser(const std::string& user) override;
+    void cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty) override;
+    unsigned int getMatchingSizeForSecurity(const std::string& securityId) override;
+    unsigned int getMatchingSizeForSecurity2(const std::string& securityId) override;
+    std::vector<Order> getAllOrders() const override;
+
+    // see OrderCacheImpl, every shard has its own timing wheel and tick() locks one shard at a time. An error of the
+    // background thread stops it and is rethrown by the next tick() or stopExpiry().
+    void addOrder(Order order, expiry::Clock::time_point expiresAt);
+    std::vector<std::string> tick(expiry::Clock::time_point now);
+    void startExpiry(std::chrono::milliseconds interval = std::chrono::milliseconds(10));
+    void stopExpiry();
+
+    // see OrderCacheImpl, a security lives in a single shard which is the only one locked
+    std::vector<Fill> matchSecurity(const std::string& securityId, MatchingMode mode = MatchingMode::Balanced);
+
+    // see OrderCacheImpl, every shard is locked once (only the security's shard when the filter names one)
+    std::vector<std::string> cancelOrdersForCompany(const std::string& company);
+    std::vector<std::string> cancelOrdersMatching(const OrderFilter& filter);
+
+    // see OrderCacheImpl, every shard is a task of the worker pool and is locked only for its own securities
+    std::vector<unsigned int> getMatchingSizes(const std::vector<std::string>& securityIds);
+    std::vector<std::pair<std::string, unsigned int>> getMatchingSizes();
+
+    // see OrderCacheImpl, the top n of every shard are merged - O(shards * n log n), ties are ordered by securityId
+    std::vector<std::pair<std::string, unsigned int>> getTopMatchingSizes(size_t n) const;
+
+    // OrderCacheBatchInterface interface
+    // orders and orderIds are grouped by directory stripe and then by shard, each of them is locked once per group
+    void addOrders(const std::vector<Order>& orders) override;
+    void cancelOrders(const std::vector<std::string>& orderIds) override;
+    void cancelOrdersForUsers(const std::vector<std::string>& users) override;
+
+    // preallocates memory for that many orders, every shard gets its share plus a margin for uneven distribution
+    void reserve(size_t expectedOrders);
+
+    // see OrderCacheImpl, compact() locks one shard at a time
+    void setCompactionThreshold(double deadRatio);
+    void compact();
+
+    // see OrderCacheImpl, summed over the shards plus the orderId directory - both lock one shard or stripe at a time
+    MemoryUsage memoryUsage() const;
+    void shrink();
+
+    // see OrderCacheImpl, every shard is saved as its own book. A snapshot loads only into a cache with the same number
+    // of shards, the directory is rebuilt from the loaded books.
+    void saveSnapshot(const std::string& path) const;
+    void loadSnapshot(const std::string& path);
+
+    // consistent point-in-time view of every shard, it can be iterated without blocking writers
+    std::vector<OrderBookSnapshot> snapshot() const;
+
+    // see OrderCacheImpl, a subscription gets batches from every shard (only the security's shard when the filter names
+    // one) - batches of different shards interleave in any order, changes of a security come in order
+    std::shared_ptr<ChangeSubscription> subscribe(ChangeFilter filter = {}, size_t capacity = 1024, std::vector<OrderBookSnapshot>* snapshot = nullptr);
+    void unsubscribe(const std::shared_ptr<ChangeSubscription>& subscription);
+
+    // see OrderCacheImpl, lock wait and hold times of a call are summed over the stripes and shards it locked - the
+    // hold time of a shard locked under a stripe counts twice
+    CacheStats stats() const;
+    void resetStats();
+
+private:
+    struct Shard {
+        OrderBook book;
+        mutable std::mutex mutex;
+    };
+
+    struct DirectoryStripe {
+        // orderId -> index of the shard holding the order
+        std::unordered_map<std::string, size_t> shards;
+        std::mutex mutex;
+    };
+
+    void add(const Order& order, std::optional<uint64_t> deadline);
+    size_t shardIndex(std::string_view securityId) const;
+    size_t stripeIndex(std::string_view orderId) const;
+    DirectoryStripe& stripe(std::string_view orderId) { return *m_directory[stripeIndex(orderId)]; }
+    // <stripe, position> of every orderId, sorted so orderIds of a stripe are adjacent and keep their order
+    std::vector<std::pair<size_t, size_t>> byStripe(const std::vector<std::string>& orderIds) const;
+    // drops directory entries of orders removed from the shard, unless the orderId was reused in the meantime
+    void forget(size_t shard, const std::vector<std::string>& orderIds, StatsRecorder::Call& call);
+    // throws what stopped the expiry thread, once
+    void rethrowExpiryError();
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::vector<std::unique_ptr<DirectoryStripe>> m_directory;
+    mutable StatsRecorder m_stats;
+    // peak of memoryUsage() over the books and the directory
+    mutable std::atomic<size_t> m_peakBytes { 0 };
+    WorkerPool m_workers;
+    // what stopped the expiry thread until tick() or stopExpiry() rethrows it
+    std::mutex m_expiryMutex;
+    std::exception_ptr m_expiryError;
+    // last member, it is stopped before the rest goes away
+    std::unique_ptr<Ticker> m_expiryTicker;
+};
+
+#endif // SHARDEDORDERCACHE_HPP
@@ -0,0 +1,760 @@
+#include "sharedordercache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sharedbook {
+
+constexpr char kMagic[8] = { 'O', 'C', 'S', 'H', 'M', '\x01', 0, 0 };
+constexpr uint32_t npos = static_cast<uint32_t>(-1);
+constexpr size_t kAlignment = 64;
+
+enum Kind : uint32_t {
+    Security,
+    Side,
+    User,
+    Company,
+};
+
+struct Name {
+    uint8_t size;
+    char data[SharedOrderCache::kMaxName];
+
+    // clamped, a torn size must not read past the name
+    std::string_view view() const { return { data, std::min<size_t>(size, SharedOrderCache::kMaxName) }; }
+    void assign(std::string_view name)
+    {
+        size = static_cast<uint8_t>(name.size());
+        std::memcpy(data, name.data(), name.size());
+    }
+};
+
+struct Links {
+    uint32_t prev;
+    uint32_t next;
+};
+
+struct List {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t size;
+};
+
+// a slot, free slots are chained through securityLinks.next
+struct Record {
+    uint32_t security;
+    uint32_t side;
+    uint32_t user;
+    uint32_t company;
+    uint32_t qty;
+    uint32_t live;
+    Links securityLinks;
+    Links userLinks;
+    Name orderId;
+};
+
+// a free symbol is chained through orders.head
+struct Symbol {
+    uint32_t kind;
+    // orders of a security or a user, companies and sides only count theirs in size
+    List orders;
+    Name name;
+};
+
+// Region offsets are relative to the header, indexes hold slot/symbol + 1 with 0 for an empty bucket. Everything but
+// the sequence and the counters below it is written once when the segment is created.
+struct Header {
+    char magic[8];
+    uint64_t size;
+    uint32_t orderCapacity;
+    uint32_t symbolCapacity;
+    // powers of two, at least twice the capacity
+    uint32_t orderBuckets;
+    uint32_t symbolBuckets;
+    uint64_t records;
+    uint64_t orderIndex;
+    uint64_t symbols;
+    uint64_t symbolIndex;
+    uint32_t sellSide;
+
+    alignas(kAlignment) std::atomic<uint64_t> sequence;
+    uint32_t orders;
+    // slots handed out so far, slots past it were never used
+    uint32_t used;
+    uint32_t freeSlots;
+    // symbols in use, a symbol is freed with the last order using it
+    uint32_t symbolCount;
+    uint32_t symbolsUsed;
+    uint32_t freeSymbols;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the seqlock is shared between processes");
+
+namespace {
+
+// regions of the segment, the writer asks for mutable ones
+template <typename T>
+T* at(const Header& header, uint64_t offset)
+{
+    return reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(&header) + offset);
+}
+
+// FNV-1a, the hash is part of the layout so it mustn't depend on the standard library of a process
+uint32_t hash(uint32_t kind, std::string_view name)
+{
+    uint64_t out = 14695981039346656037ull ^ kind;
+    for (const char c : name) {
+        out = (out ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return static_cast<uint32_t>(out ^ (out >> 32));
+}
+
+size_t align(size_t size)
+{
+    return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// linear probing without tombstones: entries behind the freed bucket move up unless they'd leave their home range.
+// home maps an entry of the index to its home bucket.
+template <typename Home>
+void eraseBucket(uint32_t* index, uint32_t mask, uint32_t hole, Home&& home)
+{
+    index[hole] = 0;
+    for (uint32_t bucket = (hole + 1) & mask; index[bucket] != 0; bucket = (bucket + 1) & mask) {
+        const uint32_t entryHome = home(index[bucket]);
+        // home is cyclically outside of (hole, bucket]
+        if (((bucket - entryHome) & mask) >= ((bucket - hole) & mask)) {
+            index[hole] = index[bucket];
+            index[bucket] = 0;
+            hole = bucket;
+        }
+    }
+}
+
+uint32_t buckets(size_t capacity)
+{
+    uint32_t out = 2;
+    while (out < 2 * capacity) {
+        out *= 2;
+    }
+    return out;
+}
+
+// npos when the name isn't interned (or a torn bucket points nowhere)
+uint32_t findSymbol(const Header& header, uint32_t kind, std::string_view name)
+{
+    const uint32_t* index = at<const uint32_t>(header, header.symbolIndex);
+    const Symbol* symbols = at<const Symbol>(header, header.symbols);
+    const uint32_t mask = header.symbolBuckets - 1;
+    uint32_t bucket = hash(kind, name) & mask;
+    for (uint32_t probes = 0; probes < header.symbolBuckets; ++probes, bucket = (bucket + 1) & mask) {
+        const uint32_t entry = index[bucket];
+        if (entry == 0 || entry > header.symbolCapacity) {
+            return npos;
+        }
+        const Symbol& symbol = symbols[entry - 1];
+        if (symbol.kind == kind && symbol.name.view() == name) {
+            return entry - 1;
+        }
+    }
+    return npos;
+}
+
+// Closed form of the matching size (see matchingaggregates.hpp) over the orders of the security. Returns false when
+// a walk runs into an index out of bounds or a cycle, which a reader sees only mid-mutation.
+bool matchingSize(const Header& header, uint32_t security, unsigned int& out)
+{
+    struct Totals {
+        uint32_t company;
+        uint64_t qty;
+    };
+    // a handful of companies per security
+    std::vector<Totals> companies;
+    uint64_t sell = 0;
+    uint64_t buy = 0;
+    const Record* records = at<const Record>(header, header.records);
+    uint32_t steps = 0;
+    for (uint32_t slot = at<const Symbol>(header, header.symbols)[security].orders.head; slot != npos;
+         slot = records[slot].securityLinks.next) {
+        if (slot >= header.orderCapacity || ++steps > header.orderCapacity) {
+            return false;
+        }
+        const Record& record = records[slot];
+        (record.side == header.sellSide ? sell : buy) += record.qty;
+        auto it = std::find_if(companies.begin(), companies.end(), [&record](const Totals& totals) { return totals.company == record.company; });
+        if (it == companies.end()) {
+            companies.push_back({ record.company, record.qty });
+        } else {
+            it->qty += record.qty;
+        }
+    }
+    uint64_t dominant = 0;
+    for (const auto& totals : companies) {
+        dominant = std::max(dominant, totals.qty);
+    }
+    out = sell && buy ? static_cast<unsigned int>(std::min({ sell, buy, sell + buy - dominant })) : 0;
+    return true;
+}
+
+// Seqlock read side: runs f until it ran entirely between two mutations. f returns false when it found the book
+// inconsistent, which must not happen with an unchanged sequence.
+// The fields f reads are plain memory the writer may be changing at the same time - whatever f reads during a
+// mutation is thrown away, the acquire fence orders its reads before the second load of the sequence.
+template <typename F>
+void seqlockRead(const Header& header, F&& f)
+{
+    for (unsigned int attempt = 0;; ++attempt) {
+        const uint64_t before = header.sequence.load(std::memory_order_acquire);
+        if ((before & 1) == 0) {
+            const bool consistent = f();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (header.sequence.load(std::memory_order_relaxed) == before) {
+                if (!consistent) {
+                    throw std::runtime_error("corrupted shared order cache");
+                }
+                return;
+            }
+        }
+        if (attempt > 64) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+Order toOrder(const Header& header, const Record& record)
+{
+    const Symbol* symbols = at<const Symbol>(header, header.symbols);
+    auto name = [&](uint32_t symbol) { return std::string(symbol < header.symbolCapacity ? symbols[symbol].name.view() : std::string_view()); };
+    return { std::string(record.orderId.view()), name(record.security), name(record.side), record.qty, name(record.user), name(record.company) };
+}
+
+// false when the slot counter is torn
+bool allOrders(const Header& header, std::vector<Order>& out)
+{
+    out.clear();
+    const uint32_t used = header.used;
+    if (used > header.orderCapacity) {
+        return false;
+    }
+    const Record* records = at<const Record>(header, header.records);
+    for (uint32_t slot = 0; slot < used; ++slot) {
+        if (records[slot].live) {
+            out.push_back(toOrder(header, records[slot]));
+        }
+    }
+    return true;
+}
+
+} // namespace
+} // namespace sharedbook
+
+using namespace sharedbook;
+
+class SharedOrderCache::WriteSection {
+public:
+    explicit WriteSection(Header& header)
+        : m_header(header)
+    {
+        m_header.sequence.store(m_header.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        // the odd sequence is visible before any of the changes
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    ~WriteSection() { m_header.sequence.store(m_header.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    WriteSection(const WriteSection&) = delete;
+    WriteSection& operator=(const WriteSection&) = delete;
+
+private:
+    Header& m_header;
+};
+
+SharedOrderCache::SharedOrderCache(const std::string& name, Limits limits)
+    : m_name(name)
+{
+    if (limits.orders == 0 || limits.orders >= npos / 2 || limits.symbols == 0 || limits.symbols >= npos / 2) {
+        throw std::invalid_argument("shared order cache limits out of range");
+    }
+    const uint32_t orderBuckets = buckets(limits.orders);
+    const uint32_t symbolBuckets = buckets(limits.symbols);
+    size_t offset = align(sizeof(Header));
+    const uint64_t records = offset;
+    offset += align(limits.orders * sizeof(Record));
+    const uint64_t orderIndex = offset;
+    offset += align(orderBuckets * sizeof(uint32_t));
+    const uint64_t symbols = offset;
+    offset += align(limits.symbols * sizeof(Symbol));
+    const uint64_t symbolIndex = offset;
+    offset += align(symbolBuckets * sizeof(uint32_t));
+    m_size = offset;
+
+    // a segment left behind by a dead writer is replaced, its readers keep the old one
+    ::shm_unlink(name.c_str());
+    const int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), name);
+    }
+    // a fresh segment reads as zeros - empty indexes and lists are all zero bytes
+    void* data = ::ftruncate(fd, m_size) == 0 ? ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (data == MAP_FAILED) {
+        const int error = errno;
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        throw std::system_error(error, std::generic_category(), name);
+    }
+    ::close(fd);
+
+    m_header = new (data) Header {};
+    m_header->size = m_size;
+    m_header->orderCapacity = static_cast<uint32_t>(limits.orders);
+    m_header->symbolCapacity = static_cast<uint32_t>(limits.symbols);
+    m_header->orderBuckets = orderBuckets;
+    m_header->symbolBuckets = symbolBuckets;
+    m_header->records = records;
+    m_header->orderIndex = orderIndex;
+    m_header->symbols = symbols;
+    m_header->symbolIndex = symbolIndex;
+    m_header->freeSlots = npos;
+    m_header->freeSymbols = npos;
+    m_header->sellSide = intern(Side, "Sell");
+    // readers check the magic, it goes last
+    std::memcpy(m_header->magic, kMagic, sizeof(kMagic));
+    m_header->sequence.store(0, std::memory_order_release);
+}
+
+SharedOrderCache::~SharedOrderCache()
+{
+    ::munmap(m_header, m_size);
+    ::shm_unlink(m_name.c_str());
+}
+
+void SharedOrderCache::addOrder(Order order)
+{
+    std::scoped_lock lock(m_mutex);
+    WriteSection section(*m_header);
+    add(order);
+}
+
+void SharedOrderCache::cancelOrder(const std::string& orderId)
+{
+    std::scoped_lock lock(m_mutex);
+    const uint32_t slot = findOrder(orderId);
+    if (slot != npos) {
+        WriteSection section(*m_header);
+        remove(slot);
+    }
+}
+
+void SharedOrderCache::cancelOrdersForUser(const std::string& user)
+{
+    std::scoped_lock lock(m_mutex);
+    WriteSection section(*m_header);
+    cancelForUser(user);
+}
+
+void SharedOrderCache::addOrders(const std::vector<Order>& orders)
+{
+    std::scoped_lock lock(m_mutex);
+    WriteSection section(*m_header);
+    for (const auto& order : orders) {
+        add(order);
+    }
+}
+
+void SharedOrderCache::cancelOrders(const std::vector<std::string>& orderIds)
+{
+    std::scoped_lock lock(m_mutex);
+    WriteSection section(*m_header);
+    for (const auto& orderId : orderIds) {
+        if (const uint32_t slot = findOrder(orderId); slot != npos) {
+            remove(slot);
+        }
+    }
+}
+
+void SharedOrderCache::cancelOrdersForUsers(const std::vector<std::string>& users)
+{
+    std::scoped_lock lock(m_mutex);
+    WriteSection section(*m_header);
+    for (const auto& user : users) {
+        cancelForUser(user);
+    }
+}
+
+void SharedOrderCache::add(const Order& order)
+{
+    const std::string_view names[] = { order.orderIdView(), order.securityIdView(), order.sideView(), order.userView(), order.companyView() };
+    for (const auto name : names) {
+        if (name.size() > kMaxName) {
+            throw std::length_error("name longer than " + std::to_string(kMaxName) + " bytes: " + std::string(name));
+        }
+    }
+
+    Header& header = *m_header;
+    if (findOrder(order.orderIdView()) != npos) {
+        return;
+    }
+    // everything is checked before the mutation starts, it can't fail half way
+    if (header.orders == header.orderCapacity) {
+        throw std::length_error("shared order cache is full, " + std::to_string(header.orderCapacity) + " orders");
+    }
+    const uint32_t kinds[] = { Security, Side, User, Company };
+    size_t missing = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        missing += findSymbol(header, kinds[i], names[i + 1]) == npos;
+    }
+    if (header.symbolCount + missing > header.symbolCapacity) {
+        throw std::length_error("shared order cache is out of symbols, " + std::to_string(header.symbolCapacity) + " symbols");
+    }
+
+    Record* records = at<Record>(header, header.records);
+    uint32_t slot = header.freeSlots;
+    if (slot != npos) {
+        header.freeSlots = records[slot].securityLinks.next;
+    } else {
+        slot = header.used++;
+    }
+    Record& record = records[slot];
+    record.orderId.assign(order.orderIdView());
+    record.security = intern(Security, order.securityIdView());
+    record.side = intern(Side, order.sideView());
+    record.user = intern(User, order.userView());
+    record.company = intern(Company, order.companyView());
+    record.qty = order.qty();
+    record.live = 1;
+    link(record.security, false, slot);
+    link(record.user, true, slot);
+    Symbol* symbols = at<Symbol>(header, header.symbols);
+    ++symbols[record.side].orders.size;
+    ++symbols[record.company].orders.size;
+
+    uint32_t* index = at<uint32_t>(header, header.orderIndex);
+    const uint32_t mask = header.orderBuckets - 1;
+    uint32_t bucket = hash(0, order.orderIdView()) & mask;
+    while (index[bucket] != 0) {
+        bucket = (bucket + 1) & mask;
+    }
+    index[bucket] = slot + 1;
+    ++header.orders;
+}
+
+void SharedOrderCache::cancelForUser(const std::string& user)
+{
+    const uint32_t symbol = findSymbol(*m_header, User, user);
+    if (symbol == npos) {
+        return;
+    }
+    const Symbol* symbols = at<const Symbol>(*m_header, m_header->symbols);
+    const Record* records = at<const Record>(*m_header, m_header->records);
+    for (uint32_t slot = symbols[symbol].orders.head; slot != npos;) {
+        const uint32_t next = records[slot].userLinks.next;
+        remove(slot);
+        slot = next;
+    }
+}
+
+void SharedOrderCache::cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty)
+{
+    std::scoped_lock lock(m_mutex);
+    const uint32_t symbol = findSymbol(*m_header, Security, securityId);
+    if (symbol == npos) {
+        return;
+    }
+    const Record* records = at<const Record>(*m_header, m_header->records);
+    const Symbol& security = at<const Symbol>(*m_header, m_header->symbols)[symbol];
+    for (uint32_t slot = security.orders.head; slot != npos; slot = records[slot].securityLinks.next) {
+        if (records[slot].qty >= minQty) {
+            // a section only when something gets removed
+            WriteSection section(*m_header);
+            while (slot != npos) {
+                const uint32_t next = records[slot].securityLinks.next;
+                if (records[slot].qty >= minQty) {
+                    remove(slot);
+                }
+                slot = next;
+            }
+            return;
+        }
+    }
+}
+
+unsigned int SharedOrderCache::getMatchingSizeForSecurity(const std::string& securityId)
+{
+    std::scoped_lock lock(m_mutex);
+    const uint32_t symbol = findSymbol(*m_header, Security, securityId);
+    unsigned int out = 0;
+    if (symbol != npos) {
+        matchingSize(*m_header, symbol, out);
+    }
+    return out;
+}
+
+unsigned int SharedOrderCache::getMatchingSizeForSecurity2(const std::string& securityId)
+{
+    std::scoped_lock lock(m_mutex);
+    const uint32_t symbol = findSymbol(*m_header, Security, securityId);
+    if (symbol == npos) {
+        return 0;
+    }
+    const List& orders = at<const Symbol>(*m_header, m_header->symbols)[symbol].orders;
+    if (orders.size == 0) {
+        return 0;
+    }
+
+    // same greedy match as OrderBook: sells against buys of other companies, both in insertion order
+    WriteSection section(*m_header);
+    Record* records = at<Record>(*m_header, m_header->records);
+    const uint32_t sell = m_header->sellSide;
+    unsigned int out = 0;
+    for (uint32_t sellSlot = orders.head; sellSlot != npos; sellSlot = records[sellSlot].securityLinks.next) {
+        Record& sellOrder = records[sellSlot];
+        if (sellOrder.side != sell) {
+            continue;
+        }
+        for (uint32_t buySlot = orders.head; buySlot != npos && sellOrder.qty > 0; buySlot = records[buySlot].securityLinks.next) {
+            Record& buyOrder = records[buySlot];
+            if (buyOrder.side != sell && buyOrder.company != sellOrder.company) {
+                const unsigned int qty = std::min(sellOrder.qty, buyOrder.qty);
+                sellOrder.qty -= qty;
+                buyOrder.qty -= qty;
+                out += qty;
+            }
+        }
+    }
+    for (uint32_t slot = orders.head; slot != npos;) {
+        const uint32_t next = records[slot].securityLinks.next;
+        if (records[slot].qty == 0) {
+            remove(slot);
+        }
+        slot = next;
+    }
+    return out;
+}
+
+std::vector<Order> SharedOrderCache::getAllOrders() const
+{
+    std::scoped_lock lock(m_mutex);
+    std::vector<Order> out;
+    out.reserve(m_header->orders);
+    allOrders(*m_header, out);
+    return out;
+}
+
+MemoryUsage SharedOrderCache::memoryUsage() const
+{
+    std::scoped_lock lock(m_mutex);
+    MemoryUsage out;
+    out.orders = m_header->orders;
+    out.capacity = m_header->used;
+    out.orderRecords = m_header->orderIndex - m_header->records;
+    out.symbols = m_size - m_header->symbols;
+    out.indexes = m_header->records + m_header->symbols - m_header->orderIndex;
+    out.peak = out.total();
+    return out;
+}
+
+uint32_t SharedOrderCache::intern(uint32_t kind, std::string_view name)
+{
+    Header& header = *m_header;
+    uint32_t* index = at<uint32_t>(header, header.symbolIndex);
+    Symbol* symbols = at<Symbol>(header, header.symbols);
+    const uint32_t mask = header.symbolBuckets - 1;
+    uint32_t bucket = hash(kind, name) & mask;
+    for (; index[bucket] != 0; bucket = (bucket + 1) & mask) {
+        const Symbol& symbol = symbols[index[bucket] - 1];
+        if (symbol.kind == kind && symbol.name.view() == name) {
+            return index[bucket] - 1;
+        }
+    }
+    uint32_t id = header.freeSymbols;
+    if (id != npos) {
+        header.freeSymbols = symbols[id].orders.head;
+    } else {
+        id = header.symbolsUsed++;
+    }
+    ++header.symbolCount;
+    symbols[id].kind = kind;
+    symbols[id].orders = { npos, npos, 0 };
+    symbols[id].name.assign(name);
+    index[bucket] = id + 1;
+    return id;
+}
+
+// called inside a write section
+void SharedOrderCache::freeSymbol(uint32_t id)
+{
+    Header& header = *m_header;
+    uint32_t* index = at<uint32_t>(header, header.symbolIndex);
+    Symbol* symbols = at<Symbol>(header, header.symbols);
+    const uint32_t mask = header.symbolBuckets - 1;
+    uint32_t hole = hash(symbols[id].kind, symbols[id].name.view()) & mask;
+    while (index[hole] != id + 1) {
+        hole = (hole + 1) & mask;
+    }
+    eraseBucket(index, mask, hole, [symbols, mask](uint32_t entry) {
+        const Symbol& symbol = symbols[entry - 1];
+        return hash(symbol.kind, symbol.name.view()) & mask;
+    });
+    symbols[id].orders = { header.freeSymbols, npos, 0 };
+    header.freeSymbols = id;
+    --header.symbolCount;
+}
+
+uint32_t SharedOrderCache::findOrder(std::string_view orderId) const
+{
+    const uint32_t* index = at<const uint32_t>(*m_header, m_header->orderIndex);
+    const Record* records = at<const Record>(*m_header, m_header->records);
+    const uint32_t mask = m_header->orderBuckets - 1;
+    for (uint32_t bucket = hash(0, orderId) & mask; index[bucket] != 0; bucket = (bucket + 1) & mask) {
+        if (records[index[bucket] - 1].orderId.view() == orderId) {
+            return index[bucket] - 1;
+        }
+    }
+    return npos;
+}
+
+// called inside a write section
+void SharedOrderCache::remove(uint32_t slot)
+{
+    Header& header = *m_header;
+    Record* records = at<Record>(header, header.records);
+    Record& record = records[slot];
+    unlink(record.security, false, slot);
+    unlink(record.user, true, slot);
+    Symbol* symbols = at<Symbol>(header, header.symbols);
+    --symbols[record.side].orders.size;
+    --symbols[record.company].orders.size;
+    // symbols nobody uses anymore are freed, a writer whose securities and users come and go doesn't run out of them
+    for (const uint32_t symbol : { record.security, record.side, record.user, record.company }) {
+        if (symbols[symbol].orders.size == 0 && symbol != header.sellSide) {
+            freeSymbol(symbol);
+        }
+    }
+
+    uint32_t* index = at<uint32_t>(header, header.orderIndex);
+    const uint32_t mask = header.orderBuckets - 1;
+    uint32_t hole = hash(0, record.orderId.view()) & mask;
+    while (index[hole] != slot + 1) {
+        hole = (hole + 1) & mask;
+    }
+    eraseBucket(index, mask, hole, [records, mask](uint32_t entry) { return hash(0, records[entry - 1].orderId.view()) & mask; });
+
+    record.live = 0;
+    record.qty = 0;
+    record.securityLinks.next = header.freeSlots;
+    header.freeSlots = slot;
+    --header.orders;
+}
+
+void SharedOrderCache::link(uint32_t symbol, bool user, uint32_t slot)
+{
+    Record* records = at<Record>(*m_header, m_header->records);
+    List& list = at<Symbol>(*m_header, m_header->symbols)[symbol].orders;
+    auto links = [records, user](uint32_t at) -> Links& { return user ? records[at].userLinks : records[at].securityLinks; };
+    links(slot) = { list.tail, npos };
+    // the new tail is complete before a reader can reach it
+    if (list.tail != npos) {
+        links(list.tail).next = slot;
+    } else {
+        list.head = slot;
+    }
+    list.tail = slot;
+    ++list.size;
+}
+
+void SharedOrderCache::unlink(uint32_t symbol, bool user, uint32_t slot)
+{
+    Record* records = at<Record>(*m_header, m_header->records);
+    List& list = at<Symbol>(*m_header, m_header->symbols)[symbol].orders;
+    auto links = [records, user](uint32_t at) -> Links& { return user ? records[at].userLinks : records[at].securityLinks; };
+    const Links node = links(slot);
+    if (node.prev != npos) {
+        links(node.prev).next = node.next;
+    } else {
+        list.head = node.next;
+    }
+    if (node.next != npos) {
+        links(node.next).prev = node.prev;
+    } else {
+        list.tail = node.prev;
+    }
+    --list.size;
+}
+
+SharedOrderCacheReader::SharedOrderCacheReader(const std::string& name)
+{
+    const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), name);
+    }
+    struct stat info {};
+    void* data = ::fstat(fd, &info) == 0 && info.st_size > 0 ? ::mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (data == MAP_FAILED) {
+        const int error = errno ? errno : EINVAL;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), name);
+    }
+    ::close(fd);
+    m_header = static_cast<const Header*>(data);
+    m_size = info.st_size;
+
+    const Header& header = *m_header;
+    const bool valid = m_size >= sizeof(Header) && std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && header.size == m_size
+        && header.records + uint64_t { header.orderCapacity } * sizeof(Record) <= header.orderIndex
+        && header.orderIndex + uint64_t { header.orderBuckets } * sizeof(uint32_t) <= header.symbols
+        && header.symbols + uint64_t { header.symbolCapacity } * sizeof(Symbol) <= header.symbolIndex
+        && header.symbolIndex + uint64_t { header.symbolBuckets } * sizeof(uint32_t) <= m_size
+        && header.symbolBuckets != 0 && (header.symbolBuckets & (header.symbolBuckets - 1)) == 0;
+    if (!valid) {
+        ::munmap(const_cast<Header*>(m_header), m_size);
+        throw std::runtime_error(name + " is not a shared order cache");
+    }
+}
+
+SharedOrderCacheReader::~SharedOrderCacheReader()
+{
+    ::munmap(const_cast<Header*>(m_header), m_size);
+}
+
+unsigned int SharedOrderCacheReader::getMatchingSizeForSecurity(const std::string& securityId) const
+{
+    unsigned int out = 0;
+    seqlockRead(*m_header, [&] {
+        out = 0;
+        const uint32_t symbol = findSymbol(*m_header, Security, securityId);
+        return symbol == npos || matchingSize(*m_header, symbol, out);
+    });
+    return out;
+}
+
+std::vector<Order> SharedOrderCacheReader::getAllOrders() const
+{
+    std::vector<Order> out;
+    seqlockRead(*m_header, [&] { return allOrders(*m_header, out); });
+    return out;
+}
+
+size_t SharedOrderCacheReader::size() const
+{
+    size_t out = 0;
+    seqlockRead(*m_header, [&] {
+        out = m_header->orders;
+        return true;
+    });
+    return out;
+}
+
+uint64_t SharedOrderCacheReader::version() const
+{
+    return m_header->sequence.load(std::memory_order_acquire) / 2;
+}
@@ -0,0 +1,128 @@
+#ifndef SHAREDORDERCACHE_HPP
+#define SHAREDORDERCACHE_HPP
+
+#include "memoryusage.hpp"
+#include "ordercachebatchinterface.hpp"
+#include "ordercacheinterface.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Order cache living in a POSIX shared memory segment (shm_open), so processes on the same host read one book instead
+// of keeping copies of their own. One process owns the segment and mutates it through SharedOrderCache, any number of
+// processes map it read-only through SharedOrderCacheReader and query it in place - no IPC round trips, no copies of
+// the book.
+//
+// The segment holds only plain data and refers to its parts by index, never by pointer, so it reads the same at any
+// mapping address: a header, fixed size order records (slots) threaded on per-security and per-user posting lists
+// in insertion order, an open addressing orderId index and an interned symbol table with its own index. Everything is
+// sized for the given limits when the segment is created, it never grows - orders beyond the capacity and names longer
+// than kMaxName throw std::length_error and leave the cache untouched. A symbol is freed with the last order using it,
+// so only the names in use at once count against the limit.
+//
+// Readers synchronize through a seqlock: the writer makes the header's sequence odd for the duration of every
+// mutation, a reader runs its query and retries it when the sequence was odd or changed meanwhile. Queries never
+// block the writer, readers only pay for retries. A reader walking a half written list can't go astray either: every
+// index is bounds checked and walks are bounded by the capacity, a torn read just fails validation.
+namespace sharedbook {
+struct Header;
+struct Record;
+struct Symbol;
+} // namespace sharedbook
+
+class SharedOrderCache : public OrderCacheInterface, public OrderCacheBatchInterface {
+public:
+    static constexpr size_t kMaxName = 47;
+
+    struct Limits {
+        // live orders at once
+        size_t orders { 1 << 20 };
+        // distinct securities, users, companies and sides of the live orders together (plus "Sell", which is kept)
+        size_t symbols { 1 << 16 };
+    };
+
+    // Creates the segment (name as for shm_open, "/" and no other slashes), replacing an existing one of the same name,
+    // e.g. left behind by a writer which crashed. The segment is unlinked again when the cache is destroyed, readers
+    // which mapped it keep it until they let it go. Throws std::system_error when the segment can't be created.
+    SharedOrderCache(const std::string& name, Limits limits);
+    explicit SharedOrderCache(const std::string& name)
+        : SharedOrderCache(name, Limits())
+    {
+    }
+    ~SharedOrderCache();
+
+    SharedOrderCache(const SharedOrderCache&) = delete;
+    SharedOrderCache& operator=(const SharedOrderCache&) = delete;
+
+    // OrderCacheInterface interface
+    // Threads of the writer process are serialized by a mutex of the process, they don't take part in the seqlock.
+    // The matching size is computed from the security's orders in O(orders of the security), the same way readers do.
+    void addOrder(Order order) override;
+    void cancelOrder(const std::string& orderId) override;
+    void cancelOrdersForUser(const std::string& user) override;
+    void cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty) override;
+    unsigned int getMatchingSizeForSecurity(const std::string& securityId) override;
+    unsigned int getMatchingSizeForSecurity2(const std::string& securityId) override;
+    std::vector<Order> getAllOrders() const override;
+
+    // OrderCacheBatchInterface interface
+    // a batch is a single mutation for readers, they see all of it or nothing. An order of addOrders() which throws
+    // std::length_error stops the batch, the orders before it stay added.
+    void addOrders(const std::vector<Order>& orders) override;
+    void cancelOrders(const std::vector<std::string>& orderIds) override;
+    void cancelOrdersForUsers(const std::vector<std::string>& users) override;
+
+    const std::string& name() const { return m_name; }
+
+    // the segment by component, it is allocated up front so the peak is the total
+    MemoryUsage memoryUsage() const;
+
+private:
+    // a mutation as seen by readers, the sequence is odd while it lives
+    class WriteSection;
+
+    // called inside a write section
+    void add(const Order& order);
+    void cancelForUser(const std::string& user);
+    uint32_t intern(uint32_t kind, std::string_view name);
+    void freeSymbol(uint32_t id);
+    uint32_t findOrder(std::string_view orderId) const;
+    void remove(uint32_t slot);
+    void link(uint32_t symbol, bool user, uint32_t slot);
+    void unlink(uint32_t symbol, bool user, uint32_t slot);
+
+    const std::string m_name;
+    sharedbook::Header* m_header { nullptr };
+    size_t m_size { 0 };
+    mutable std::mutex m_mutex;
+};
+
+// Read-only view of a segment created by SharedOrderCache, typically in another process. Every query sees the book
+// between two mutations of the writer. A reader spins while the writer is in the middle of a mutation - if the
+// writer dies there, its readers keep spinning until a new writer recreates the segment and they reopen it.
+class SharedOrderCacheReader {
+public:
+    // Maps the segment, throws std::system_error when it doesn't exist and std::runtime_error when it isn't a cache
+    explicit SharedOrderCacheReader(const std::string& name);
+    ~SharedOrderCacheReader();
+
+    SharedOrderCacheReader(const SharedOrderCacheReader&) = delete;
+    SharedOrderCacheReader& operator=(const SharedOrderCacheReader&) = delete;
+
+    unsigned int getMatchingSizeForSecurity(const std::string& securityId) const;
+    std::vector<Order> getAllOrders() const;
+    size_t size() const;
+
+    // goes up with every mutation of the writer (and with calls which turned out not to change anything), a reader
+    // polling the book can skip its work while it stays the same
+    uint64_t version() const;
+
+private:
+    const sharedbook::Header* m_header { nullptr };
+    size_t m_size { 0 };
+};
+
+#endif // SHAREDORDERCACHE_HPP
@@ -0,0 +1,129 @@
+#include "snapshotfile.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace snapshotfile {
+
+void Writer::u32(uint32_t value)
+{
+    for (int shift = 0; shift < 32; shift += 8) {
+        m_out += static_cast<char>((value >> shift) & 0xff);
+    }
+}
+
+void Writer::u64(uint64_t value)
+{
+    u32(static_cast<uint32_t>(value));
+    u32(static_cast<uint32_t>(value >> 32));
+}
+
+void Writer::string(std::string_view value)
+{
+    if (value.size() > UINT32_MAX) {
+        throw std::length_error("snapshot string too long");
+    }
+    u32(static_cast<uint32_t>(value.size()));
+    m_out += value;
+}
+
+uint32_t Reader::u32()
+{
+    const auto* data = reinterpret_cast<const unsigned char*>(bytes(4).data());
+    return data[0] | data[1] << 8 | data[2] << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
+
+uint64_t Reader::u64()
+{
+    const uint64_t low = u32();
+    return low | static_cast<uint64_t>(u32()) << 32;
+}
+
+std::string_view Reader::string()
+{
+    return bytes(u32());
+}
+
+std::string_view Reader::bytes(size_t size)
+{
+    if (m_data.size() - m_offset < size) {
+        throw std::runtime_error("truncated snapshot");
+    }
+    const std::string_view out = m_data.substr(m_offset, size);
+    m_offset += size;
+    return out;
+}
+
+void write(const std::string& path, const std::vector<std::string>& books, uint64_t journalSequence)
+{
+    std::string header { kMagic };
+    Writer writer(header);
+    writer.u64(journalSequence);
+    writer.u32(static_cast<uint32_t>(books.size()));
+
+    const std::string temporary = path + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+        throw std::system_error(errno, std::generic_category(), temporary);
+    }
+    bool ok = std::fwrite(header.data(), 1, header.size(), file) == header.size();
+    for (const auto& book : books) {
+        std::string size;
+        Writer(size).u64(book.size());
+        ok = ok && std::fwrite(size.data(), 1, size.size(), file) == size.size();
+        ok = ok && std::fwrite(book.data(), 1, book.size(), file) == book.size();
+    }
+    // the snapshot has to be durable before journal events it covers are dropped
+    ok = ok && std::fflush(file) == 0 && ::fsync(::fileno(file)) == 0;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        const int error = errno;
+        std::remove(temporary.c_str());
+        throw std::system_error(error, std::generic_category(), path);
+    }
+    syncDirectory(path);
+}
+
+Contents read(std::string_view data)
+{
+    if (data.substr(0, kMagic.size()) != kMagic) {
+        throw std::runtime_error("not an order cache snapshot");
+    }
+    Reader reader(data.substr(kMagic.size()));
+    Contents out;
+    out.journalSequence = reader.u64();
+    const uint32_t count = reader.u32();
+    if (count > data.size() / 8) {
+        throw std::runtime_error("corrupted snapshot");
+    }
+    out.books.resize(count);
+    for (auto& book : out.books) {
+        book = reader.bytes(reader.u64());
+    }
+    if (!reader.empty()) {
+        throw std::runtime_error("trailing bytes in snapshot");
+    }
+    return out;
+}
+
+void syncDirectory(const std::string& path)
+{
+    const size_t slash = path.rfind('/');
+    const std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0 || ::fsync(fd) != 0) {
+        const int error = errno;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::system_error(error, std::generic_category(), directory);
+    }
+    ::close(fd);
+}
+
+} // namespace snapshotfile
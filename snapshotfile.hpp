@@ -0,0 +1,68 @@
+#ifndef SNAPSHOTFILE_HPP
+#define SNAPSHOTFILE_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Binary snapshot files for warm restarts. A file is kMagic, the sequence number of the first journal event the snapshot
+// doesn't cover (uint64, see journal.hpp), the number of books (uint32) and every book as its size (uint64) plus
+// the bytes written by OrderBook::save(). Integers are little endian, strings a uint32 length plus bytes.
+// Files are written to a temporary name, synced and renamed so a crash never leaves a half written snapshot behind. The
+// directory is synced after the rename, otherwise the new name may not survive a power loss.
+namespace snapshotfile {
+
+constexpr std::string_view kMagic { "OCSNAP\x01\0", 8 };
+
+// appends fixed size fields to a buffer
+class Writer {
+public:
+    explicit Writer(std::string& out)
+        : m_out(out)
+    {
+    }
+
+    void u32(uint32_t value);
+    void u64(uint64_t value);
+    void string(std::string_view value);
+
+private:
+    std::string& m_out;
+};
+
+// reads fields back in place, running past the end throws std::runtime_error
+class Reader {
+public:
+    explicit Reader(std::string_view data)
+        : m_data(data)
+    {
+    }
+
+    uint32_t u32();
+    uint64_t u64();
+    std::string_view string();
+    std::string_view bytes(size_t size);
+
+    bool empty() const { return m_offset == m_data.size(); }
+
+private:
+    std::string_view m_data;
+    size_t m_offset { 0 };
+};
+
+struct Contents {
+    uint64_t journalSequence { 0 };
+    // views into the parsed data (e.g. a mapped file)
+    std::vector<std::string_view> books;
+};
+
+void write(const std::string& path, const std::vector<std::string>& books, uint64_t journalSequence = 0);
+Contents read(std::string_view data);
+
+// fsyncs the directory holding path, making a rename to path durable. Throws std::system_error.
+void syncDirectory(const std::string& path);
+
+} // namespace snapshotfile
+
+#endif // SNAPSHOTFILE_HPP
@@ -0,0 +1,42 @@
+#include "symboltable.hpp"
+#include "memoryusage.hpp"
+
+SymbolId SymbolTable::intern(std::string_view name)
+{
+    if (auto it = m_ids.find(name); it != m_ids.end()) {
+        return it->second;
+    }
+
+    if (m_size == m_chunks.size() * kChunkSize) {
+        m_chunks.push_back(std::make_shared<Chunk>());
+    }
+
+    const auto id = static_cast<SymbolId>(m_size++);
+    std::string& stored = (*m_chunks[id / kChunkSize])[id % kChunkSize];
+    stored = name;
+    m_ids.emplace(stored, id);
+    return id;
+}
+
+SymbolId SymbolTable::find(std::string_view name) const
+{
+    auto it = m_ids.find(name);
+    return it != m_ids.end() ? it->second : npos;
+}
+
+SymbolTable::View SymbolTable::view() const
+{
+    View out;
+    out.m_chunks.assign(m_chunks.begin(), m_chunks.end());
+    out.m_size = m_size;
+    return out;
+}
+
+size_t SymbolTable::memoryBytes() const
+{
+    size_t out = m_chunks.capacity() * sizeof(m_chunks[0]) + m_chunks.size() * sizeof(Chunk) + memory::hashMapBytes(m_ids);
+    for (SymbolId id = 0; id < m_size; ++id) {
+        out += memory::heapBytes(name(id));
+    }
+    return out;
+}
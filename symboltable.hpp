@@ -0,0 +1,59 @@
+#ifndef SYMBOLTABLE_HPP
+#define SYMBOLTABLE_HPP
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using SymbolId = uint32_t;
+
+// Maps strings (securities, users, companies, sides) to dense integer ids handed out in order of first appearance,
+// so hot paths compare and index by integers instead of strings. Symbols are never removed, every distinct name
+// is stored once for the lifetime of the table.
+class SymbolTable {
+    static constexpr size_t kChunkSize = 1024;
+    using Chunk = std::array<std::string, kChunkSize>;
+
+public:
+    static constexpr SymbolId npos = static_cast<SymbolId>(-1);
+
+    // Frozen view of the names interned so far. Names are written once and chunks never move, so a view can be read
+    // without any lock while the table keeps interning new names.
+    class View {
+    public:
+        View() = default;
+
+        const std::string& name(SymbolId id) const { return (*m_chunks[id / kChunkSize])[id % kChunkSize]; }
+        size_t size() const { return m_size; }
+
+    private:
+        friend class SymbolTable;
+
+        std::vector<std::shared_ptr<const Chunk>> m_chunks;
+        size_t m_size { 0 };
+    };
+
+    SymbolId intern(std::string_view name);
+    // returns npos for names which were never interned
+    SymbolId find(std::string_view name) const;
+
+    const std::string& name(SymbolId id) const { return (*m_chunks[id / kChunkSize])[id % kChunkSize]; }
+    size_t size() const { return m_size; }
+
+    View view() const;
+
+    // chunks, heap blocks of the names and the hash map
+    size_t memoryBytes() const;
+
+private:
+    std::vector<std::shared_ptr<Chunk>> m_chunks;
+    size_t m_size { 0 };
+    // keyed by views of the stored names
+    std::unordered_map<std::string_view, SymbolId> m_ids;
+};
+
+#endif // SYMBOLTABLE_HPP
@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+
+#include "../orderbook.hpp"
+#include "testorders.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+// Counts heap allocations of the calling thread, replacing the global operator new affects the whole test binary but
+// only calls made between startCounting() and stopCounting() on the same thread are counted. Every form of new and
+// delete is replaced, so all of them take memory from malloc and give it back to free and sanitizers checking that
+// blocks are freed the way they were allocated see matching pairs.
+namespace {
+
+thread_local bool t_counting = false;
+thread_local size_t t_allocations = 0;
+
+void startCounting()
+{
+    t_allocations = 0;
+    t_counting = true;
+}
+
+size_t stopCounting()
+{
+    t_counting = false;
+    return t_allocations;
+}
+
+// nullptr when out of memory
+void* allocate(size_t size, size_t alignment = 0)
+{
+    if (t_counting) {
+        ++t_allocations;
+    }
+    size = size ? size : 1;
+    if (alignment <= alignof(std::max_align_t)) {
+        return std::malloc(size);
+    }
+    // aligned_alloc takes multiples of the alignment only
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void* allocateOrThrow(size_t size, size_t alignment = 0)
+{
+    if (void* out = allocate(size, alignment)) {
+        return out;
+    }
+    throw std::bad_alloc();
+}
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    return allocateOrThrow(size);
+}
+
+void* operator new[](size_t size)
+{
+    return allocateOrThrow(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+namespace {
+
+// an odd number of securities, so every security gets orders of both sides
+constexpr testorders::OrderPools kOrders { 9, 16, 5, 100, 500 };
+
+std::vector<Order> makeOrders(int count)
+{
+    std::vector<Order> out;
+    for (int i = 0; i < count; ++i) {
+        out.push_back(testorders::cyclicOrder(i, kOrders));
+    }
+    return out;
+}
+
+} // namespace
+
+TEST(AllocationTests, OrderBook_CancelAndMatchOnPopulatedBook_NoAllocations)
+{
+    const int count = 4000;
+    const auto orders = makeOrders(count);
+    OrderBook book;
+    book.reserve(count);
+    book.add(orders);
+
+    // arguments are built up front, the interface takes strings
+    std::vector<std::string> orderIds;
+    for (int i = 0; i < count; i += 7) {
+        orderIds.push_back("OrdId" + std::to_string(i));
+    }
+    const std::string unknown = "Unknown";
+    const std::string user = "User3";
+    const std::string securityId = "SecId1";
+    const std::string swept = "SecId2";
+
+    startCounting();
+    for (const auto& orderId : orderIds) {
+        book.cancel(orderId);
+    }
+    book.cancel(unknown);
+    book.cancelForUser(user);
+    book.cancelForUser(unknown);
+    book.cancelForSecIdWithMinimumQty(securityId, 550);
+    book.matchingSize(securityId);
+    book.matchingSize(unknown);
+    book.match(securityId);
+    book.match(swept);
+    EXPECT_EQ(stopCounting(), 0);
+
+    // the security holds 1/9 of the book, above the ratio of the column sweep
+    static_assert(kOrders.securities < OrderBook::kSweepRatio);
+    startCounting();
+    book.cancelForSecIdWithMinimumQty(swept, 0);
+    EXPECT_EQ(stopCounting(), 0);
+    EXPECT_EQ(book.matchingSize(swept), 0);
+}
+
+// ShardedOrderCache is left out, it collects the orderIds of the shards it cancelled in
+template <typename Cache>
+class CacheAllocationTests : public ::testing::Test {
+};
+
+using NoAllocationCacheTypes = ::testing::Types<OrderCacheImpl, BacktestOrderCache>;
+TYPED_TEST_SUITE(CacheAllocationTests, NoAllocationCacheTypes, testorders::CacheTypeNames);
+
+TYPED_TEST(CacheAllocationTests, CancelAndMatch_NoAllocations)
+{
+    TypeParam cache;
+    const int count = 2000;
+    cache.reserve(count);
+    cache.addOrders(makeOrders(count));
+    const std::string orderId = "OrdId11";
+    const std::string user = "User5";
+    const std::string securityId = "SecId3";
+
+    startCounting();
+    cache.cancelOrder(orderId);
+    cache.cancelOrdersForUser(user);
+    cache.cancelOrdersForSecIdWithMinimumQty(securityId, 590);
+    cache.getMatchingSizeForSecurity(securityId);
+    cache.getMatchingSizeForSecurity2(securityId);
+    EXPECT_EQ(stopCounting(), 0);
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include "../arena.hpp"
+
+#include <cstddef>
+#include <vector>
+
+TEST(ArenaTests, Deallocate_BlockReusedBySameSizeClass_Succeeds)
+{
+    Arena arena;
+    void* first = arena.allocate(40);
+    void* second = arena.allocate(40);
+    EXPECT_NE(first, second);
+
+    arena.deallocate(first, 40);
+    // 33..48 bytes share the size class
+    EXPECT_EQ(arena.allocate(33), first);
+    EXPECT_NE(arena.allocate(40), first);
+}
+
+TEST(ArenaTests, Allocate_SmallBlocksComeFromChunks_Succeeds)
+{
+    Arena arena;
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_NE(arena.allocate(64), nullptr);
+    }
+    EXPECT_EQ(arena.capacity(), Arena::kChunkSize);
+
+    // big blocks are not carved from chunks
+    void* big = arena.allocate(Arena::kMaxBlock + 1);
+    EXPECT_EQ(arena.capacity(), Arena::kChunkSize);
+    EXPECT_EQ(arena.largeBytes(), Arena::kMaxBlock + 1);
+    arena.deallocate(big, Arena::kMaxBlock + 1);
+    EXPECT_EQ(arena.largeBytes(), 0);
+
+    arena.release();
+    EXPECT_EQ(arena.capacity(), 0);
+    EXPECT_NE(arena.allocate(64), nullptr);
+    EXPECT_EQ(arena.capacity(), Arena::kChunkSize);
+}
+
+TEST(ArenaTests, Reserve_NoGrowthUpToReservedBytes_Succeeds)
+{
+    Arena arena;
+    arena.reserve(4 * Arena::kChunkSize);
+    const size_t reserved = arena.capacity();
+    EXPECT_GE(reserved, 4 * Arena::kChunkSize);
+
+    for (size_t allocated = 0; allocated + 128 <= 4 * Arena::kChunkSize; allocated += 128) {
+        EXPECT_NE(arena.allocate(128), nullptr);
+    }
+    EXPECT_EQ(arena.capacity(), reserved);
+}
+
+TEST(ArenaTests, Reserve_CountsFreeBlocksAndChunkTail_Succeeds)
+{
+    Arena arena;
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < Arena::kChunkSize / 64; ++i) {
+        blocks.push_back(arena.allocate(64));
+    }
+    for (void* block : blocks) {
+        arena.deallocate(block, 64);
+    }
+    EXPECT_EQ(arena.freeBytes(), Arena::kChunkSize);
+
+    // small batches are covered by the freed blocks, they don't start chunks
+    for (int batch = 0; batch < 100; ++batch) {
+        arena.reserve(100 * 64);
+    }
+    EXPECT_EQ(arena.capacity(), Arena::kChunkSize);
+
+    arena.reserve(Arena::kChunkSize + 64);
+    EXPECT_EQ(arena.capacity(), 2 * Arena::kChunkSize);
+    EXPECT_EQ(arena.allocate(64), blocks.back());
+}
+
+TEST(ArenaTests, Reserve_NewChunkKeepsTailOfCurrentOne_Succeeds)
+{
+    Arena arena;
+    void* first = arena.allocate(64);
+    arena.reserve(Arena::kChunkSize);
+    EXPECT_EQ(arena.capacity(), 2 * Arena::kChunkSize);
+    EXPECT_EQ(arena.freeBytes(), Arena::kChunkSize - 64);
+
+    // the tail is handed out in blocks of the biggest size class
+    void* block = arena.allocate(Arena::kMaxBlock);
+    const std::ptrdiff_t offset = static_cast<std::byte*>(block) - static_cast<std::byte*>(first);
+    EXPECT_GT(offset, 0);
+    EXPECT_LT(offset, static_cast<std::ptrdiff_t>(Arena::kChunkSize));
+    EXPECT_EQ(arena.freeBytes(), Arena::kChunkSize - 64 - Arena::kMaxBlock);
+    arena.deallocate(block, Arena::kMaxBlock);
+    arena.deallocate(first, 64);
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include "../asyncordercache.hpp"
+#include "../mpscring.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(MpscRingTests, PushPop_FullRingRejectsPush_Succeeds)
+{
+    MpscRing<std::string> ring(3);
+    EXPECT_EQ(ring.capacity(), 4);
+    EXPECT_TRUE(ring.empty());
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(ring.tryPush("value" + std::to_string(i)));
+    }
+    std::string value = "rejected";
+    EXPECT_FALSE(ring.tryPush(std::move(value)));
+    EXPECT_EQ(value, "rejected");
+
+    std::string out;
+    for (int lap = 0; lap < 3; ++lap) {
+        EXPECT_TRUE(ring.tryPop(out));
+        EXPECT_EQ(out, "value" + std::to_string(lap));
+        EXPECT_TRUE(ring.tryPush("value" + std::to_string(lap + 4)));
+    }
+    for (int i = 3; i < 7; ++i) {
+        EXPECT_TRUE(ring.tryPop(out));
+        EXPECT_EQ(out, "value" + std::to_string(i));
+    }
+    EXPECT_FALSE(ring.tryPop(out));
+}
+
+TEST(MpscRingTests, ManyProducers_EveryValueOnceInProducerOrder_Succeeds)
+{
+    const int producers = 4;
+    const int values = 20000;
+    MpscRing<int> ring(64);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&ring, p] {
+            for (int i = 0; i < values; ++i) {
+                ring.push(p * values + i);
+            }
+        });
+    }
+
+    std::vector<int> last(producers, -1);
+    for (int popped = 0; popped < producers * values;) {
+        int value = 0;
+        if (!ring.tryPop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ++popped;
+        // values of a single producer keep their order
+        EXPECT_EQ(value % values, last[value / values] + 1);
+        last[value / values] = value % values;
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(AsyncOrderCacheTests, SubmitQueries_SeeEarlierCommands_Succeeds)
+{
+    // a tiny ring so producers run into back pressure
+    AsyncOrderCache cache(8);
+    for (int i = 0; i < 100; ++i) {
+        cache.addOrder({ "OrdId" + std::to_string(i), "SecId1", i % 2 ? "Buy" : "Sell", 100, "User1", "Company" + std::to_string(i % 3) });
+    }
+    auto size = cache.submitMatchingSize("SecId1");
+    std::atomic<unsigned int> fromCallback { 0 };
+    cache.submitMatchingSize("SecId1", [&fromCallback](unsigned int value) { fromCallback = value; });
+    cache.cancelOrdersForUser("User1");
+    auto afterCancel = cache.submitMatchingSize("SecId1");
+    auto orders = cache.submitGetAllOrders();
+
+    EXPECT_EQ(size.get(), 5000);
+    EXPECT_EQ(afterCancel.get(), 0);
+    EXPECT_TRUE(orders.get().empty());
+    cache.flush();
+    EXPECT_EQ(fromCallback, 5000);
+}
+
+TEST(AsyncOrderCacheTests, ConcurrentProducers_AllCommandsApplied_Succeeds)
+{
+    const int producers = 4;
+    const int ordersPerProducer = 2000;
+    AsyncOrderCache cache(256);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&cache, p] {
+            for (int i = 0; i < ordersPerProducer; ++i) {
+                cache.addOrder({ "OrdId" + std::to_string(p) + "_" + std::to_string(i), "SecId" + std::to_string(p), "Buy", 100, "User1", "Company1" });
+                if (i % 2) {
+                    cache.cancelOrder("OrdId" + std::to_string(p) + "_" + std::to_string(i - 1));
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(cache.getAllOrders().size(), producers * ordersPerProducer / 2);
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include "../cachestats.hpp"
+#include "../ordercacheimpl.hpp"
+#include "../shardedordercache.hpp"
+
+#include <thread>
+#include <vector>
+
+TEST(CacheStatsTests, Dump_TextAndJson_Succeeds)
+{
+    CacheStats stats;
+    stats.operations[static_cast<size_t>(CacheOperation::CancelOrdersForUser)].calls = 2;
+    stats.operations[static_cast<size_t>(CacheOperation::CancelOrdersForUser)].work = { 10, 4 };
+    stats.operations[static_cast<size_t>(CacheOperation::CancelOrdersForUser)].latency.record(1000);
+
+    CacheStats other;
+    other.operations[static_cast<size_t>(CacheOperation::CancelOrdersForUser)].calls = 1;
+    other.operations[static_cast<size_t>(CacheOperation::CancelOrdersForUser)].contended = 1;
+    stats.merge(other);
+    EXPECT_EQ(stats[CacheOperation::CancelOrdersForUser].calls, 3);
+    EXPECT_EQ(stats[CacheOperation::CancelOrdersForUser].contended, 1);
+
+    // operations which weren't called are left out of the text
+    const std::string text = stats.toText();
+    EXPECT_NE(text.find("cancelOrdersForUser "), std::string::npos);
+    EXPECT_EQ(text.find("addOrder"), std::string::npos);
+
+    const std::string json = stats.toJson();
+    EXPECT_EQ(json.front(), '{');
+    EXPECT_EQ(json.back(), '}');
+    EXPECT_NE(json.find(R"("cancelOrdersForUser": {"calls": 3, "contended": 1, "scanned": 10, "touched": 4, "latency": {"count": 1,)"), std::string::npos);
+    EXPECT_NE(json.find(R"("addOrder": {"calls": 0,)"), std::string::npos);
+}
+
+TEST(CacheStatsTests, OrderCacheImpl_RecordsOperations_Succeeds)
+{
+    OrderCacheImpl cache;
+    for (int i = 0; i < 10; ++i) {
+        cache.addOrder({ "OrdId" + std::to_string(i), "SecId1", i % 2 ? "Buy" : "Sell", 100, "User" + std::to_string(i % 2), "Company" + std::to_string(i % 3) });
+    }
+    cache.cancelOrder("OrdId0");
+    cache.cancelOrdersForUser("User1");
+    cache.getMatchingSizeForSecurity("SecId1");
+    cache.getAllOrders();
+
+    const CacheStats stats = cache.stats();
+    if constexpr (!kStatsEnabled) {
+        // compiled out, nothing is recorded
+        EXPECT_EQ(stats[CacheOperation::AddOrder].calls, 0);
+        EXPECT_EQ(cache.stats().toText().find("addOrder"), std::string::npos);
+        return;
+    }
+
+    EXPECT_EQ(stats[CacheOperation::AddOrder].calls, 10);
+    EXPECT_EQ(stats[CacheOperation::AddOrder].work.touched, 10);
+    EXPECT_EQ(stats[CacheOperation::AddOrder].latency.count(), 10);
+    EXPECT_EQ(stats[CacheOperation::AddOrder].lockHold.count(), 10);
+    EXPECT_EQ(stats[CacheOperation::CancelOrder].work.touched, 1);
+    // 5 orders of User1, all of them removed
+    EXPECT_EQ(stats[CacheOperation::CancelOrdersForUser].work.scanned, 5);
+    EXPECT_EQ(stats[CacheOperation::CancelOrdersForUser].work.touched, 5);
+    // the aggregates of the companies left in the security
+    EXPECT_EQ(stats[CacheOperation::GetMatchingSizeForSecurity].work.scanned, 3);
+    EXPECT_EQ(stats[CacheOperation::GetAllOrders].calls, 1);
+    EXPECT_EQ(stats[CacheOperation::CancelOrders].calls, 0);
+    EXPECT_GE(stats[CacheOperation::AddOrder].latency.max(), stats[CacheOperation::AddOrder].lockHold.max());
+
+    cache.resetStats();
+    EXPECT_EQ(cache.stats()[CacheOperation::AddOrder].calls, 0);
+}
+
+TEST(CacheStatsTests, ShardedOrderCache_ConcurrentCalls_Succeeds)
+{
+    const int threads = 4;
+    const int ordersPerThread = 1000;
+    ShardedOrderCache cache(4, 4);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; ++t) {
+        writers.emplace_back([&cache, t] {
+            for (int i = 0; i < ordersPerThread; ++i) {
+                cache.addOrder({ "OrdId" + std::to_string(t) + "_" + std::to_string(i), "SecId" + std::to_string(i % 8), "Buy", 100, "User1", "Company1" });
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    cache.cancelOrdersForUser("User1");
+
+    const CacheStats stats = cache.stats();
+    const uint64_t expected = kStatsEnabled ? threads * ordersPerThread : 0;
+    EXPECT_EQ(stats[CacheOperation::AddOrder].calls, expected);
+    EXPECT_EQ(stats[CacheOperation::AddOrder].work.touched, expected);
+    EXPECT_EQ(stats[CacheOperation::AddOrder].lockWait.count(), expected);
+    EXPECT_LE(stats[CacheOperation::AddOrder].contended, expected);
+    EXPECT_EQ(stats[CacheOperation::CancelOrdersForUser].work.touched, expected);
+
+    // the stats of the writers outlive them until they are reset
+    cache.resetStats();
+    EXPECT_EQ(cache.stats()[CacheOperation::AddOrder].calls, 0);
+    cache.addOrder({ "OrdId", "SecId1", "Buy", 100, "User1", "Company1" });
+    EXPECT_EQ(cache.stats()[CacheOperation::AddOrder].calls, kStatsEnabled ? 1 : 0);
+}
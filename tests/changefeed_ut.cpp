@@ -0,0 +1,269 @@
+#include <gtest/gtest.h>
+
+#include "../changefeed.hpp"
+#include "testorders.hpp"
+
+#include <atomic>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Type = OrderChange::Type;
+
+// orderId -> qty, what a subscriber rebuilds from the changes
+using Replica = std::map<std::string, unsigned int>;
+
+void follow(Replica& replica, const OrderChange& change)
+{
+    switch (change.type) {
+    case Type::Add:
+        EXPECT_TRUE(replica.emplace(change.orderId, change.qty).second) << change.orderId;
+        break;
+    case Type::Fill:
+        ASSERT_TRUE(replica.count(change.orderId)) << change.orderId;
+        EXPECT_LT(change.qty, replica[change.orderId]);
+        replica[change.orderId] = change.qty;
+        break;
+    case Type::Remove:
+        ASSERT_TRUE(replica.count(change.orderId)) << change.orderId;
+        EXPECT_EQ(replica[change.orderId], change.qty);
+        replica.erase(change.orderId);
+        break;
+    }
+}
+
+void follow(Replica& replica, const OrderBookSnapshot& snapshot)
+{
+    snapshot.forEach([&replica](const OrderBookSnapshot::Entry& order) { replica.emplace(order.orderId, order.qty); });
+}
+
+// a snapshot per shard
+void follow(Replica& replica, const std::vector<OrderBookSnapshot>& snapshots)
+{
+    for (const auto& snapshot : snapshots) {
+        follow(replica, snapshot);
+    }
+}
+
+// what subscribe() hands the book over in
+template <typename Cache>
+struct SubscribeSnapshot {
+    using Type = OrderBookSnapshot;
+};
+
+template <>
+struct SubscribeSnapshot<ShardedOrderCache> {
+    using Type = std::vector<OrderBookSnapshot>;
+};
+
+// orders of the security only when one is given
+template <typename Cache>
+Replica replicaOf(const Cache& cache, const std::string& securityId = {})
+{
+    Replica out;
+    for (const auto& order : cache.getAllOrders()) {
+        if (securityId.empty() || order.securityId() == securityId) {
+            out.emplace(order.orderId(), order.qty());
+        }
+    }
+    return out;
+}
+
+const testorders::OrderPools kPools { 20, 8, 4, 100, 900 };
+
+// every kind of operation, a mix of adds, cancels and fills
+template <typename Cache>
+void mutate(Cache& cache, std::mt19937& rng, int first, int count)
+{
+    for (int i = first; i < first + count; ++i) {
+        cache.addOrder(testorders::randomOrder(rng, i, kPools));
+        switch (rng() % 40) {
+        case 0:
+            cache.cancelOrdersForUser("User" + std::to_string(rng() % 8));
+            break;
+        case 1:
+            cache.cancelOrdersForSecIdWithMinimumQty("SecId" + std::to_string(rng() % 20), 500);
+            break;
+        case 2:
+            cache.cancelOrdersForCompany("Company" + std::to_string(rng() % 4));
+            break;
+        case 3:
+        case 4:
+        case 5:
+            cache.getMatchingSizeForSecurity2("SecId" + std::to_string(rng() % 20));
+            break;
+        default:
+            if (rng() % 3 == 0) {
+                cache.cancelOrder("OrdId" + std::to_string(first + rng() % (i - first + 1)));
+            }
+            break;
+        }
+    }
+    std::vector<Order> batch;
+    for (int i = first + count; i < first + count + 50; ++i) {
+        batch.push_back(testorders::randomOrder(rng, i, kPools));
+    }
+    cache.addOrders(batch);
+    cache.cancelOrders({ "OrdId" + std::to_string(first + count), "OrdId" + std::to_string(first + count + 1) });
+    cache.cancelOrdersForUsers({ "User2", "User5" });
+    OrderFilter filter;
+    filter.side = "Sell";
+    filter.minQty = 800;
+    cache.cancelOrdersMatching(filter);
+}
+
+} // namespace
+
+TEST(ChangeFeedTests, Publish_BatchesPerFlushAndFilters_Succeeds)
+{
+    ChangePublisher publisher;
+    EXPECT_FALSE(publisher.active());
+    auto all = std::make_shared<ChangeSubscription>(ChangeFilter {});
+    auto security = std::make_shared<ChangeSubscription>(ChangeFilter { "SecId1", std::nullopt });
+    auto user = std::make_shared<ChangeSubscription>(ChangeFilter { std::nullopt, "User2" });
+    publisher.subscribe(all);
+    publisher.subscribe(security);
+    publisher.subscribe(user);
+    EXPECT_TRUE(publisher.active());
+
+    publisher.publish(Type::Add, 100, "OrdId1", "SecId1", "Buy", "User1", "CompanyA");
+    publisher.publish(Type::Add, 200, "OrdId2", "SecId2", "Sell", "User2", "CompanyB");
+    publisher.flush();
+    publisher.publish(Type::Fill, 50, "OrdId1", "SecId1", "Buy", "User1", "CompanyA");
+    publisher.flush();
+    // nothing pending, no empty batches
+    publisher.flush();
+
+    std::vector<size_t> batches;
+    EXPECT_EQ(all->drain([&batches](const std::vector<OrderChange>& batch) { batches.push_back(batch.size()); }), 2);
+    EXPECT_EQ(batches, (std::vector<size_t> { 2, 1 }));
+    EXPECT_TRUE(all->poll().empty());
+
+    const auto securityChanges = security->poll();
+    ASSERT_EQ(securityChanges.size(), 2);
+    EXPECT_EQ(securityChanges[0].type, Type::Add);
+    EXPECT_EQ(securityChanges[0].qty, 100);
+    EXPECT_EQ(securityChanges[1].type, Type::Fill);
+    EXPECT_EQ(securityChanges[1].qty, 50);
+    EXPECT_EQ(securityChanges[1].company, "CompanyA");
+
+    const auto userChanges = user->poll();
+    ASSERT_EQ(userChanges.size(), 1);
+    EXPECT_EQ(userChanges[0].orderId, "OrdId2");
+    EXPECT_EQ(userChanges[0].side, "Sell");
+
+    publisher.unsubscribe(all.get());
+    publisher.unsubscribe(security.get());
+    publisher.unsubscribe(user.get());
+    EXPECT_FALSE(publisher.active());
+}
+
+TEST(ChangeFeedTests, Publish_FullRingDropsBatches_Succeeds)
+{
+    ChangePublisher publisher;
+    auto subscription = std::make_shared<ChangeSubscription>(ChangeFilter {}, 2);
+    publisher.subscribe(subscription);
+    for (int i = 0; i < 5; ++i) {
+        publisher.publish(Type::Add, 100, "OrdId" + std::to_string(i), "SecId1", "Buy", "User1", "CompanyA");
+        publisher.publish(Type::Remove, 100, "OrdId" + std::to_string(i), "SecId1", "Buy", "User1", "CompanyA");
+        publisher.flush();
+    }
+    EXPECT_EQ(subscription->droppedBatches(), 3);
+    EXPECT_EQ(subscription->droppedChanges(), 6);
+    const auto changes = subscription->poll();
+    ASSERT_EQ(changes.size(), 4);
+    EXPECT_EQ(changes[0].orderId, "OrdId0");
+    EXPECT_EQ(changes[3].orderId, "OrdId1");
+
+    // room again
+    publisher.publish(Type::Add, 100, "OrdId5", "SecId1", "Buy", "User1", "CompanyA");
+    publisher.flush();
+    EXPECT_EQ(subscription->poll().size(), 1);
+    EXPECT_EQ(subscription->droppedBatches(), 3);
+}
+
+template <typename Cache>
+class ChangeFeedCacheTests : public testorders::CacheTest<Cache> {
+};
+
+TYPED_TEST_SUITE(ChangeFeedCacheTests, testorders::ThreadSafeCacheTypes, testorders::CacheTypeNames);
+
+TYPED_TEST(ChangeFeedCacheTests, ReplicaFollowsCache_Succeeds)
+{
+    auto& cache = this->cache();
+    std::mt19937 rng { 5 };
+    mutate(cache, rng, 0, 500);
+
+    auto all = cache.subscribe({}, 1 << 16);
+    auto security = cache.subscribe({ "SecId3", std::nullopt }, 1 << 16);
+    Replica replica = replicaOf(cache);
+    Replica securityReplica = replicaOf(cache, "SecId3");
+
+    mutate(cache, rng, 1000, 2000);
+    for (const auto& change : all->poll()) {
+        follow(replica, change);
+    }
+    for (const auto& change : security->poll()) {
+        EXPECT_EQ(change.securityId, "SecId3");
+        follow(securityReplica, change);
+    }
+    EXPECT_EQ(all->droppedBatches(), 0);
+    EXPECT_EQ(replica, replicaOf(cache));
+    EXPECT_FALSE(securityReplica.empty());
+    EXPECT_EQ(securityReplica, replicaOf(cache, "SecId3"));
+
+    cache.unsubscribe(all);
+    cache.addOrder(testorders::randomOrder(rng, 10000, kPools));
+    EXPECT_TRUE(all->poll().empty());
+}
+
+// the subscriber drains while writers keep going, starting from the snapshot taken along with the subscription
+TYPED_TEST(ChangeFeedCacheTests, ConcurrentWritersReplica_Succeeds)
+{
+    auto& cache = this->cache();
+    std::mt19937 setup { 7 };
+    mutate(cache, setup, 0, 300);
+    typename SubscribeSnapshot<TypeParam>::Type snapshot;
+    auto subscription = cache.subscribe({}, 1 << 16, &snapshot);
+    Replica replica;
+    follow(replica, snapshot);
+
+    const int writers = 4;
+    std::atomic<int> running { writers };
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&cache, &running, w] {
+            std::mt19937 rng(w);
+            for (int i = 0; i < 500; ++i) {
+                const int id = 100000 * (w + 1) + i;
+                cache.addOrder(testorders::randomOrder(rng, id, kPools));
+                if (i % 3 == 0) {
+                    cache.cancelOrder("OrdId" + std::to_string(id - 2));
+                }
+                if (i % 50 == 0) {
+                    cache.getMatchingSizeForSecurity2("SecId" + std::to_string(rng() % 20));
+                }
+            }
+            --running;
+        });
+    }
+    while (running > 0) {
+        subscription->drain([&replica](const std::vector<OrderChange>& batch) {
+            for (const auto& change : batch) {
+                follow(replica, change);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& change : subscription->poll()) {
+        follow(replica, change);
+    }
+    EXPECT_EQ(subscription->droppedBatches(), 0);
+    EXPECT_EQ(replica, replicaOf(cache));
+}
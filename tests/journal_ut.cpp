@@ -0,0 +1,294 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../journal.hpp"
+#include "../ordercacheimpl.hpp"
+
+static bool operator==(const Order& lhr, const Order& rhr)
+{
+    return lhr.company() == rhr.company() && lhr.orderId() == rhr.orderId() && lhr.qty() == rhr.qty() && lhr.securityId() == rhr.securityId() && lhr.side() == rhr.side() && lhr.user() == rhr.user();
+}
+
+// a loaded snapshot packs the slots, orders come back in another order
+static std::vector<Order> sorted(std::vector<Order> orders)
+{
+    std::sort(orders.begin(), orders.end(), [](const Order& lhs, const Order& rhs) { return lhs.orderId() < rhs.orderId(); });
+    return orders;
+}
+
+using orderlog::Event;
+using orderlog::EventType;
+
+class JournalTests : public ::testing::Test {
+
+protected:
+    void SetUp() override
+    {
+        const std::string name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        m_journalPath = ::testing::TempDir() + "journal_ut_" + name + ".journal";
+        m_snapshotPath = ::testing::TempDir() + "journal_ut_" + name + ".snapshot";
+        std::remove(m_journalPath.c_str());
+        std::remove(m_snapshotPath.c_str());
+    }
+
+    void TearDown() override
+    {
+        std::remove(m_journalPath.c_str());
+        std::remove(m_snapshotPath.c_str());
+    }
+
+    static Event cancel(const std::string& orderId)
+    {
+        Event event;
+        event.type = EventType::Cancel;
+        event.orderId = orderId;
+        return event;
+    }
+
+    std::vector<std::string> replay(uint64_t from = 0)
+    {
+        std::vector<std::string> out;
+        Journal::replay(m_journalPath, from, [&out](const Event& event) { out.emplace_back(event.orderId); });
+        return out;
+    }
+
+    // the same flow applied to every cache, fills of getMatchingSizeForSecurity2 included
+    static void mutate(OrderCacheInterface& cache, int first, int count)
+    {
+        for (int i = first; i < first + count; ++i) {
+            cache.addOrder({ "OrdId" + std::to_string(i), "SecId" + std::to_string(i % 5), i % 2 ? "Buy" : "Sell", static_cast<unsigned int>(100 + i % 7 * 10),
+                "User" + std::to_string(i % 4), "Company" + std::to_string(i % 3) });
+            if (i % 5 == 0) {
+                cache.cancelOrder("OrdId" + std::to_string(i - 3));
+            }
+        }
+        cache.cancelOrdersForUser("User" + std::to_string(first % 4));
+        cache.cancelOrdersForSecIdWithMinimumQty("SecId1", 150);
+        cache.getMatchingSizeForSecurity2("SecId2");
+        cache.getMatchingSizeForSecurity2("SecId3");
+    }
+
+    std::string m_journalPath;
+    std::string m_snapshotPath;
+};
+
+TEST_F(JournalTests, Append_ReplayAndReopen_Succeeds)
+{
+    {
+        Journal journal(m_journalPath);
+        for (int i = 0; i < 100; ++i) {
+            EXPECT_EQ(journal.append(cancel("OrdId" + std::to_string(i))), i);
+        }
+        journal.wait(99);
+    }
+    EXPECT_EQ(replay().size(), 100);
+    EXPECT_EQ(replay(90).front(), "OrdId90");
+
+    Journal journal(m_journalPath, { 1 << 20, std::chrono::seconds(10), false, false });
+    EXPECT_EQ(journal.nextSequence(), 100);
+    journal.append(cancel("OrdId100"));
+    journal.flush();
+    EXPECT_EQ(replay().back(), "OrdId100");
+}
+
+TEST_F(JournalTests, Open_TornEventIsCutOff_Succeeds)
+{
+    {
+        Journal journal(m_journalPath);
+        journal.append(cancel("OrdId1"));
+        journal.append(cancel("OrdId2"));
+    }
+    // a crash in the middle of writing the third event
+    std::FILE* file = std::fopen(m_journalPath.c_str(), "ab");
+    std::fwrite("\x01\x06OrdI", 1, 6, file);
+    std::fclose(file);
+    EXPECT_EQ(replay(), (std::vector<std::string> { "OrdId1", "OrdId2" }));
+
+    {
+        Journal journal(m_journalPath);
+        EXPECT_EQ(journal.append(cancel("OrdId3")), 2);
+    }
+    EXPECT_EQ(replay(), (std::vector<std::string> { "OrdId1", "OrdId2", "OrdId3" }));
+}
+
+TEST_F(JournalTests, Open_ZeroedTailIsCutOff_Succeeds)
+{
+    {
+        Journal journal(m_journalPath);
+        journal.append(cancel("OrdId1"));
+    }
+    // the file grew but the data never made it to disk
+    std::FILE* file = std::fopen(m_journalPath.c_str(), "ab");
+    const std::string zeros(64, '\0');
+    std::fwrite(zeros.data(), 1, zeros.size(), file);
+    std::fclose(file);
+    EXPECT_EQ(replay(), std::vector<std::string> { "OrdId1" });
+
+    {
+        Journal journal(m_journalPath);
+        EXPECT_EQ(journal.append(cancel("OrdId2")), 1);
+    }
+    EXPECT_EQ(replay(), (std::vector<std::string> { "OrdId1", "OrdId2" }));
+}
+
+TEST_F(JournalTests, Replay_DamagedEventEndsJournal_Succeeds)
+{
+    {
+        Journal journal(m_journalPath);
+        for (int i = 0; i < 3; ++i) {
+            journal.append(cancel("OrdId" + std::to_string(i)));
+        }
+    }
+    // a record of these cancels takes 16 bytes, 18 bytes before the end is the orderId of the second one
+    std::FILE* file = std::fopen(m_journalPath.c_str(), "r+b");
+    ASSERT_EQ(std::fseek(file, -18, SEEK_END), 0);
+    std::fputc('X', file);
+    std::fclose(file);
+    EXPECT_EQ(replay(), std::vector<std::string> { "OrdId0" });
+}
+
+TEST_F(JournalTests, DiscardBefore_KeepsLaterEvents_Succeeds)
+{
+    Journal journal(m_journalPath);
+    for (int i = 0; i < 10; ++i) {
+        journal.append(cancel("OrdId" + std::to_string(i)));
+    }
+    journal.discardBefore(7);
+    journal.append(cancel("OrdId10"));
+    journal.flush();
+    EXPECT_EQ(replay(7), (std::vector<std::string> { "OrdId7", "OrdId8", "OrdId9", "OrdId10" }));
+    EXPECT_EQ(journal.nextSequence(), 11);
+}
+
+TEST_F(JournalTests, Replay_JournalStartsAfterFrom_Throws)
+{
+    {
+        Journal journal(m_journalPath);
+        for (int i = 0; i < 10; ++i) {
+            journal.append(cancel("OrdId" + std::to_string(i)));
+        }
+        journal.discardBefore(7);
+    }
+    EXPECT_THROW(replay(5), std::runtime_error);
+    EXPECT_THROW(Journal(m_journalPath, {}, 5), std::runtime_error);
+    EXPECT_EQ(replay(7), (std::vector<std::string> { "OrdId7", "OrdId8", "OrdId9" }));
+    // a snapshot past the end of the journal covers all of it
+    EXPECT_EQ(Journal::replay(m_journalPath, 12, [](const Event&) { FAIL(); }), 12);
+}
+
+TEST_F(JournalTests, Recover_SnapshotOlderThanJournal_Throws)
+{
+    {
+        OrderCacheImpl cache;
+        cache.startJournal(m_journalPath);
+        mutate(cache, 0, 100);
+        cache.saveSnapshot(m_snapshotPath);
+        mutate(cache, 100, 100);
+        // a later checkpoint whose snapshot got lost
+        cache.checkpoint(m_snapshotPath + ".lost");
+        mutate(cache, 200, 100);
+    }
+    std::remove((m_snapshotPath + ".lost").c_str());
+
+    OrderCacheImpl recovered;
+    EXPECT_THROW(recovered.recover(m_snapshotPath, m_journalPath), std::runtime_error);
+}
+
+TEST_F(JournalTests, Recover_JournalOnly_Succeeds)
+{
+    OrderCacheImpl expected;
+    mutate(expected, 0, 200);
+    {
+        OrderCacheImpl cache;
+        cache.startJournal(m_journalPath);
+        mutate(cache, 0, 200);
+        EXPECT_EQ(cache.getAllOrders(), expected.getAllOrders());
+    }
+
+    OrderCacheImpl recovered;
+    recovered.recover(m_snapshotPath, m_journalPath);
+    EXPECT_EQ(recovered.getAllOrders(), expected.getAllOrders());
+}
+
+TEST_F(JournalTests, Recover_BalancedMatches_Succeeds)
+{
+    OrderCacheImpl expected;
+    {
+        OrderCacheImpl cache;
+        cache.startJournal(m_journalPath);
+        for (OrderCacheImpl* target : { &expected, &cache }) {
+            mutate(*target, 0, 200);
+            for (int security = 0; security < 5; ++security) {
+                target->matchSecurity("SecId" + std::to_string(security), security % 2 ? MatchingMode::Balanced : MatchingMode::Greedy);
+            }
+            mutate(*target, 200, 100);
+        }
+        EXPECT_EQ(cache.getAllOrders(), expected.getAllOrders());
+    }
+
+    OrderCacheImpl recovered;
+    recovered.recover(m_snapshotPath, m_journalPath);
+    EXPECT_EQ(recovered.getAllOrders(), expected.getAllOrders());
+}
+
+TEST_F(JournalTests, Recover_CheckpointAndJournal_Succeeds)
+{
+    OrderCacheImpl expected;
+    mutate(expected, 0, 200);
+    mutate(expected, 200, 100);
+    mutate(expected, 300, 100);
+    {
+        OrderCacheImpl cache;
+        cache.startJournal(m_journalPath);
+        mutate(cache, 0, 200);
+        cache.checkpoint(m_snapshotPath);
+        mutate(cache, 200, 100);
+    }
+    {
+        // restarts, continues journaling and crashes again
+        OrderCacheImpl cache;
+        cache.recover(m_snapshotPath, m_journalPath);
+        cache.startJournal(m_journalPath);
+        mutate(cache, 300, 100);
+    }
+
+    OrderCacheImpl recovered;
+    recovered.recover(m_snapshotPath, m_journalPath);
+    EXPECT_EQ(sorted(recovered.getAllOrders()), sorted(expected.getAllOrders()));
+}
+
+TEST_F(JournalTests, Recover_ConcurrentWritersWithoutWaiting_Succeeds)
+{
+    const int threads = 4;
+    const int ordersPerThread = 500;
+    {
+        OrderCacheImpl cache;
+        Journal::Options options;
+        options.waitForCommit = false;
+        cache.startJournal(m_journalPath, options);
+        std::vector<std::thread> writers;
+        for (int t = 0; t < threads; ++t) {
+            writers.emplace_back([&cache, t] {
+                for (int i = 0; i < ordersPerThread; ++i) {
+                    cache.addOrder({ "OrdId" + std::to_string(t) + "_" + std::to_string(i), "SecId" + std::to_string(t), "Buy", 100, "User1", "Company1" });
+                }
+                cache.cancelOrdersForSecIdWithMinimumQty("SecId" + std::to_string(t), 100);
+                cache.addOrder({ "OrdIdLast" + std::to_string(t), "SecId" + std::to_string(t), "Buy", 100, "User1", "Company1" });
+            });
+        }
+        for (auto& writer : writers) {
+            writer.join();
+        }
+    }
+
+    OrderCacheImpl recovered;
+    recovered.recover(m_snapshotPath, m_journalPath);
+    EXPECT_EQ(recovered.getAllOrders().size(), threads);
+}
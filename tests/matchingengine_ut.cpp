@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+
+#include "../matchingaggregates.hpp"
+#include "../matchingengine.hpp"
+#include "testorders.hpp"
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct TestOrder {
+    SymbolId company;
+    bool sell;
+    unsigned int qty;
+};
+
+// orderId -> order, to check fills against the book they were made from
+std::map<std::string, Order> byOrderId(const std::vector<Order>& orders)
+{
+    std::map<std::string, Order> out;
+    for (const auto& order : orders) {
+        out.emplace(order.orderId(), order);
+    }
+    return out;
+}
+
+// every fill pairs a sell with a buy of another company of the security, orders trade what they lost and the orders
+// left in the book are the unfilled rest
+void expectFillsConsistent(const std::vector<Order>& before, const std::vector<Order>& after, const std::string& securityId,
+    const std::vector<Fill>& fills)
+{
+    const auto orders = byOrderId(before);
+    std::map<std::string, unsigned int> traded;
+    for (const auto& fill : fills) {
+        EXPECT_GT(fill.qty, 0);
+        const Order& sell = orders.at(fill.sellOrderId);
+        const Order& buy = orders.at(fill.buyOrderId);
+        EXPECT_EQ(sell.side(), "Sell");
+        EXPECT_EQ(buy.side(), "Buy");
+        EXPECT_EQ(sell.securityId(), securityId);
+        EXPECT_EQ(buy.securityId(), securityId);
+        EXPECT_NE(sell.company(), buy.company());
+        traded[fill.sellOrderId] += fill.qty;
+        traded[fill.buyOrderId] += fill.qty;
+    }
+    const auto left = byOrderId(after);
+    for (const auto& [orderId, order] : orders) {
+        const unsigned int qty = order.qty() - traded[orderId];
+        EXPECT_LE(traded[orderId], order.qty()) << orderId;
+        EXPECT_EQ(left.count(orderId) ? left.at(orderId).qty() : 0, qty) << orderId;
+    }
+}
+
+} // namespace
+
+TEST(MatchingEngineTests, BalancedMatcher_TradesMatchingSize_Succeeds)
+{
+    std::mt19937 rng { 3 };
+    BalancedMatcher matcher;
+    for (int round = 0; round < 3000; ++round) {
+        std::vector<TestOrder> orders;
+        MatchingAggregates aggregates;
+        const size_t count = 1 + rng() % 40;
+        const unsigned int companies = 1 + rng() % 6;
+        matcher.clear();
+        for (size_t i = 0; i < count; ++i) {
+            // company ids far apart, small quantities make for many ties
+            orders.push_back({ static_cast<SymbolId>(rng() % companies * 1000), rng() % 2 == 0, static_cast<unsigned int>(rng() % 10) });
+            matcher.add(orders.back().company, orders.back().sell, orders.back().qty);
+            aggregates.add(orders.back().company, orders.back().sell, orders.back().qty);
+        }
+
+        const auto executions = matcher.match();
+        std::vector<unsigned int> remaining;
+        for (const auto& order : orders) {
+            remaining.push_back(order.qty);
+        }
+        unsigned int total = 0;
+        for (const auto& execution : executions) {
+            ASSERT_LT(execution.sell, orders.size());
+            ASSERT_LT(execution.buy, orders.size());
+            EXPECT_TRUE(orders[execution.sell].sell);
+            EXPECT_FALSE(orders[execution.buy].sell);
+            EXPECT_NE(orders[execution.sell].company, orders[execution.buy].company);
+            EXPECT_GT(execution.qty, 0);
+            ASSERT_LE(execution.qty, remaining[execution.sell]);
+            ASSERT_LE(execution.qty, remaining[execution.buy]);
+            remaining[execution.sell] -= execution.qty;
+            remaining[execution.buy] -= execution.qty;
+            total += execution.qty;
+        }
+        EXPECT_EQ(total, aggregates.matchingSize()) << "round " << round;
+        // a step fills an order or pins the third company, it never takes more steps than orders
+        EXPECT_LE(executions.size(), count);
+
+        // the same orders match the same way
+        matcher.clear();
+        for (const auto& order : orders) {
+            matcher.add(order.company, order.sell, order.qty);
+        }
+        const auto again = matcher.match();
+        ASSERT_EQ(again.size(), executions.size());
+        for (size_t i = 0; i < again.size(); ++i) {
+            EXPECT_EQ(again[i].sell, executions[i].sell);
+            EXPECT_EQ(again[i].buy, executions[i].buy);
+            EXPECT_EQ(again[i].qty, executions[i].qty);
+        }
+    }
+}
+
+TEST(MatchingEngineTests, Balanced_MatchesWhatGreedyLeavesBehind_Succeeds)
+{
+    // greedy sells Company3's 100 to Company1 first, then Company2 only has 200 of Company1's buy left
+    const std::vector<Order> orders { { "OrdId1", "SecId1", "Sell", 100, "User1", "Company3" },
+        { "OrdId2", "SecId1", "Buy", 300, "User1", "Company1" }, { "OrdId3", "SecId1", "Sell", 300, "User2", "Company2" },
+        { "OrdId4", "SecId1", "Buy", 300, "User2", "Company2" } };
+    OrderCacheImpl greedy;
+    OrderCacheImpl balanced;
+    greedy.addOrders(orders);
+    balanced.addOrders(orders);
+    EXPECT_EQ(balanced.getMatchingSizeForSecurity("SecId1"), 400);
+
+    EXPECT_EQ(greedy.matchSecurity("SecId1", MatchingMode::Greedy),
+        (std::vector<Fill> { { "OrdId1", "OrdId2", 100 }, { "OrdId3", "OrdId2", 200 } }));
+    EXPECT_EQ(balanced.matchSecurity("SecId1"), (std::vector<Fill> { { "OrdId3", "OrdId2", 300 }, { "OrdId1", "OrdId4", 100 } }));
+    ASSERT_EQ(balanced.getAllOrders().size(), 1);
+    EXPECT_EQ(balanced.getAllOrders()[0].orderId(), "OrdId4");
+    EXPECT_EQ(balanced.getAllOrders()[0].qty(), 200);
+    EXPECT_EQ(greedy.getAllOrders().size(), 2);
+}
+
+TEST(MatchingEngineTests, Greedy_SameAsGetMatchingSizeForSecurity2_Succeeds)
+{
+    std::mt19937 rng { 9 };
+    OrderCacheImpl reference;
+    OrderCacheImpl cache;
+    for (int i = 0; i < 4000; ++i) {
+        const Order order = testorders::randomOrder(rng, i, { 8, 5, 4, 1, 1000 });
+        reference.addOrder(order);
+        cache.addOrder(order);
+        if (rng() % 25 == 0) {
+            const std::string securityId = "SecId" + std::to_string(rng() % 8);
+            const auto before = cache.getAllOrders();
+            const unsigned int expected = reference.getMatchingSizeForSecurity2(securityId);
+            const auto fills = cache.matchSecurity(securityId, MatchingMode::Greedy);
+            unsigned int total = 0;
+            for (const auto& fill : fills) {
+                total += fill.qty;
+            }
+            EXPECT_EQ(total, expected);
+            expectFillsConsistent(before, cache.getAllOrders(), securityId, fills);
+        }
+    }
+    const auto left = byOrderId(cache.getAllOrders());
+    const auto expected = byOrderId(reference.getAllOrders());
+    ASSERT_EQ(left.size(), expected.size());
+    for (const auto& [orderId, order] : expected) {
+        EXPECT_EQ(left.at(orderId).qty(), order.qty()) << orderId;
+    }
+}
+
+template <typename Cache>
+class MatchingEngineCacheTests : public testorders::CacheTest<Cache> {
+};
+
+TYPED_TEST_SUITE(MatchingEngineCacheTests, testorders::CacheTypes, testorders::CacheTypeNames);
+
+TYPED_TEST(MatchingEngineCacheTests, BalancedTradesMatchingSize_Succeeds)
+{
+    auto& cache = this->cache();
+    std::mt19937 rng { 17 };
+    for (int i = 0; i < 3000; ++i) {
+        cache.addOrder(testorders::randomOrder(rng, i, { 10, 5, 5, 1, 1000 }));
+        if (rng() % 20 == 0) {
+            const std::string securityId = "SecId" + std::to_string(rng() % 10);
+            const auto before = cache.getAllOrders();
+            const unsigned int expected = cache.getMatchingSizeForSecurity(securityId);
+            const auto fills = cache.matchSecurity(securityId);
+            unsigned int total = 0;
+            for (const auto& fill : fills) {
+                total += fill.qty;
+            }
+            EXPECT_EQ(total, expected) << securityId;
+            EXPECT_EQ(cache.getMatchingSizeForSecurity(securityId), 0) << securityId;
+            expectFillsConsistent(before, cache.getAllOrders(), securityId, fills);
+        }
+    }
+}
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "../mappedfile.hpp"
+#include "../orderlog.hpp"
+
+using orderlog::Event;
+using orderlog::EventType;
+
+static std::vector<Event> readAll(const std::string& log)
+{
+    orderlog::Reader reader(log.data(), log.size());
+    std::vector<Event> out;
+    for (Event event; reader.next(event);) {
+        out.push_back(event);
+    }
+    return out;
+}
+
+namespace orderlog {
+static bool operator==(const Event& lhs, const Event& rhs)
+{
+    return lhs.type == rhs.type && lhs.orderId == rhs.orderId && lhs.securityId == rhs.securityId && lhs.side == rhs.side
+        && lhs.user == rhs.user && lhs.company == rhs.company && lhs.qty == rhs.qty && lhs.expiresAt == rhs.expiresAt;
+}
+}
+
+static const std::string kCsv { "# recorded flow\n"
+                                "A,OrdId1,SecId1,Buy,100,User1,CompanyA\n"
+                                "A,OrdId2,SecId1,Sell,300,User2,CompanyB\r\n"
+                                "\n"
+                                "M,SecId1\n"
+                                "S,SecId1,200\n"
+                                "C,OrdId1\n"
+                                "U,User2\n"
+                                "AE,OrdId3,SecId1,Sell,50,User1,CompanyA,1767225600000\n"
+                                "M2,SecId1" };
+
+TEST(OrderLogTests, ReadCsv_AllEventTypes_Succeeds)
+{
+    const auto events = readAll(kCsv);
+    ASSERT_EQ(events.size(), 8);
+    EXPECT_EQ(events[0].type, EventType::Add);
+    EXPECT_EQ(events[0].orderId, "OrdId1");
+    EXPECT_EQ(events[0].securityId, "SecId1");
+    EXPECT_EQ(events[0].side, "Buy");
+    EXPECT_EQ(events[0].qty, 100);
+    EXPECT_EQ(events[0].user, "User1");
+    EXPECT_EQ(events[0].company, "CompanyA");
+    EXPECT_EQ(events[1].company, "CompanyB");
+    EXPECT_EQ(events[2].type, EventType::MatchingSize);
+    EXPECT_EQ(events[3].type, EventType::CancelForSecIdWithMinimumQty);
+    EXPECT_EQ(events[3].qty, 200);
+    EXPECT_EQ(events[4].type, EventType::Cancel);
+    EXPECT_EQ(events[4].orderId, "OrdId1");
+    EXPECT_EQ(events[5].type, EventType::CancelForUser);
+    EXPECT_EQ(events[5].user, "User2");
+    EXPECT_EQ(events[6].type, EventType::AddWithExpiry);
+    EXPECT_EQ(events[6].orderId, "OrdId3");
+    EXPECT_EQ(events[6].qty, 50);
+    EXPECT_EQ(events[6].company, "CompanyA");
+    EXPECT_EQ(events[6].expiresAt, 1767225600000);
+    EXPECT_EQ(events[7].type, EventType::MatchingSize2);
+    EXPECT_EQ(events[7].securityId, "SecId1");
+}
+
+TEST(OrderLogTests, ReadBinary_SameAsCsv_Succeeds)
+{
+    const auto events = readAll(kCsv);
+    std::string binary { orderlog::kBinaryMagic };
+    std::string csv;
+    for (const auto& event : events) {
+        orderlog::appendBinary(binary, event);
+        orderlog::appendCsv(csv, event);
+    }
+
+    orderlog::Reader reader(binary.data(), binary.size());
+    EXPECT_TRUE(reader.binary());
+    EXPECT_EQ(readAll(binary), events);
+    EXPECT_EQ(readAll(csv), events);
+}
+
+TEST(OrderLogTests, Read_MalformedLog_Fails)
+{
+    EXPECT_THROW(readAll("A,OrdId1,SecId1,Buy,100,User1\n"), std::runtime_error);
+    EXPECT_THROW(readAll("A,OrdId1,SecId1,Buy,1x0,User1,CompanyA\n"), std::runtime_error);
+    EXPECT_THROW(readAll("C,OrdId1,OrdId2\n"), std::runtime_error);
+    EXPECT_THROW(readAll("X,OrdId1\n"), std::runtime_error);
+    EXPECT_THROW(readAll("AE,OrdId1,SecId1,Buy,100,User1,CompanyA,-1\n"), std::runtime_error);
+
+    std::string binary { orderlog::kBinaryMagic };
+    Event cancel;
+    cancel.type = EventType::Cancel;
+    cancel.orderId = "OrdId1";
+    orderlog::appendBinary(binary, cancel);
+    binary.pop_back();
+    EXPECT_THROW(readAll(binary), std::runtime_error);
+}
+
+TEST(OrderLogTests, MappedFile_ReadsWholeFile_Succeeds)
+{
+    const std::string path = ::testing::TempDir() + "orderlog_ut.csv";
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    std::fwrite(kCsv.data(), 1, kCsv.size(), file);
+    std::fclose(file);
+
+    {
+        const MappedFile mapped(path);
+        EXPECT_EQ(std::string(mapped.data(), mapped.size()), kCsv);
+    }
+    std::remove(path.c_str());
+    EXPECT_THROW(MappedFile { path }, std::system_error);
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "../scankernels.hpp"
+
+class ScanKernelsTests : public ::testing::Test {
+
+protected:
+    void SetUp() override
+    {
+        std::mt19937 rng { 42 };
+        std::uniform_int_distribution<SymbolId> securities { 0, 7 };
+        std::uniform_int_distribution<unsigned int> quantities { 0, 0xffffffffu };
+        std::bernoulli_distribution alive { 0.8 };
+
+        // odd size so the vectorized kernel has a tail to deal with
+        for (size_t i = 0; i < 1021; ++i) {
+            m_security.push_back(securities(rng));
+            m_qty.push_back(quantities(rng));
+            m_live.push_back(alive(rng));
+        }
+    }
+
+    std::vector<uint32_t> expected(SymbolId securityId, unsigned int minQty) const
+    {
+        std::vector<uint32_t> out;
+        for (uint32_t i = 0; i < m_security.size(); ++i) {
+            if (m_live[i] && m_security[i] == securityId && m_qty[i] >= minQty) {
+                out.push_back(i);
+            }
+        }
+        return out;
+    }
+
+    using Kernel = size_t (*)(const SymbolId*, const unsigned int*, const uint8_t*, size_t, SymbolId, unsigned int, uint32_t*);
+
+    std::vector<uint32_t> run(Kernel kernel, SymbolId securityId, unsigned int minQty) const
+    {
+        std::vector<uint32_t> out(m_security.size());
+        out.resize(kernel(m_security.data(), m_qty.data(), m_live.data(), m_security.size(), securityId, minQty, out.data()));
+        return out;
+    }
+
+    std::vector<SymbolId> m_security;
+    std::vector<unsigned int> m_qty;
+    std::vector<uint8_t> m_live;
+};
+
+TEST_F(ScanKernelsTests, SecurityMinQty_Scalar_Success)
+{
+    for (unsigned int minQty : { 0u, 1u, 0x7fffffffu, 0x80000000u, 0xffffffffu }) {
+        EXPECT_EQ(run(&scan::securityMinQtyScalar, 3, minQty), expected(3, minQty));
+    }
+}
+
+TEST_F(ScanKernelsTests, SecurityMinQty_Avx2_Success)
+{
+    if (!scan::avx2Supported()) {
+        GTEST_SKIP() << "AVX2 not supported by this CPU";
+    }
+    // minQty above INT_MAX makes sure qty is compared as unsigned
+    for (unsigned int minQty : { 0u, 1u, 0x7fffffffu, 0x80000000u, 0xffffffffu }) {
+        EXPECT_EQ(run(&scan::securityMinQtyAvx2, 3, minQty), expected(3, minQty));
+    }
+}
+
+TEST_F(ScanKernelsTests, SecurityMinQty_UnknownSecurity_Success)
+{
+    EXPECT_TRUE(run(&scan::securityMinQty, SymbolTable::npos, 0).empty());
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "../matchingaggregates.hpp"
+#include "../securityranking.hpp"
+
+TEST(SecurityRankingTests, Top_SameAsSortedReference_Succeeds)
+{
+    std::mt19937 rng { 7 };
+    SecurityRanking ranking;
+    std::map<SymbolId, unsigned int> reference;
+    for (int i = 0; i < 20000; ++i) {
+        const SymbolId security = rng() % 300;
+        // plenty of zeros to take securities out and plenty of ties
+        const unsigned int size = rng() % 3 == 0 ? 0 : rng() % 50;
+        ranking.update(security, size);
+        if (size) {
+            reference[security] = size;
+        } else {
+            reference.erase(security);
+        }
+
+        if (i % 500 == 0) {
+            std::vector<std::pair<SymbolId, unsigned int>> expected(reference.begin(), reference.end());
+            std::stable_sort(expected.begin(), expected.end(), [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second; });
+            ASSERT_EQ(ranking.size(), expected.size());
+            for (size_t n : { size_t { 0 }, size_t { 1 }, size_t { 10 }, expected.size(), expected.size() + 5 }) {
+                const size_t count = std::min(n, expected.size());
+                EXPECT_EQ(ranking.top(n), decltype(expected)(expected.begin(), expected.begin() + count));
+            }
+        }
+    }
+    ranking.clear();
+    EXPECT_TRUE(ranking.top(10).empty());
+}
+
+TEST(MatchingAggregatesTests, MatchingSize_SameAsRecomputed_Succeeds)
+{
+    std::mt19937 rng { 11 };
+    MatchingAggregates aggregates;
+    struct Totals {
+        uint64_t sell { 0 };
+        uint64_t buy { 0 };
+        std::vector<std::pair<bool, unsigned int>> orders;
+    };
+    std::map<SymbolId, Totals> companies;
+    for (int i = 0; i < 20000; ++i) {
+        const SymbolId company = rng() % 6;
+        Totals& totals = companies[company];
+        const int action = rng() % 3;
+        if (action == 0 || totals.orders.empty()) {
+            const bool sell = rng() % 2;
+            const unsigned int qty = rng() % 1000;
+            aggregates.add(company, sell, qty);
+            (sell ? totals.sell : totals.buy) += qty;
+            totals.orders.emplace_back(sell, qty);
+        } else if (action == 1) {
+            const auto [sell, qty] = totals.orders.back();
+            totals.orders.pop_back();
+            aggregates.remove(company, sell, qty);
+            (sell ? totals.sell : totals.buy) -= qty;
+        } else {
+            auto& [sell, qty] = totals.orders.back();
+            const unsigned int fill = qty / 2;
+            qty -= fill;
+            aggregates.reduce(company, sell, fill);
+            (sell ? totals.sell : totals.buy) -= fill;
+        }
+
+        uint64_t sell = 0, buy = 0, dominant = 0;
+        for (const auto& entry : companies) {
+            sell += entry.second.sell;
+            buy += entry.second.buy;
+            dominant = std::max(dominant, entry.second.sell + entry.second.buy);
+        }
+        const uint64_t expected = sell && buy ? std::min({ sell, buy, sell + buy - dominant }) : 0;
+        ASSERT_EQ(aggregates.matchingSize(), expected) << i;
+    }
+}
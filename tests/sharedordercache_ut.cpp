@@ -0,0 +1,262 @@
+#include <gtest/gtest.h>
+
+#include "../sharedordercache.hpp"
+#include "testorders.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+std::string segmentName(const std::string& test)
+{
+    return "/ordercache_" + test + "." + std::to_string(::getpid());
+}
+
+using OrderFields = std::tuple<std::string, std::string, std::string, unsigned int, std::string, std::string>;
+
+std::vector<OrderFields> sorted(const std::vector<Order>& orders)
+{
+    std::vector<OrderFields> out;
+    for (const auto& order : orders) {
+        out.emplace_back(order.orderId(), order.securityId(), order.side(), order.qty(), order.user(), order.company());
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+} // namespace
+
+TEST(SharedOrderCacheTests, Reader_SeesWhatWriterDid_Succeeds)
+{
+    SharedOrderCache cache(segmentName("same"), { 4096, 256 });
+    SharedOrderCacheReader reader(cache.name());
+    OrderCacheImpl expected;
+    EXPECT_EQ(reader.size(), 0);
+
+    std::mt19937 rng { 11 };
+    uint64_t version = reader.version();
+    for (int i = 0; i < 3000; ++i) {
+        const Order order = testorders::randomOrder(rng, i, { 10, 6, 3, 1, 1000 });
+        cache.addOrder(order);
+        expected.addOrder(order);
+        const std::string securityId = "SecId" + std::to_string(rng() % 10);
+        const std::string user = "User" + std::to_string(rng() % 6);
+        const std::string orderId = "OrdId" + std::to_string(rng() % (i + 1));
+        switch (rng() % 30) {
+        case 0:
+            cache.cancelOrdersForUser(user);
+            expected.cancelOrdersForUser(user);
+            break;
+        case 1:
+            cache.cancelOrdersForSecIdWithMinimumQty(securityId, 700);
+            expected.cancelOrdersForSecIdWithMinimumQty(securityId, 700);
+            break;
+        case 2:
+            EXPECT_EQ(cache.getMatchingSizeForSecurity2(securityId), expected.getMatchingSizeForSecurity2(securityId));
+            break;
+        default:
+            if (rng() % 2) {
+                cache.cancelOrder(orderId);
+                expected.cancelOrder(orderId);
+            }
+            break;
+        }
+    }
+    EXPECT_GT(reader.version(), version);
+
+    for (int security = 0; security < 11; ++security) {
+        const std::string securityId = "SecId" + std::to_string(security);
+        EXPECT_EQ(reader.getMatchingSizeForSecurity(securityId), expected.getMatchingSizeForSecurity(securityId)) << securityId;
+        EXPECT_EQ(cache.getMatchingSizeForSecurity(securityId), expected.getMatchingSizeForSecurity(securityId)) << securityId;
+    }
+    const auto orders = sorted(expected.getAllOrders());
+    EXPECT_EQ(sorted(reader.getAllOrders()), orders);
+    EXPECT_EQ(sorted(cache.getAllOrders()), orders);
+    EXPECT_EQ(reader.size(), orders.size());
+
+    version = reader.version();
+    cache.getMatchingSizeForSecurity("SecId1");
+    cache.getAllOrders();
+    EXPECT_EQ(reader.version(), version);
+}
+
+TEST(SharedOrderCacheTests, Limits_ThrowAndLeaveCacheUsable_Succeeds)
+{
+    SharedOrderCache cache(segmentName("limits"), { 8, 8 });
+    SharedOrderCacheReader reader(cache.name());
+    // "Sell" is interned up front, the orders take 5 more symbols
+    for (int i = 0; i < 8; ++i) {
+        cache.addOrder({ "OrdId" + std::to_string(i), "SecId1", i % 2 ? "Buy" : "Sell", 100, "User1", "Company" + std::to_string(i % 2) });
+    }
+    EXPECT_THROW(cache.addOrder({ "OrdId8", "SecId1", "Buy", 100, "User1", "Company1" }), std::length_error);
+    // a duplicate is rejected before the capacity is checked
+    EXPECT_NO_THROW(cache.addOrder({ "OrdId0", "SecId1", "Buy", 100, "User1", "Company1" }));
+    EXPECT_THROW(cache.addOrder({ std::string(SharedOrderCache::kMaxName + 1, 'x'), "SecId1", "Buy", 100, "User1", "Company1" }), std::length_error);
+    EXPECT_EQ(reader.size(), 8);
+    EXPECT_EQ(reader.getMatchingSizeForSecurity("SecId1"), 400);
+
+    cache.cancelOrder("OrdId0");
+    cache.addOrder({ std::string(SharedOrderCache::kMaxName, 'x'), "SecId1", "Sell", 50, "User1", "Company1" });
+    EXPECT_EQ(reader.size(), 8);
+    for (int i = 1; i < 4; ++i) {
+        cache.cancelOrder("OrdId" + std::to_string(i));
+    }
+    // SecId2 and User2 take the last 2 symbols, the freed slots are still there
+    cache.addOrder({ "NewOrdId0", "SecId2", "Buy", 100, "User2", "Company1" });
+    EXPECT_THROW(cache.addOrder({ "NewOrdId1", "SecId3", "Buy", 100, "User2", "Company1" }), std::length_error);
+    cache.addOrder({ "NewOrdId1", "SecId2", "Sell", 100, "User1", "Company0" });
+    EXPECT_EQ(reader.size(), 7);
+    EXPECT_EQ(reader.getMatchingSizeForSecurity("SecId2"), 100);
+    EXPECT_EQ(sorted(reader.getAllOrders()), sorted(cache.getAllOrders()));
+    EXPECT_EQ(cache.memoryUsage().orders, 7);
+    EXPECT_EQ(cache.memoryUsage().capacity, 8);
+}
+
+TEST(SharedOrderCacheTests, Symbols_FreedWithTheirLastOrder_Succeeds)
+{
+    // a few orders at once, but far more names over time than the table holds
+    SharedOrderCache cache(segmentName("symbols"), { 16, 16 });
+    SharedOrderCacheReader reader(cache.name());
+    for (int i = 0; i < 2000; ++i) {
+        const std::string n = std::to_string(i);
+        cache.addOrder({ "OrdId" + n, "SecId" + n, i % 2 ? "Buy" : "Sell", 100, "User" + n, "Company" + n });
+        cache.addOrder({ "OrdId" + n + "b", "SecId" + n, i % 2 ? "Sell" : "Buy", 50, "User" + n, "Company" + n + "b" });
+        EXPECT_EQ(reader.getMatchingSizeForSecurity("SecId" + n), 50);
+        if (i % 3 == 0) {
+            cache.cancelOrdersForUser("User" + n);
+        } else if (i >= 3) {
+            cache.cancelOrders({ "OrdId" + std::to_string(i - 3), "OrdId" + std::to_string(i - 3) + "b" });
+        }
+    }
+    EXPECT_EQ(reader.getMatchingSizeForSecurity("SecId0"), 0);
+    EXPECT_EQ(reader.size(), 4);
+    cache.cancelOrdersForSecIdWithMinimumQty("SecId1999", 0);
+    EXPECT_EQ(cache.getMatchingSizeForSecurity2("SecId1997"), 50);
+    EXPECT_EQ(reader.getMatchingSizeForSecurity("SecId1997"), 0);
+    EXPECT_EQ(sorted(reader.getAllOrders()), sorted(cache.getAllOrders()));
+    EXPECT_EQ(reader.size(), 1);
+    // names of cancelled orders can come back
+    cache.addOrder({ "OrdId0", "SecId0", "Sell", 100, "User0", "Company0" });
+    cache.addOrder({ "OrdId1", "SecId0", "Buy", 100, "User1", "Company1" });
+    EXPECT_EQ(reader.getMatchingSizeForSecurity("SecId0"), 100);
+}
+
+TEST(SharedOrderCacheTests, Reader_MissingSegment_Throws)
+{
+    EXPECT_THROW(SharedOrderCacheReader(segmentName("missing")), std::system_error);
+    std::string name;
+    {
+        SharedOrderCache cache(segmentName("gone"), { 16, 16 });
+        name = cache.name();
+    }
+    // the writer unlinks the segment
+    EXPECT_THROW(SharedOrderCacheReader { name }, std::system_error);
+}
+
+TEST(SharedOrderCacheTests, ReaderProcess_QueriesSegment_Succeeds)
+{
+    SharedOrderCache cache(segmentName("process"), { 1024, 64 });
+    std::map<std::string, unsigned int> expected;
+    OrderCacheImpl reference;
+    for (int i = 0; i < 500; ++i) {
+        const Order order { "OrdId" + std::to_string(i), "SecId" + std::to_string(i % 5), i % 3 ? "Buy" : "Sell",
+            static_cast<unsigned int>(100 + i % 70), "User" + std::to_string(i % 4), "Company" + std::to_string(i % 7) };
+        cache.addOrder(order);
+        reference.addOrder(order);
+    }
+    for (int security = 0; security < 5; ++security) {
+        const std::string securityId = "SecId" + std::to_string(security);
+        expected[securityId] = reference.getMatchingSizeForSecurity(securityId);
+    }
+
+    const pid_t child = ::fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        // no gtest assertions in the child, the exit code tells what went wrong
+        int status = 0;
+        try {
+            SharedOrderCacheReader reader(cache.name());
+            if (reader.size() != 500) {
+                status = 2;
+            }
+            for (const auto& [securityId, size] : expected) {
+                if (reader.getMatchingSizeForSecurity(securityId) != size) {
+                    status = 3;
+                }
+            }
+        } catch (...) {
+            status = 4;
+        }
+        ::_exit(status);
+    }
+    int status = 0;
+    ASSERT_EQ(::waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
+TEST(SharedOrderCacheTests, ConcurrentReaders_SeeWholeBatches_Succeeds)
+{
+    // batches of kBatch orders of one user are added and cancelled as a whole, readers must never see a part of one
+    const int kBatch = 10;
+    const int kBatches = 400;
+    SharedOrderCache cache(segmentName("concurrent"), { 1024, 1024 });
+    std::atomic<bool> done { false };
+
+    std::vector<std::thread> readers;
+    std::atomic<int> reads { 0 };
+    for (int r = 0; r < 3; ++r) {
+        readers.emplace_back([&] {
+            SharedOrderCacheReader reader(cache.name());
+            while (!done) {
+                std::map<std::string, int> users;
+                for (const auto& order : reader.getAllOrders()) {
+                    // every field follows from the orderId, a torn order wouldn't
+                    const int id = std::stoi(order.orderId().substr(5));
+                    EXPECT_EQ(order.securityId(), "SecId" + std::to_string(id % 3));
+                    EXPECT_EQ(order.user(), "User" + std::to_string(id / kBatch));
+                    EXPECT_EQ(order.qty(), static_cast<unsigned int>(id % 100 + 1));
+                    ++users[order.user()];
+                }
+                for (const auto& [user, count] : users) {
+                    EXPECT_EQ(count, kBatch) << user;
+                }
+                reader.getMatchingSizeForSecurity("SecId1");
+                ++reads;
+            }
+        });
+    }
+
+    for (int batch = 0; batch < kBatches; ++batch) {
+        std::vector<Order> orders;
+        for (int id = batch * kBatch; id < (batch + 1) * kBatch; ++id) {
+            orders.push_back({ "OrdId" + std::to_string(id), "SecId" + std::to_string(id % 3), id % 2 ? "Buy" : "Sell",
+                static_cast<unsigned int>(id % 100 + 1), "User" + std::to_string(batch), "Company" + std::to_string(id % 4) });
+        }
+        cache.addOrders(orders);
+        if (batch >= 20) {
+            cache.cancelOrdersForUser("User" + std::to_string(batch - 20));
+        }
+    }
+    // give slow readers a chance to finish a read or two
+    while (reads < 10) {
+        std::this_thread::yield();
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(cache.getAllOrders().size(), 20 * kBatch);
+}
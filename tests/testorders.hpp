@@ -0,0 +1,90 @@
+#ifndef TESTS_TESTORDERS_HPP
+#define TESTS_TESTORDERS_HPP
+
+#include <gtest/gtest.h>
+
+#include "../basicordercache.hpp"
+#include "../ordercacheimpl.hpp"
+#include "../shardedordercache.hpp"
+
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
+
+// Orders and caches the tests of the cache types share.
+namespace testorders {
+
+// Names are drawn out of pools of the given sizes, "SecId0" to "SecId<securities - 1>" and so on, quantities out of
+// [minQty, minQty + qtys).
+struct OrderPools {
+    unsigned int securities;
+    unsigned int users;
+    unsigned int companies;
+    unsigned int minQty;
+    unsigned int qtys;
+};
+
+// draw(n) picks a value in [0, n), the fields are drawn in the order of the Order constructor
+template <typename Draw>
+Order makeOrder(int id, const OrderPools& pools, Draw draw)
+{
+    return { "OrdId" + std::to_string(id), "SecId" + std::to_string(draw(pools.securities)), draw(2) ? "Buy" : "Sell",
+        pools.minQty + draw(pools.qtys), "User" + std::to_string(draw(pools.users)), "Company" + std::to_string(draw(pools.companies)) };
+}
+
+inline Order randomOrder(std::mt19937& rng, int id, const OrderPools& pools)
+{
+    return makeOrder(id, pools, [&rng](unsigned int n) { return static_cast<unsigned int>(rng() % n); });
+}
+
+// every field cycles through its pool with the id, so tests can tell which orders share a field
+inline Order cyclicOrder(int id, const OrderPools& pools)
+{
+    return makeOrder(id, pools, [id](unsigned int n) { return static_cast<unsigned int>(id) % n; });
+}
+
+// sharded caches get a few shards, so the orders of a test are spread over more than one book
+template <typename Cache>
+std::unique_ptr<Cache> makeCache()
+{
+    return std::make_unique<Cache>();
+}
+
+template <>
+inline std::unique_ptr<ShardedOrderCache> makeCache<ShardedOrderCache>()
+{
+    return std::make_unique<ShardedOrderCache>(4);
+}
+
+// Typed tests run against every cache type. Tests of what BacktestOrderCache leaves out (snapshot files, change feeds,
+// bulk matching sizes, memory usage) run against the thread safe ones only.
+using CacheTypes = ::testing::Types<OrderCacheImpl, ShardedOrderCache, BacktestOrderCache>;
+using ThreadSafeCacheTypes = ::testing::Types<OrderCacheImpl, ShardedOrderCache>;
+
+struct CacheTypeNames {
+    template <typename Cache>
+    static std::string GetName(int)
+    {
+        if (std::is_same_v<Cache, OrderCacheImpl>) {
+            return "OrderCacheImpl";
+        }
+        if (std::is_same_v<Cache, ShardedOrderCache>) {
+            return "ShardedOrderCache";
+        }
+        return "BacktestOrderCache";
+    }
+};
+
+// fixture of the typed tests, every test starts with an empty cache
+template <typename Cache>
+class CacheTest : public ::testing::Test {
+protected:
+    Cache& cache() { return *m_cache; }
+
+    std::unique_ptr<Cache> m_cache { makeCache<Cache>() };
+};
+
+} // namespace testorders
+
+#endif // TESTS_TESTORDERS_HPP
@@ -0,0 +1,329 @@
+#include <gtest/gtest.h>
+
+#include "../timingwheel.hpp"
+#include "testorders.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+using namespace std::chrono_literals;
+
+TEST(TimingWheelTests, Advance_SameAsReference_Succeeds)
+{
+    std::mt19937_64 rng { 21 };
+    TimingWheel wheel;
+    // id -> <deadline, timer>
+    std::map<uint32_t, std::pair<uint64_t, uint32_t>> scheduled;
+    uint32_t nextId = 0;
+    uint64_t now = 0;
+    std::vector<uint32_t> expired;
+    for (int round = 0; round < 20000; ++round) {
+        switch (rng() % 4) {
+        case 0:
+        case 1: {
+            // near, far and very far deadlines, some of them already due
+            const uint64_t horizon = uint64_t(1) << (rng() % 4 * 16);
+            const uint64_t deadline = now + rng() % horizon - (rng() % 8 == 0 ? std::min<uint64_t>(now, 5) : 0);
+            scheduled[nextId] = { deadline, wheel.insert(nextId, deadline) };
+            ++nextId;
+            break;
+        }
+        case 2:
+            if (!scheduled.empty()) {
+                auto it = scheduled.lower_bound(static_cast<uint32_t>(rng() % nextId));
+                if (it != scheduled.end()) {
+                    wheel.cancel(it->second.second);
+                    scheduled.erase(it);
+                }
+            }
+            break;
+        default: {
+            now += rng() % 3 == 0 ? rng() % (uint64_t(1) << (rng() % 40)) : rng() % 100;
+            expired.clear();
+            wheel.advance(now, expired);
+            std::sort(expired.begin(), expired.end());
+            std::vector<uint32_t> expected;
+            for (auto it = scheduled.begin(); it != scheduled.end();) {
+                if (it->second.first <= now) {
+                    expected.push_back(it->first);
+                    it = scheduled.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            ASSERT_EQ(expired, expected) << "round " << round;
+            break;
+        }
+        }
+        ASSERT_EQ(wheel.size(), scheduled.size());
+    }
+    EXPECT_EQ(wheel.now(), now);
+
+    // the rest expires at the end of time
+    expired.clear();
+    wheel.advance(static_cast<uint64_t>(-1), expired);
+    EXPECT_EQ(expired.size(), scheduled.size());
+    EXPECT_EQ(wheel.size(), 0);
+    const size_t bytes = wheel.memoryBytes();
+    wheel.shrink();
+    EXPECT_LT(wheel.memoryBytes(), bytes);
+}
+
+namespace {
+
+const expiry::Clock::time_point kStart = expiry::Clock::time_point() + 1000h;
+
+std::set<std::string> orderIds(const std::vector<Order>& orders)
+{
+    std::set<std::string> out;
+    for (const auto& order : orders) {
+        out.insert(order.orderId());
+    }
+    return out;
+}
+
+// writes past the current size of the file fail with EFBIG while it lives
+class FileSizeLimit {
+public:
+    explicit FileSizeLimit(const std::string& path)
+        : m_handler(std::signal(SIGXFSZ, SIG_IGN))
+    {
+        struct stat status {};
+        ::stat(path.c_str(), &status);
+        ::getrlimit(RLIMIT_FSIZE, &m_limit);
+        const rlimit limit { static_cast<rlim_t>(status.st_size), m_limit.rlim_max };
+        ::setrlimit(RLIMIT_FSIZE, &limit);
+    }
+
+    ~FileSizeLimit()
+    {
+        ::setrlimit(RLIMIT_FSIZE, &m_limit);
+        std::signal(SIGXFSZ, m_handler);
+    }
+
+    FileSizeLimit(const FileSizeLimit&) = delete;
+    FileSizeLimit& operator=(const FileSizeLimit&) = delete;
+
+private:
+    rlimit m_limit {};
+    void (*m_handler)(int);
+};
+
+template <typename Cache>
+class OrderExpiryCacheTests : public testorders::CacheTest<Cache> {
+};
+
+template <typename Cache>
+class OrderExpirySnapshotTests : public testorders::CacheTest<Cache> {
+};
+
+} // namespace
+
+TYPED_TEST_SUITE(OrderExpiryCacheTests, testorders::CacheTypes, testorders::CacheTypeNames);
+TYPED_TEST_SUITE(OrderExpirySnapshotTests, testorders::ThreadSafeCacheTypes, testorders::CacheTypeNames);
+
+// orders expire by the caller's clock, cancelled ones and matched ones leave the wheel with them
+TYPED_TEST(OrderExpiryCacheTests, OrdersExpire_Succeeds)
+{
+    auto& cache = this->cache();
+    std::mt19937 rng { 4 };
+    // orderId -> expiry in ms after kStart
+    std::map<std::string, int> expiries;
+    for (int i = 0; i < 3000; ++i) {
+        const Order order = testorders::randomOrder(rng, i, { 6, 4, 3, 1, 500 });
+        if (i % 3 == 0) {
+            cache.addOrder(order);
+        } else {
+            const int ms = static_cast<int>(rng() % 10000);
+            cache.addOrder(order, kStart + std::chrono::milliseconds(ms));
+            expiries[order.orderId()] = ms;
+        }
+        if (i % 4 == 0) {
+            cache.cancelOrder("OrdId" + std::to_string(rng() % (i + 1)));
+        }
+    }
+    cache.cancelOrdersForUser("User1");
+    cache.getMatchingSizeForSecurity2("SecId2");
+
+    std::set<std::string> live = orderIds(cache.getAllOrders());
+    for (int ms = 0; ms <= 10500; ms += 700) {
+        std::set<std::string> expected;
+        for (const auto& [orderId, expiry] : expiries) {
+            if (expiry <= ms && live.count(orderId)) {
+                expected.insert(orderId);
+            }
+        }
+        const auto removed = cache.tick(kStart + std::chrono::milliseconds(ms));
+        EXPECT_EQ(std::set<std::string>(removed.begin(), removed.end()), expected) << ms;
+        EXPECT_EQ(removed.size(), expected.size());
+        for (const auto& orderId : expected) {
+            live.erase(orderId);
+        }
+        EXPECT_EQ(orderIds(cache.getAllOrders()), live);
+    }
+    // what is left never expires, the expired orderIds can be used again
+    EXPECT_TRUE(cache.tick(kStart + 100000h).empty());
+    for (const auto& orderId : live) {
+        EXPECT_FALSE(expiries.count(orderId)) << orderId;
+    }
+    cache.addOrder({ expiries.begin()->first, "SecId1", "Buy", 100, "User1", "Company1" });
+    EXPECT_EQ(cache.getAllOrders().size(), live.size() + 1);
+}
+
+TEST(OrderExpiryTests, Compaction_MovesTimersAlong_Succeeds)
+{
+    OrderCacheImpl cache;
+    cache.setCompactionThreshold(0);
+    for (size_t i = 0; i < 3 * OrderStore::kSegmentSlots; ++i) {
+        cache.addOrder({ "OrdId" + std::to_string(i), "SecId1", "Buy", 100, "User" + std::to_string(i % 2), "Company1" },
+            kStart + std::chrono::milliseconds(i));
+    }
+    // holes all over the store, compaction moves the orders of User1 from the end into them
+    cache.cancelOrdersForUser("User0");
+    cache.compact();
+    EXPECT_EQ(cache.memoryUsage().capacity, cache.getAllOrders().size());
+
+    const auto removed = cache.tick(kStart + 99ms);
+    std::set<std::string> expected;
+    for (int i = 1; i <= 99; i += 2) {
+        expected.insert("OrdId" + std::to_string(i));
+    }
+    EXPECT_EQ(std::set<std::string>(removed.begin(), removed.end()), expected);
+    EXPECT_EQ(cache.getAllOrders().size(), 3 * OrderStore::kSegmentSlots / 2 - 50);
+    cache.shrink();
+    EXPECT_EQ(cache.tick(kStart + 1h).size(), 3 * OrderStore::kSegmentSlots / 2 - 50);
+    EXPECT_TRUE(cache.getAllOrders().empty());
+}
+
+TEST(OrderExpiryTests, StartExpiry_BackgroundThreadExpiresOrders_Succeeds)
+{
+    OrderCacheImpl cache;
+    cache.startExpiry(1ms);
+    cache.addOrder({ "OrdId1", "SecId1", "Buy", 100, "User1", "Company1" }, expiry::Clock::now() + 20ms);
+    cache.addOrder({ "OrdId2", "SecId1", "Sell", 100, "User1", "Company2" });
+    const auto deadline = expiry::Clock::now() + 10s;
+    while (cache.getAllOrders().size() > 1 && expiry::Clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_EQ(cache.getAllOrders().size(), 1);
+    EXPECT_EQ(cache.getAllOrders()[0].orderId(), "OrdId2");
+
+    cache.stopExpiry();
+    cache.addOrder({ "OrdId3", "SecId1", "Buy", 100, "User1", "Company1" }, expiry::Clock::now());
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(cache.getAllOrders().size(), 2);
+    EXPECT_EQ(cache.tick(expiry::Clock::now()), std::vector<std::string> { "OrdId3" });
+}
+
+TEST(OrderExpiryTests, Recover_JournaledExpiriesSurviveRestart_Succeeds)
+{
+    const std::string snapshotPath = ::testing::TempDir() + "timingwheel_ut_expiry.snapshot";
+    const std::string journalPath = ::testing::TempDir() + "timingwheel_ut_expiry.journal";
+    std::remove(snapshotPath.c_str());
+    std::remove(journalPath.c_str());
+    std::set<std::string> expected;
+    {
+        OrderCacheImpl cache;
+        cache.startJournal(journalPath);
+        for (int i = 0; i < 100; ++i) {
+            cache.addOrder({ "OrdId" + std::to_string(i), "SecId1", i % 2 ? "Buy" : "Sell", 100, "User1", "Company1" },
+                kStart + std::chrono::milliseconds(i));
+            // half of the deadlines come from the snapshot, the other half from the journal
+            if (i == 59) {
+                cache.checkpoint(snapshotPath);
+            }
+        }
+        cache.addOrder({ "OrdId100", "SecId1", "Buy", 100, "User1", "Company1" });
+        EXPECT_EQ(cache.tick(kStart + 49ms).size(), 50);
+        expected = orderIds(cache.getAllOrders());
+    }
+
+    OrderCacheImpl recovered;
+    recovered.recover(snapshotPath, journalPath);
+    EXPECT_EQ(orderIds(recovered.getAllOrders()), expected);
+    // what expired before the restart was journaled as cancels, the rest expires on time
+    const auto removed = recovered.tick(kStart + 74ms);
+    EXPECT_EQ(removed.size(), 25);
+    EXPECT_EQ(std::set<std::string>(removed.begin(), removed.end()).count("OrdId74"), 1);
+    // the restart took longer than the remaining deadlines, they are all due on the first tick
+    EXPECT_EQ(recovered.tick(kStart + 1h).size(), 25);
+    EXPECT_EQ(orderIds(recovered.getAllOrders()), std::set<std::string> { "OrdId100" });
+    std::remove(snapshotPath.c_str());
+    std::remove(journalPath.c_str());
+}
+
+TEST(OrderExpiryTests, Tick_JournalWriteFails_Throws)
+{
+    const std::string journalPath = ::testing::TempDir() + "timingwheel_ut_failing.journal";
+    std::remove(journalPath.c_str());
+    OrderCacheImpl cache;
+    cache.startJournal(journalPath);
+    for (int i = 0; i < 4; ++i) {
+        cache.addOrder({ "OrdId" + std::to_string(i), "SecId1", "Buy", 100, "User1", "Company1" },
+            kStart + std::chrono::milliseconds(i));
+    }
+    {
+        const FileSizeLimit limit(journalPath);
+        // the cancels are journaled but can't be written
+        EXPECT_THROW(cache.tick(kStart + 1ms), std::system_error);
+        EXPECT_EQ(orderIds(cache.getAllOrders()), (std::set<std::string> { "OrdId2", "OrdId3" }));
+        // the journal is broken from then on, orders whose cancel can't be journaled stay in the book
+        EXPECT_THROW(cache.tick(kStart + 1h), std::system_error);
+        EXPECT_EQ(orderIds(cache.getAllOrders()), (std::set<std::string> { "OrdId2", "OrdId3" }));
+
+        // the expiry thread stops on the error instead of terminating the process, stopExpiry() rethrows it once
+        bool rethrown = false;
+        const auto deadline = expiry::Clock::now() + 10s;
+        while (!rethrown && expiry::Clock::now() < deadline) {
+            cache.startExpiry(1ms);
+            std::this_thread::sleep_for(5ms);
+            try {
+                cache.stopExpiry();
+            } catch (const std::system_error&) {
+                rethrown = true;
+            }
+        }
+        EXPECT_TRUE(rethrown);
+        EXPECT_NO_THROW(cache.stopExpiry());
+        EXPECT_EQ(orderIds(cache.getAllOrders()), (std::set<std::string> { "OrdId2", "OrdId3" }));
+    }
+    std::remove(journalPath.c_str());
+}
+
+TYPED_TEST(OrderExpirySnapshotTests, LoadSnapshot_SchedulesExpiriesAgain_Succeeds)
+{
+    const std::string path = ::testing::TempDir() + "timingwheel_ut_load.snapshot";
+    auto& cache = this->cache();
+    for (int i = 0; i < 100; ++i) {
+        const Order order { "OrdId" + std::to_string(i), "SecId" + std::to_string(i % 7), "Buy", 100, "User1", "Company1" };
+        if (i % 2) {
+            cache.addOrder(order);
+        } else {
+            cache.addOrder(order, kStart + std::chrono::milliseconds(i));
+        }
+    }
+    EXPECT_EQ(cache.tick(kStart + 9ms).size(), 5);
+
+    auto loaded = testorders::makeCache<TypeParam>();
+    cache.saveSnapshot(path);
+    loaded->loadSnapshot(path);
+    std::remove(path.c_str());
+    for (auto* expiring : { loaded.get(), &cache }) {
+        EXPECT_EQ(expiring->tick(kStart + 49ms).size(), 20);
+        EXPECT_EQ(expiring->tick(kStart + 1h).size(), 25);
+        EXPECT_EQ(expiring->getAllOrders().size(), 50);
+    }
+    EXPECT_EQ(orderIds(loaded->getAllOrders()), orderIds(cache.getAllOrders()));
+}
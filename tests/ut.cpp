@@ -1,8 +1,22 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <memory>
+#include <random>
+#include <shared_mutex>
+#include <system_error>
+#include <thread>
+#include <type_traits>
 
+#include <unistd.h>
+
+#include "../asyncordercache.hpp"
+#include "../basicordercache.hpp"
 #include "../ordercacheimpl.hpp"
+#include "../shardedordercache.hpp"
+#include "../sharedordercache.hpp"
+#include "testorders.hpp"
 
 std::ostream& operator<<(std::ostream& os, const Order& order)
 {
@@ -15,18 +29,41 @@ bool operator==(const Order& lhr, const Order& rhr)
     return lhr.company() == rhr.company() && lhr.orderId() == rhr.orderId() && lhr.qty() == rhr.qty() && lhr.securityId() == rhr.securityId() && lhr.side() == rhr.side() && lhr.user() == rhr.user();
 }
 
-class OrderCacheInterfaceTests : public ::testing::Test {
+// every OrderCacheInterface implementation has to pass the same tests
+struct OrderCacheFactory {
+    const char* name;
+    std::unique_ptr<OrderCacheInterface> (*make)();
+    // caches built for a single thread skip the concurrent tests
+    bool threadSafe { true };
+};
+
+class OrderCacheInterfaceTests : public ::testing::TestWithParam<OrderCacheFactory> {
 
 protected:
     void SetUp() override
     {
-        m_orderCacheInterfacePtr = std::make_unique<OrderCacheImpl>();
+        m_orderCacheInterfacePtr = GetParam().make();
     }
 
     std::unique_ptr<OrderCacheInterface> m_orderCacheInterfacePtr;
 };
 
-TEST_F(OrderCacheInterfaceTests, AddOrder_Succeeds)
+INSTANTIATE_TEST_SUITE_P(Implementations, OrderCacheInterfaceTests,
+    ::testing::Values(
+        OrderCacheFactory { "OrderCacheImpl", []() -> std::unique_ptr<OrderCacheInterface> { return std::make_unique<OrderCacheImpl>(); } },
+        OrderCacheFactory { "ShardedOrderCache", []() -> std::unique_ptr<OrderCacheInterface> { return std::make_unique<ShardedOrderCache>(); } },
+        OrderCacheFactory { "AsyncOrderCache", []() -> std::unique_ptr<OrderCacheInterface> { return std::make_unique<AsyncOrderCache>(); } },
+        OrderCacheFactory { "BacktestOrderCache", []() -> std::unique_ptr<OrderCacheInterface> { return std::make_unique<OrderCacheAdapter<BacktestOrderCache>>(); }, false },
+        OrderCacheFactory { "LockedOrderCache", []() -> std::unique_ptr<OrderCacheInterface> { return std::make_unique<OrderCacheAdapter<LockedOrderCache>>(); } },
+        OrderCacheFactory { "SharedOrderCache", []() -> std::unique_ptr<OrderCacheInterface> {
+            // a segment per test, named after the process so parallel runs don't collide
+            static int segments = 0;
+            return std::make_unique<SharedOrderCache>("/ordercache_ut." + std::to_string(::getpid()) + "." + std::to_string(segments++),
+                SharedOrderCache::Limits { 1 << 16, 1 << 12 });
+        } }),
+    [](const auto& info) { return std::string(info.param.name); });
+
+TEST_P(OrderCacheInterfaceTests, AddOrder_Succeeds)
 {
     const Order order { "OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA" };
     m_orderCacheInterfacePtr->addOrder(order);
@@ -35,9 +72,49 @@ TEST_F(OrderCacheInterfaceTests, AddOrder_Succeeds)
     EXPECT_EQ(orders[0], order);
 }
 
-// add test for AddOrder_Fails when trying to add two orders with the same orderId
+TEST_P(OrderCacheInterfaceTests, GetAllOrders_ReturnsOrdersAsAdded_Succeeds)
+{
+    const std::vector<Order> added {
+        { "OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA" },
+        { "OrdId2", "SecId2", "Sell", 300, "User1", "CompanyB" },
+        { "OrdId3", "SecId1", "Sell", 700, "User2", "CompanyA" },
+        { "OrdId4", "SecId3", "Buy", 0, "User3", "CompanyC" },
+    };
+    for (const auto& order : added) {
+        m_orderCacheInterfacePtr->addOrder(order);
+    }
+    m_orderCacheInterfacePtr->cancelOrder("OrdId2");
+    m_orderCacheInterfacePtr->addOrder({ "OrdId5", "SecId2", "Sell", 300, "User4", "CompanyB" });
+
+    auto orders { m_orderCacheInterfacePtr->getAllOrders() };
+    EXPECT_EQ(orders.size(), 4);
+    for (const auto& order : { added[0], added[2], added[3], Order { "OrdId5", "SecId2", "Sell", 300, "User4", "CompanyB" } }) {
+        EXPECT_EQ(std::count(orders.begin(), orders.end(), order), 1);
+    }
+}
+
+TEST_P(OrderCacheInterfaceTests, AddOrder_DuplicatedOrderId_Fails)
+{
+    const Order order { "OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA" };
+    m_orderCacheInterfacePtr->addOrder(order);
+    m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId2", "Sell", 500, "User2", "CompanyB" });
+    auto orders { m_orderCacheInterfacePtr->getAllOrders() };
+    EXPECT_EQ(orders.size(), 1);
+    EXPECT_EQ(orders[0], order);
+}
+
+TEST_P(OrderCacheInterfaceTests, AddOrder_CancelledOrderIdCanBeReused_Succeeds)
+{
+    const Order order { "OrdId1", "SecId2", "Sell", 500, "User2", "CompanyB" };
+    m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA" });
+    m_orderCacheInterfacePtr->cancelOrder("OrdId1");
+    m_orderCacheInterfacePtr->addOrder(order);
+    auto orders { m_orderCacheInterfacePtr->getAllOrders() };
+    EXPECT_EQ(orders.size(), 1);
+    EXPECT_EQ(orders[0], order);
+}
 
-TEST_F(OrderCacheInterfaceTests, CancelOrder_SingleOrderList_Succeeds)
+TEST_P(OrderCacheInterfaceTests, CancelOrder_SingleOrderList_Succeeds)
 {
     static const std::string orderId { "OrdId1" };
     m_orderCacheInterfacePtr->addOrder({ orderId, "SecId1", "Buy", 1000, "User1", "CompanyA" });
@@ -48,7 +125,7 @@ TEST_F(OrderCacheInterfaceTests, CancelOrder_SingleOrderList_Succeeds)
     EXPECT_EQ(orders.size(), 0);
 }
 
-TEST_F(OrderCacheInterfaceTests, CancelOrder_MultiOrderList_Succeeds)
+TEST_P(OrderCacheInterfaceTests, CancelOrder_MultiOrderList_Succeeds)
 {
     const std::string orderId { "OrdId2" }; // static?
     m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA" });
@@ -64,7 +141,14 @@ TEST_F(OrderCacheInterfaceTests, CancelOrder_MultiOrderList_Succeeds)
     }
 }
 
-TEST_F(OrderCacheInterfaceTests, CancelOrdersForUser_SingleOrderList_Succeeds)
+TEST_P(OrderCacheInterfaceTests, CancelOrder_UnknownOrderId_Succeeds)
+{
+    m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA" });
+    m_orderCacheInterfacePtr->cancelOrder("OrdId2");
+    EXPECT_EQ(m_orderCacheInterfacePtr->getAllOrders().size(), 1);
+}
+
+TEST_P(OrderCacheInterfaceTests, CancelOrdersForUser_SingleOrderList_Succeeds)
 {
     static const std::string user { "User1" };
     m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId1", "Buy", 1000, user, "CompanyA" });
@@ -75,7 +159,7 @@ TEST_F(OrderCacheInterfaceTests, CancelOrdersForUser_SingleOrderList_Succeeds)
     EXPECT_EQ(orders.size(), 0);
 }
 
-TEST_F(OrderCacheInterfaceTests, CancelOrdersForUser_ManyOrdersOneUser_Succeeds)
+TEST_P(OrderCacheInterfaceTests, CancelOrdersForUser_ManyOrdersOneUser_Succeeds)
 {
     static const std::string user { "User1" };
     m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId1", "Buy", 1000, user, "CompanyA" });
@@ -89,7 +173,7 @@ TEST_F(OrderCacheInterfaceTests, CancelOrdersForUser_ManyOrdersOneUser_Succeeds)
     EXPECT_EQ(orders.size(), 0);
 }
 
-TEST_F(OrderCacheInterfaceTests, CancelOrdersForUser_ManyOrdersFromManyUsers_Succeeds)
+TEST_P(OrderCacheInterfaceTests, CancelOrdersForUser_ManyOrdersFromManyUsers_Succeeds)
 {
     static const std::string user { "User2" };
     m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId1", "Buy", 1000, user, "CompanyA" });
@@ -110,7 +194,7 @@ TEST_F(OrderCacheInterfaceTests, CancelOrdersForUser_ManyOrdersFromManyUsers_Suc
     }
 }
 
-TEST_F(OrderCacheInterfaceTests, CancelOrdersForSecIdWithMinimumQty_SingleOrderList_Succeeds)
+TEST_P(OrderCacheInterfaceTests, CancelOrdersForSecIdWithMinimumQty_SingleOrderList_Succeeds)
 {
     static const std::string secId { "SecId1" };
     m_orderCacheInterfacePtr->addOrder({ "OrdId1", secId, "Buy", 1000, "User1", "CompanyA" });
@@ -121,11 +205,11 @@ TEST_F(OrderCacheInterfaceTests, CancelOrdersForSecIdWithMinimumQty_SingleOrderL
     EXPECT_EQ(orders.size(), 0);
 }
 
-TEST_F(OrderCacheInterfaceTests, CancelOrdersForSecIdWithMinimumQty_TwoOrdersDifferentSecIdsOnList_Succeeds)
+TEST_P(OrderCacheInterfaceTests, CancelOrdersForSecIdWithMinimumQty_TwoOrdersDifferentSecIdsOnList_Succeeds)
 {
     static const std::string secId { "SecId1" };
     m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId0", "Buy", 1000, "User1", "CompanyA" });
-    m_orderCacheInterfacePtr->addOrder({ "OrdId1", secId, "Buy", 1000, "User1", "CompanyA" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId2", secId, "Buy", 1000, "User1", "CompanyA" });
     auto orders { m_orderCacheInterfacePtr->getAllOrders() };
     EXPECT_EQ(orders.size(), 2);
     m_orderCacheInterfacePtr->cancelOrdersForSecIdWithMinimumQty(secId, 1000);
@@ -134,25 +218,43 @@ TEST_F(OrderCacheInterfaceTests, CancelOrdersForSecIdWithMinimumQty_TwoOrdersDif
     EXPECT_TRUE(orders[0].securityId() != secId);
 }
 
-TEST_F(OrderCacheInterfaceTests, CancelOrdersForSecIdWithMinimumQty_MultipleOrdersList_Succeeds)
+TEST_P(OrderCacheInterfaceTests, CancelOrdersForSecIdWithMinimumQty_MultipleOrdersList_Succeeds)
 {
     static const std::string secId { "SecId1" };
     m_orderCacheInterfacePtr->addOrder({ "OrdId1", secId, "Buy", 1000, "User1", "CompanyA" });
-    m_orderCacheInterfacePtr->addOrder({ "OrdId1", secId, "Buy", 3000, "User1", "CompanyA" });
-    m_orderCacheInterfacePtr->addOrder({ "OrdId1", secId, "Buy", 100, "User1", "CompanyA" });
-    m_orderCacheInterfacePtr->addOrder({ "OrdId1", secId, "Buy", 500, "User1", "CompanyA" });
-    m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId2", "Buy", 3000, "User1", "CompanyA" });
-    m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId3", "Buy", 2000, "User1", "CompanyA" });
-    m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId4", "Buy", 4000, "User1", "CompanyA" });
-    m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId5", "Buy", 5000, "User1", "CompanyA" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId2", secId, "Buy", 3000, "User1", "CompanyA" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId3", secId, "Buy", 100, "User1", "CompanyA" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId4", secId, "Buy", 500, "User1", "CompanyA" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId5", "SecId2", "Buy", 3000, "User1", "CompanyA" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId6", "SecId3", "Buy", 2000, "User1", "CompanyA" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId7", "SecId4", "Buy", 4000, "User1", "CompanyA" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId8", "SecId5", "Buy", 5000, "User1", "CompanyA" });
     auto orders { m_orderCacheInterfacePtr->getAllOrders() };
     EXPECT_EQ(orders.size(), 8);
     m_orderCacheInterfacePtr->cancelOrdersForSecIdWithMinimumQty(secId, 1000);
     orders = m_orderCacheInterfacePtr->getAllOrders();
     EXPECT_EQ(orders.size(), 6);
+    for (auto& order : orders) {
+        EXPECT_TRUE(order.securityId() != secId || order.qty() < 1000);
+    }
 }
 
-TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_OneBuyOneSellOrdersSingleSecurity_Success)
+TEST_P(OrderCacheInterfaceTests, CancelOrdersForSecIdWithMinimumQty_SmallSecurityInBigBook_Succeeds)
+{
+    // a security holding a small part of the book is cancelled through its posting list rather than a column sweep
+    static const std::string secId { "SecId1" };
+    for (int i = 0; i < 100; ++i) {
+        m_orderCacheInterfacePtr->addOrder({ "OrdId" + std::to_string(i), "SecId" + std::to_string(2 + i % 4), "Buy", 1000, "User1", "CompanyA" });
+    }
+    m_orderCacheInterfacePtr->addOrder({ "OrdId100", secId, "Sell", 1000, "User1", "CompanyA" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId101", secId, "Sell", 999, "User1", "CompanyA" });
+    m_orderCacheInterfacePtr->cancelOrdersForSecIdWithMinimumQty(secId, 1000);
+    auto orders { m_orderCacheInterfacePtr->getAllOrders() };
+    EXPECT_EQ(orders.size(), 101);
+    EXPECT_EQ(std::count_if(orders.begin(), orders.end(), [](const Order& order) { return order.orderId() == "OrdId101"; }), 1);
+}
+
+TEST_P(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_OneBuyOneSellOrdersSingleSecurity_Success)
 {
     static const std::string secId { "SecId1" };
     m_orderCacheInterfacePtr->addOrder({ "OrdId1", secId, "Sell", 1000, "User1", "CompanyA" });
@@ -160,7 +262,7 @@ TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_OneBuyOneSellOrdersS
     EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity(secId), 1000);
 }
 
-TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_ExampleFromReadMe_Success)
+TEST_P(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_ExampleFromReadMe_Success)
 {
     // OrdId1 SecId1 Buy  1000 User1 CompanyA
     m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA" });
@@ -184,7 +286,7 @@ TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_ExampleFromReadMe_Su
     EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity("SecId3"), 0);
 }
 
-TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_Example1FromReadMe_Success)
+TEST_P(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_Example1FromReadMe_Success)
 {
     // OrdId1 SecId1 Sell 100 User10 Company2
     m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId1", "Sell", 100, "User10", "Company2" });
@@ -218,7 +320,7 @@ TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_Example1FromReadMe_S
     EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity("SecId3"), 600);
 }
 
-TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_Example2FromReadMe_Success)
+TEST_P(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_Example2FromReadMe_Success)
 {
 
     //                                 OrdId1 SecId3 Sell 100 User1 Company1
@@ -249,8 +351,47 @@ TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_Example2FromReadMe_S
     EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity("SecId3"), 0);
 }
 
+TEST_P(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_DoesNotChangeOrders_Success)
+{
+    static const std::string secId { "SecId1" };
+    m_orderCacheInterfacePtr->addOrder({ "OrdId1", secId, "Sell", 1000, "User1", "CompanyA" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId2", secId, "Buy", 600, "User2", "CompanyB" });
+    const auto orders { m_orderCacheInterfacePtr->getAllOrders() };
+    EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity(secId), 600);
+    EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity(secId), 600);
+    EXPECT_EQ(m_orderCacheInterfacePtr->getAllOrders(), orders);
+}
+
+TEST_P(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_AfterCancels_Success)
+{
+    static const std::string secId { "SecId1" };
+    m_orderCacheInterfacePtr->addOrder({ "OrdId1", secId, "Sell", 1000, "User1", "CompanyA" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId2", secId, "Buy", 600, "User2", "CompanyB" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId3", secId, "Buy", 300, "User3", "CompanyC" });
+    EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity(secId), 900);
+    m_orderCacheInterfacePtr->cancelOrder("OrdId2");
+    EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity(secId), 300);
+    m_orderCacheInterfacePtr->cancelOrdersForSecIdWithMinimumQty(secId, 1000);
+    EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity(secId), 0);
+    m_orderCacheInterfacePtr->addOrder({ "OrdId4", secId, "Sell", 100, "User1", "CompanyA" });
+    EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity(secId), 100);
+    m_orderCacheInterfacePtr->cancelOrdersForUser("User3");
+    EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity(secId), 0);
+}
+
+TEST_P(OrderCacheInterfaceTests, GetMatchingSizeForSecurity_OrderOfOrdersDoesNotMatter_Success)
+{
+    // matching the CompanyC sell with the CompanyB buy first would leave CompanyA orders without a counterparty
+    static const std::string secId { "SecId1" };
+    m_orderCacheInterfacePtr->addOrder({ "OrdId1", secId, "Sell", 100, "User1", "CompanyC" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId2", secId, "Sell", 100, "User2", "CompanyA" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId3", secId, "Buy", 100, "User3", "CompanyB" });
+    m_orderCacheInterfacePtr->addOrder({ "OrdId4", secId, "Buy", 100, "User4", "CompanyA" });
+    EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity(secId), 200);
+}
+
 //
-TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity2_OneBuyOneSellOrdersSingleSecurity_Success)
+TEST_P(OrderCacheInterfaceTests, GetMatchingSizeForSecurity2_OneBuyOneSellOrdersSingleSecurity_Success)
 {
     static const std::string secId { "SecId1" };
     m_orderCacheInterfacePtr->addOrder({ "OrdId1", secId, "Sell", 1000, "User1", "CompanyA" });
@@ -260,7 +401,7 @@ TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity2_OneBuyOneSellOrders
     EXPECT_EQ(m_orderCacheInterfacePtr->getAllOrders().size(), 0);
 }
 
-TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity2_ExampleFromReadMe_Success)
+TEST_P(OrderCacheInterfaceTests, GetMatchingSizeForSecurity2_ExampleFromReadMe_Success)
 {
     // OrdId1 SecId1 Buy  1000 User1 CompanyA
     m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA" });
@@ -286,7 +427,7 @@ TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity2_ExampleFromReadMe_S
     EXPECT_EQ(m_orderCacheInterfacePtr->getAllOrders().size(), 5);
 }
 
-TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity2_Example1FromReadMe_Success)
+TEST_P(OrderCacheInterfaceTests, GetMatchingSizeForSecurity2_Example1FromReadMe_Success)
 {
     // OrdId1 SecId1 Sell 100 User10 Company2
     m_orderCacheInterfacePtr->addOrder({ "OrdId1", "SecId1", "Sell", 100, "User10", "Company2" });
@@ -320,7 +461,7 @@ TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity2_Example1FromReadMe_
     EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity2("SecId3"), 600);
 }
 
-TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity2_Example2FromReadMe_Success)
+TEST_P(OrderCacheInterfaceTests, GetMatchingSizeForSecurity2_Example2FromReadMe_Success)
 {
 
     //                                 OrdId1 SecId3 Sell 100 User1 Company1
@@ -350,3 +491,551 @@ TEST_F(OrderCacheInterfaceTests, GetMatchingSizeForSecurity2_Example2FromReadMe_
     EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity2("SecId2"), 600);
     EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity2("SecId3"), 0);
 }
+
+TEST_P(OrderCacheInterfaceTests, ConcurrentAddsAndCancels_Succeeds)
+{
+    if (!GetParam().threadSafe) {
+        GTEST_SKIP() << "not thread safe";
+    }
+    static constexpr int threadsCount = 4;
+    static constexpr int ordersPerThread = 1000;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadsCount; ++t) {
+        threads.emplace_back([this, t] {
+            const std::string user { "User" + std::to_string(t) };
+            for (int i = 0; i < ordersPerThread; ++i) {
+                m_orderCacheInterfacePtr->addOrder({ user + "_OrdId" + std::to_string(i), user + "_SecId" + std::to_string(i % 4), i % 2 ? "Buy" : "Sell", 100, user, "CompanyA" });
+                // every thread races for the same shared orderIds, only one of them may win each
+                m_orderCacheInterfacePtr->addOrder({ "Shared_OrdId" + std::to_string(i), "SecId" + std::to_string(i % 8), "Buy", 100, user, "CompanyB" });
+            }
+            for (int i = 0; i < ordersPerThread; i += 2) {
+                m_orderCacheInterfacePtr->cancelOrder(user + "_OrdId" + std::to_string(i));
+            }
+            m_orderCacheInterfacePtr->cancelOrdersForSecIdWithMinimumQty(user + "_SecId1", 100);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // odd orders of every thread survive the cancels unless they are on its "_SecId1" security
+    auto orders { m_orderCacheInterfacePtr->getAllOrders() };
+    EXPECT_EQ(std::count_if(orders.begin(), orders.end(), [](const Order& order) { return order.company() == "CompanyA"; }), threadsCount * ordersPerThread / 4);
+    EXPECT_EQ(std::count_if(orders.begin(), orders.end(), [](const Order& order) { return order.company() == "CompanyB"; }), ordersPerThread);
+
+    m_orderCacheInterfacePtr->cancelOrdersForUser("User0");
+    for (const auto& order : m_orderCacheInterfacePtr->getAllOrders()) {
+        EXPECT_NE(order.user(), "User0");
+    }
+}
+
+TEST(OrderCacheImplTests, Reserve_ThenAddAndCancel_Succeeds)
+{
+    OrderCacheImpl cache;
+    cache.reserve(10000);
+    for (int i = 0; i < 10000; ++i) {
+        cache.addOrder({ "OrdId" + std::to_string(i), "SecId" + std::to_string(i % 10), i % 2 ? "Buy" : "Sell", 100, "User" + std::to_string(i % 3), "Company" + std::to_string(i % 2) });
+    }
+    EXPECT_EQ(cache.getAllOrders().size(), 10000);
+    // a long orderId doesn't fit into std::string's inline buffer
+    cache.addOrder({ "OrdIdWithAVeryLongNameWhichIsAllocated", "SecId1", "Buy", 100, "User1", "Company1" });
+    cache.cancelOrdersForUser("User0");
+    cache.cancelOrder("OrdIdWithAVeryLongNameWhichIsAllocated");
+    EXPECT_EQ(cache.getAllOrders().size(), 10000 - 3334);
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 0);
+}
+
+static Order makeOrder(int i)
+{
+    return testorders::cyclicOrder(i, { 7, 5, 3, 100, 50 });
+}
+
+static std::vector<Order> sorted(std::vector<Order> orders)
+{
+    std::sort(orders.begin(), orders.end(), [](const Order& lhs, const Order& rhs) { return lhs.orderId() < rhs.orderId(); });
+    return orders;
+}
+
+TEST(OrderBookTests, Compaction_IncrementalOnCancels_Succeeds)
+{
+    const int count = 3 * OrderStore::kSegmentSlots;
+    OrderBook book;
+    OrderBook expected;
+    for (int i = 0; i < count; ++i) {
+        book.add(makeOrder(i));
+        if (i % 4 == 0) {
+            expected.add(makeOrder(i));
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        if (i % 4 != 0) {
+            book.cancel("OrdId" + std::to_string(i));
+        }
+    }
+
+    // tombstones never pile up above the threshold, moved orders stay reachable by orderId, user and security
+    EXPECT_LT(book.capacity(), count / 2);
+    EXPECT_LE(book.capacity() - book.size(), book.capacity() / 4);
+    EXPECT_EQ(sorted(book.orders()), sorted(expected.orders()));
+    for (int i = 0; i < 7; ++i) {
+        EXPECT_EQ(book.matchingSize("SecId" + std::to_string(i)), expected.matchingSize("SecId" + std::to_string(i)));
+    }
+    EXPECT_EQ(book.cancelForUser("User1"), expected.cancelForUser("User1"));
+    EXPECT_EQ(book.cancelForSecIdWithMinimumQty("SecId3", 120), expected.cancelForSecIdWithMinimumQty("SecId3", 120));
+    EXPECT_EQ(book.match("SecId2"), expected.match("SecId2"));
+    EXPECT_EQ(book.cancel("OrdId8"), 1);
+    EXPECT_EQ(expected.cancel("OrdId8"), 1);
+    EXPECT_EQ(sorted(book.orders()), sorted(expected.orders()));
+}
+
+TEST(OrderBookTests, Compaction_ExplicitKeepsSnapshots_Succeeds)
+{
+    const int count = 2 * OrderStore::kSegmentSlots;
+    OrderBook book;
+    book.setCompactionThreshold(0);
+    for (int i = 0; i < count; ++i) {
+        book.add(makeOrder(i));
+    }
+    book.cancelForUser("User0");
+    book.cancelForUser("User1");
+    EXPECT_EQ(book.capacity(), count);
+
+    const auto snapshot = book.snapshot();
+    const auto before = book.orders();
+    EXPECT_GT(book.compact(), 0);
+    EXPECT_EQ(book.capacity(), book.size());
+    EXPECT_EQ(sorted(book.orders()), sorted(before));
+    EXPECT_EQ(snapshot.orders(), before);
+
+    book.add(makeOrder(count));
+    EXPECT_EQ(book.size(), before.size() + 1);
+}
+
+template <typename Cache>
+class CacheTypeTests : public testorders::CacheTest<Cache> {
+};
+
+template <typename Cache>
+class ThreadSafeCacheTests : public testorders::CacheTest<Cache> {
+};
+
+TYPED_TEST_SUITE(CacheTypeTests, testorders::CacheTypes, testorders::CacheTypeNames);
+TYPED_TEST_SUITE(ThreadSafeCacheTests, testorders::ThreadSafeCacheTypes, testorders::CacheTypeNames);
+
+// adds, cancels and partial fills, so the book has tombstones, reused slots and changed quantities
+template <typename Cache>
+static void fillForSnapshotFile(Cache& cache)
+{
+    for (int i = 0; i < 5000; ++i) {
+        cache.addOrder(makeOrder(i));
+    }
+    for (int i = 0; i < 5000; i += 3) {
+        cache.cancelOrder("OrdId" + std::to_string(i));
+    }
+    cache.cancelOrdersForUser("User4");
+    cache.getMatchingSizeForSecurity2("SecId1");
+    for (int i = 5000; i < 5500; ++i) {
+        cache.addOrder(makeOrder(i));
+    }
+}
+
+template <typename Cache>
+static void expectSameState(Cache& lhs, Cache& rhs)
+{
+    EXPECT_EQ(lhs.getAllOrders(), rhs.getAllOrders());
+    for (int i = 0; i < 7; ++i) {
+        const std::string securityId = "SecId" + std::to_string(i);
+        EXPECT_EQ(lhs.getMatchingSizeForSecurity(securityId), rhs.getMatchingSizeForSecurity(securityId));
+        EXPECT_EQ(lhs.getMatchingSizeForSecurity2(securityId), rhs.getMatchingSizeForSecurity2(securityId));
+    }
+    lhs.cancelOrdersForUser("User2");
+    rhs.cancelOrdersForUser("User2");
+    lhs.cancelOrdersForSecIdWithMinimumQty("SecId3", 120);
+    rhs.cancelOrdersForSecIdWithMinimumQty("SecId3", 120);
+    EXPECT_EQ(lhs.getAllOrders(), rhs.getAllOrders());
+}
+
+TYPED_TEST(ThreadSafeCacheTests, SnapshotFile_RoundTrip_Succeeds)
+{
+    const std::string path = ::testing::TempDir() + "ordercache_ut.snapshot";
+    auto& cache = this->cache();
+    fillForSnapshotFile(cache);
+    cache.saveSnapshot(path);
+
+    auto loaded = testorders::makeCache<TypeParam>();
+    loaded->loadSnapshot(path);
+    EXPECT_EQ(loaded->getAllOrders(), cache.getAllOrders());
+    // the orderId index is loaded too
+    loaded->addOrder(makeOrder(5001));
+    EXPECT_EQ(loaded->getAllOrders().size(), cache.getAllOrders().size());
+    expectSameState(cache, *loaded);
+
+    EXPECT_THROW(loaded->loadSnapshot(path), std::logic_error);
+    std::remove(path.c_str());
+}
+
+TYPED_TEST(ThreadSafeCacheTests, SnapshotFile_Corrupted_Fails)
+{
+    const std::string path = ::testing::TempDir() + "ordercache_ut.snapshot";
+    fillForSnapshotFile(this->cache());
+    this->cache().saveSnapshot(path);
+    // drop the last posting list entries
+    ASSERT_EQ(::truncate(path.c_str(), 1000), 0);
+
+    auto loaded = testorders::makeCache<TypeParam>();
+    EXPECT_THROW(loaded->loadSnapshot(path), std::runtime_error);
+    EXPECT_TRUE(loaded->getAllOrders().empty());
+    loaded->addOrder(makeOrder(1));
+    EXPECT_EQ(loaded->getAllOrders().size(), 1);
+    std::remove(path.c_str());
+
+    EXPECT_THROW(loaded->loadSnapshot(path), std::system_error);
+}
+
+TEST(ShardedOrderCacheTests, SnapshotFile_OtherShardCount_Fails)
+{
+    const std::string path = ::testing::TempDir() + "shardedordercache_ut.snapshot";
+    ShardedOrderCache cache(4);
+    fillForSnapshotFile(cache);
+    cache.saveSnapshot(path);
+
+    ShardedOrderCache other(8);
+    EXPECT_THROW(other.loadSnapshot(path), std::runtime_error);
+    EXPECT_TRUE(other.getAllOrders().empty());
+    std::remove(path.c_str());
+}
+
+TEST(OrderCacheImplSnapshotTests, Snapshot_NotAffectedByLaterChanges_Succeeds)
+{
+    OrderCacheImpl cache;
+    cache.addOrder({ "OrdId1", "SecId1", "Sell", 1000, "User1", "CompanyA" });
+    cache.addOrder({ "OrdId2", "SecId1", "Buy", 400, "User2", "CompanyB" });
+    cache.addOrder({ "OrdId3", "SecId2", "Buy", 100, "User2", "CompanyB" });
+    const auto before { cache.getAllOrders() };
+
+    const auto snapshot { cache.snapshot() };
+    cache.cancelOrder("OrdId3");
+    EXPECT_EQ(cache.getMatchingSizeForSecurity2("SecId1"), 400);
+    cache.addOrder({ "OrdId4", "SecId3", "Sell", 700, "User3", "CompanyC" });
+
+    EXPECT_EQ(snapshot.size(), 3);
+    EXPECT_EQ(snapshot.orders(), before);
+
+    const auto after { cache.getAllOrders() };
+    EXPECT_EQ(after.size(), 2);
+    EXPECT_EQ(std::count(after.begin(), after.end(), Order { "OrdId1", "SecId1", "Sell", 600, "User1", "CompanyA" }), 1);
+}
+
+TEST(OrderCacheImplSnapshotTests, Snapshot_ReadWhileWritersRun_Succeeds)
+{
+    // spans a few segments so both copied and untouched segments are read
+    static constexpr int ordersCount = 3 * OrderStore::kSegmentSlots;
+
+    OrderCacheImpl cache;
+    for (int i = 0; i < ordersCount; ++i) {
+        cache.addOrder({ "OrdId" + std::to_string(i), "SecId" + std::to_string(i % 16), i % 2 ? "Buy" : "Sell", 100, "User" + std::to_string(i % 7), "Company" + std::to_string(i % 3) });
+    }
+
+    std::thread writer([&cache] {
+        for (int i = 0; i < ordersCount; i += 3) {
+            cache.cancelOrder("OrdId" + std::to_string(i));
+            cache.addOrder({ "NewOrdId" + std::to_string(i), "NewSecId", "Buy", 1, "NewUser", "NewCompany" });
+        }
+        cache.cancelOrdersForUser("User1");
+    });
+
+    for (int round = 0; round < 20; ++round) {
+        const auto snapshot { cache.snapshot() };
+        size_t count = 0;
+        unsigned long long qty = 0;
+        snapshot.forEach([&](const OrderBookSnapshot::Entry& order) {
+            ++count;
+            qty += order.qty;
+        });
+        EXPECT_EQ(count, snapshot.size());
+        EXPECT_GE(qty, count);
+    }
+    writer.join();
+
+    const auto orders { cache.getAllOrders() };
+    EXPECT_EQ(orders.size(), cache.snapshot().size());
+    for (const auto& order : orders) {
+        EXPECT_NE(order.user(), "User1");
+    }
+}
+
+TEST_P(OrderCacheInterfaceTests, BatchOperations_SameAsOneByOne_Succeeds)
+{
+    auto* batchCache = dynamic_cast<OrderCacheBatchInterface*>(m_orderCacheInterfacePtr.get());
+    ASSERT_NE(batchCache, nullptr);
+    auto oneByOneCache = GetParam().make();
+
+    std::vector<Order> orders;
+    for (int i = 0; i < 500; ++i) {
+        // every 10th orderId repeats an earlier one with a different security, the first one has to win
+        const int id = i % 10 == 9 ? i - 5 : i;
+        orders.push_back({ "OrdId" + std::to_string(id), "SecId" + std::to_string(i % 13), i % 3 ? "Buy" : "Sell", 100u + i, "User" + std::to_string(i % 7), "Company" + std::to_string(i % 5) });
+    }
+    std::vector<std::string> orderIds { "OrdId3", "OrdId3", "OrdIdUnknown", "OrdId100", "OrdId401" };
+    std::vector<std::string> users { "User2", "UserUnknown", "User5" };
+
+    batchCache->addOrders(orders);
+    batchCache->cancelOrders(orderIds);
+    batchCache->cancelOrdersForUsers(users);
+
+    for (const auto& order : orders) {
+        oneByOneCache->addOrder(order);
+    }
+    for (const auto& orderId : orderIds) {
+        oneByOneCache->cancelOrder(orderId);
+    }
+    for (const auto& user : users) {
+        oneByOneCache->cancelOrdersForUser(user);
+    }
+
+    auto byOrderId = [](const Order& lhs, const Order& rhs) { return lhs.orderId() < rhs.orderId(); };
+    auto batchOrders { m_orderCacheInterfacePtr->getAllOrders() };
+    auto oneByOneOrders { oneByOneCache->getAllOrders() };
+    std::sort(batchOrders.begin(), batchOrders.end(), byOrderId);
+    std::sort(oneByOneOrders.begin(), oneByOneOrders.end(), byOrderId);
+    EXPECT_FALSE(batchOrders.empty());
+    EXPECT_EQ(batchOrders, oneByOneOrders);
+    for (int i = 0; i < 13; ++i) {
+        const std::string secId { "SecId" + std::to_string(i) };
+        EXPECT_EQ(m_orderCacheInterfacePtr->getMatchingSizeForSecurity(secId), oneByOneCache->getMatchingSizeForSecurity(secId));
+    }
+}
+
+TYPED_TEST(ThreadSafeCacheTests, GetMatchingSizes_SameAsOneByOne_Succeeds)
+{
+    auto& cache = this->cache();
+    // more securities than a single task of the worker pool takes
+    const int securities = 3000;
+    for (int i = 0; i < 20000; ++i) {
+        cache.addOrder({ "OrdId" + std::to_string(i), "SecId" + std::to_string(i * 7 % securities), i % 3 ? "Buy" : "Sell", 100u + i % 50,
+            "User" + std::to_string(i % 11), "Company" + std::to_string(i % 4) });
+    }
+    cache.cancelOrdersForUser("User3");
+    cache.cancelOrdersForSecIdWithMinimumQty("SecId7", 120);
+    // all orders of SecId14 are gone, it is left out of the whole book result
+    cache.cancelOrdersForSecIdWithMinimumQty("SecId14", 0);
+
+    std::vector<std::string> securityIds { "SecIdUnknown" };
+    for (int i = securities - 1; i >= 0; --i) {
+        securityIds.push_back("SecId" + std::to_string(i));
+    }
+    const auto sizes = cache.getMatchingSizes(securityIds);
+    ASSERT_EQ(sizes.size(), securityIds.size());
+    for (size_t i = 0; i < securityIds.size(); ++i) {
+        EXPECT_EQ(sizes[i], cache.getMatchingSizeForSecurity(securityIds[i])) << securityIds[i];
+    }
+
+    const auto all = cache.getMatchingSizes();
+    EXPECT_EQ(all.size(), securities - 1);
+    EXPECT_TRUE(std::is_sorted(all.begin(), all.end()));
+    for (const auto& [securityId, size] : all) {
+        EXPECT_NE(securityId, "SecId14");
+        EXPECT_EQ(size, cache.getMatchingSizeForSecurity(securityId)) << securityId;
+    }
+}
+
+TEST(BasicOrderCacheTests, SharedMutexPolicy_ConcurrentCalls_Succeeds)
+{
+    static_assert(!std::is_polymorphic_v<BacktestOrderCache>, "policy caches aren't meant to have virtual calls");
+
+    const int threads = 4;
+    const int ordersPerThread = 1000;
+    BasicOrderCache<OrderBook, std::shared_mutex> cache;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; ++t) {
+        writers.emplace_back([&cache, t] {
+            for (int i = 0; i < ordersPerThread; ++i) {
+                cache.addOrder({ "OrdId" + std::to_string(t) + "_" + std::to_string(i), "SecId1", t % 2 ? "Buy" : "Sell", 10, "User" + std::to_string(t), "Company" + std::to_string(t) });
+                cache.getMatchingSizeForSecurity("SecId1");
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    EXPECT_EQ(cache.getAllOrders().size(), threads * ordersPerThread);
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("SecId1"), threads / 2 * ordersPerThread * 10);
+    cache.cancelOrdersForUser("User0");
+    EXPECT_EQ(cache.book().size(), (threads - 1) * ordersPerThread);
+}
+
+TYPED_TEST(ThreadSafeCacheTests, MemoryUsage_ShrinkGivesSlackBack_Succeeds)
+{
+    auto& cache = this->cache();
+    const int count = 3 * OrderStore::kSegmentSlots;
+    cache.reserve(2 * count);
+    for (int i = 0; i < count; ++i) {
+        cache.addOrder(makeOrder(i));
+    }
+    const MemoryUsage full = cache.memoryUsage();
+    EXPECT_EQ(full.orders, count);
+    EXPECT_GT(full.orderRecords, 0);
+    EXPECT_GT(full.symbols, 0);
+    EXPECT_GT(full.indexes, 0);
+    EXPECT_EQ(full.peak, full.total());
+    EXPECT_GT(full.bytesPerOrder(), 0);
+
+    for (int i = 0; i < count; ++i) {
+        if (i % 8 != 0) {
+            cache.cancelOrder("OrdId" + std::to_string(i));
+        }
+    }
+    const auto orders = sorted(cache.getAllOrders());
+    std::vector<unsigned int> sizes;
+    for (int i = 0; i < 7; ++i) {
+        sizes.push_back(cache.getMatchingSizeForSecurity("SecId" + std::to_string(i)));
+    }
+
+    cache.shrink();
+    const MemoryUsage shrunk = cache.memoryUsage();
+    EXPECT_EQ(shrunk.orders, count / 8);
+    EXPECT_EQ(shrunk.capacity, count / 8);
+    EXPECT_LT(shrunk.orderRecords, full.orderRecords / 2);
+    EXPECT_LT(shrunk.total(), full.total());
+    EXPECT_GE(shrunk.peak, full.total());
+
+    // same book after shrinking, the rebuilt orderId index included
+    EXPECT_EQ(sorted(cache.getAllOrders()), orders);
+    for (int i = 0; i < 7; ++i) {
+        EXPECT_EQ(cache.getMatchingSizeForSecurity("SecId" + std::to_string(i)), sizes[i]);
+    }
+    cache.cancelOrder("OrdId8");
+    cache.addOrder(makeOrder(8));
+    EXPECT_EQ(cache.getAllOrders().size(), count / 8);
+}
+
+// reference for the mass cancels: orderIds of orders the predicate picks, sorted
+template <typename Predicate>
+static std::vector<std::string> selectOrderIds(const std::vector<Order>& orders, Predicate predicate)
+{
+    std::vector<std::string> out;
+    for (const auto& order : orders) {
+        if (predicate(order)) {
+            out.push_back(order.orderId());
+        }
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+TYPED_TEST(CacheTypeTests, MassCancels_SameAsReference_Succeeds)
+{
+    auto& cache = this->cache();
+    // enough orders for incremental compaction to move slots around between the cancels
+    const int count = 3 * OrderStore::kSegmentSlots;
+    for (int i = 0; i < count; ++i) {
+        cache.addOrder(makeOrder(i));
+    }
+    auto sortedIds = [](std::vector<std::string> ids) {
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    auto expected = selectOrderIds(cache.getAllOrders(), [](const Order& order) { return order.company() == "Company1"; });
+    EXPECT_EQ(expected.size(), count / 3);
+    EXPECT_EQ(sortedIds(cache.cancelOrdersForCompany("Company1")), expected);
+    EXPECT_TRUE(cache.cancelOrdersForCompany("Company1").empty());
+    EXPECT_TRUE(cache.cancelOrdersForCompany("CompanyUnknown").empty());
+
+    OrderFilter filter;
+    filter.securityId = "SecId3";
+    filter.side = "Buy";
+    filter.minQty = 110;
+    filter.maxQty = 130;
+    expected = selectOrderIds(cache.getAllOrders(), [](const Order& order) {
+        return order.securityId() == "SecId3" && order.side() == "Buy" && order.qty() >= 110 && order.qty() <= 130;
+    });
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(sortedIds(cache.cancelOrdersMatching(filter)), expected);
+
+    // user and company together, the shorter of the two lists is walked
+    filter = {};
+    filter.user = "User2";
+    filter.company = "Company0";
+    expected = selectOrderIds(cache.getAllOrders(), [](const Order& order) { return order.user() == "User2" && order.company() == "Company0"; });
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(sortedIds(cache.cancelOrdersMatching(filter)), expected);
+
+    // no indexed condition, the whole store is swept
+    filter = {};
+    filter.side = "Sell";
+    filter.maxQty = 104;
+    expected = selectOrderIds(cache.getAllOrders(), [](const Order& order) { return order.side() == "Sell" && order.qty() <= 104; });
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(sortedIds(cache.cancelOrdersMatching(filter)), expected);
+
+    filter = {};
+    filter.user = "UserUnknown";
+    EXPECT_TRUE(cache.cancelOrdersMatching(filter).empty());
+
+    // what is left is still indexed correctly, cancelled orderIds can be added again
+    const auto left = cache.getAllOrders();
+    expected = selectOrderIds(left, [](const Order& order) { return order.company() == "Company2"; });
+    EXPECT_EQ(sortedIds(cache.cancelOrdersForCompany("Company2")), expected);
+    EXPECT_EQ(cache.getAllOrders().size(), left.size() - expected.size());
+    cache.addOrder(makeOrder(1));
+    expected = selectOrderIds(cache.getAllOrders(), [](const Order&) { return true; });
+    EXPECT_EQ(std::count(expected.begin(), expected.end(), "OrdId1"), 1);
+    EXPECT_EQ(sortedIds(cache.cancelOrdersMatching({})), expected);
+    EXPECT_TRUE(cache.getAllOrders().empty());
+}
+
+TEST(OrderCacheImplTests, SnapshotFile_CompanyIndexRebuilt_Succeeds)
+{
+    const std::string path = "/tmp/ordercache_company_" + std::to_string(::getpid()) + ".snapshot";
+    OrderCacheImpl saved;
+    for (int i = 0; i < 100; ++i) {
+        saved.addOrder(makeOrder(i));
+    }
+    saved.saveSnapshot(path);
+
+    OrderCacheImpl loaded;
+    loaded.loadSnapshot(path);
+    std::remove(path.c_str());
+    auto removed = loaded.cancelOrdersForCompany("Company0");
+    std::sort(removed.begin(), removed.end());
+    EXPECT_EQ(removed, selectOrderIds(saved.getAllOrders(), [](const Order& order) { return order.company() == "Company0"; }));
+}
+
+TYPED_TEST(ThreadSafeCacheTests, TopMatchingSizes_SameAsSortedSizes_Succeeds)
+{
+    auto& cache = this->cache();
+    std::mt19937 rng { 3 };
+    auto expectSameAsSorted = [&cache] {
+        auto all = cache.getMatchingSizes();
+        all.erase(std::remove_if(all.begin(), all.end(), [](const auto& entry) { return entry.second == 0; }), all.end());
+        std::stable_sort(all.begin(), all.end(), [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second; });
+        for (size_t n : { size_t { 1 }, size_t { 5 }, all.size() + 1 }) {
+            const auto top = cache.getTopMatchingSizes(n);
+            ASSERT_EQ(top.size(), std::min(n, all.size()));
+            for (size_t i = 0; i < top.size(); ++i) {
+                // ties may come in any order, sizes may not
+                EXPECT_EQ(top[i].second, all[i].second);
+                EXPECT_EQ(top[i].second, cache.getMatchingSizeForSecurity(top[i].first));
+            }
+        }
+    };
+
+    for (int i = 0; i < 5000; ++i) {
+        cache.addOrder(testorders::randomOrder(rng, i, { 40, 10, 4, 0, 1000 }));
+    }
+    expectSameAsSorted();
+    for (int i = 0; i < 5000; i += 3) {
+        cache.cancelOrder("OrdId" + std::to_string(i));
+    }
+    cache.cancelOrdersForUser("User1");
+    cache.cancelOrdersForSecIdWithMinimumQty("SecId7", 300);
+    expectSameAsSorted();
+    for (int i = 0; i < 40; i += 2) {
+        cache.getMatchingSizeForSecurity2("SecId" + std::to_string(i));
+    }
+    expectSameAsSorted();
+    cache.cancelOrdersForCompany("Company2");
+    expectSameAsSorted();
+}
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+
+#include "../workerpool.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST(WorkerPoolTests, Run_EveryTaskOnce_Succeeds)
+{
+    WorkerPool pool(4);
+    std::vector<std::atomic<int>> runs(1000);
+    for (int round = 0; round < 3; ++round) {
+        pool.run(runs.size(), [&runs](size_t task) { ++runs[task]; });
+    }
+    for (const auto& count : runs) {
+        EXPECT_EQ(count, 3);
+    }
+    pool.run(0, [](size_t) { FAIL(); });
+}
+
+TEST(WorkerPoolTests, Run_ExceptionIsRethrown_Fails)
+{
+    WorkerPool pool(3);
+    EXPECT_THROW(pool.run(100, [](size_t task) {
+        if (task == 42) {
+            throw std::runtime_error("task failed");
+        }
+    }),
+        std::runtime_error);
+
+    // the pool is usable afterwards
+    std::atomic<size_t> sum { 0 };
+    pool.run(10, [&sum](size_t task) { sum += task; });
+    EXPECT_EQ(sum, 45);
+}
+
+TEST(WorkerPoolTests, Run_ConcurrentCallers_Succeeds)
+{
+    WorkerPool pool(2);
+    std::atomic<size_t> sum { 0 };
+    std::vector<std::thread> callers;
+    for (int t = 0; t < 4; ++t) {
+        callers.emplace_back([&pool, &sum] {
+            for (int round = 0; round < 50; ++round) {
+                pool.run(20, [&sum](size_t task) { sum += task; });
+            }
+        });
+    }
+    for (auto& caller : callers) {
+        caller.join();
+    }
+    EXPECT_EQ(sum, 4 * 50 * 190);
+}
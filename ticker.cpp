@@ -0,0 +1,39 @@
+#include "ticker.hpp"
+
+#include <algorithm>
+#include <utility>
+
+Ticker::Ticker(std::chrono::nanoseconds interval, std::function<void()> f)
+    : m_interval(interval)
+    , m_f(std::move(f))
+    , m_thread(&Ticker::run, this)
+{
+}
+
+Ticker::~Ticker()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+void Ticker::run()
+{
+    // fixed rate, a slow call doesn't shift the following ones
+    auto next = std::chrono::steady_clock::now() + m_interval;
+    std::unique_lock lock(m_mutex);
+    while (!m_wake.wait_until(lock, next, [this] { return m_stop; })) {
+        lock.unlock();
+        try {
+            m_f();
+        } catch (...) {
+            // an exception must not leave the thread, that would terminate the process
+            return;
+        }
+        lock.lock();
+        next = std::max(next + m_interval, std::chrono::steady_clock::now());
+    }
+}
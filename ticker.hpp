@@ -0,0 +1,32 @@
+#ifndef TICKER_HPP
+#define TICKER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Background thread calling f every interval until the ticker is destroyed, e.g. the expiry of the caches. The
+// destructor waits for a running call to finish, so f may use anything which outlives the ticker. An exception thrown
+// by f stops the ticker - it is dropped there, f keeps what its owner has to know before rethrowing.
+class Ticker {
+public:
+    Ticker(std::chrono::nanoseconds interval, std::function<void()> f);
+    ~Ticker();
+
+    Ticker(const Ticker&) = delete;
+    Ticker& operator=(const Ticker&) = delete;
+
+private:
+    void run();
+
+    const std::chrono::nanoseconds m_interval;
+    const std::function<void()> m_f;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stop { false };
+    std::thread m_thread;
+};
+
+#endif // TICKER_HPP
@@ -0,0 +1,124 @@
+#include "timingwheel.hpp"
+
+uint32_t TimingWheel::insert(uint32_t id, uint64_t deadline)
+{
+    uint32_t timer = m_free;
+    if (timer != npos) {
+        m_free = m_timers[timer].next;
+    } else {
+        timer = static_cast<uint32_t>(m_timers.size());
+        m_timers.emplace_back();
+    }
+    m_timers[timer].deadline = deadline;
+    m_timers[timer].id = id;
+    link(timer);
+    ++m_size;
+    return timer;
+}
+
+void TimingWheel::cancel(uint32_t timer)
+{
+    unlink(timer);
+    release(timer);
+}
+
+void TimingWheel::advance(uint64_t now, std::vector<uint32_t>& expired)
+{
+    m_pending.clear();
+    take(kDue);
+    if (now > m_now) {
+        for (size_t level = 0; level < kLevels; ++level) {
+            const unsigned shift = level * kBits;
+            const uint64_t from = m_now >> shift;
+            const uint64_t to = now >> shift;
+            // the digits above didn't change either
+            if (from == to) {
+                break;
+            }
+            // buckets of the digits after from up to to, all of them once the time went around the level
+            uint64_t passed = ~uint64_t(0);
+            if (to - from < kBuckets) {
+                const uint64_t digits = (uint64_t(1) << (to - from)) - 1;
+                const unsigned first = (from + 1) % kBuckets;
+                passed = first ? digits << first | digits >> (kBuckets - first) : digits;
+            }
+            for (uint64_t buckets = passed & m_occupied[level]; buckets; buckets &= buckets - 1) {
+                take(level * kBuckets + __builtin_ctzll(buckets));
+            }
+        }
+        m_now = now;
+    }
+
+    for (const uint32_t timer : m_pending) {
+        if (m_timers[timer].deadline <= m_now) {
+            expired.push_back(m_timers[timer].id);
+            release(timer);
+        } else {
+            link(timer);
+        }
+    }
+}
+
+void TimingWheel::shrink()
+{
+    m_pending.clear();
+    m_pending.shrink_to_fit();
+    if (!m_size) {
+        m_timers.clear();
+        m_timers.shrink_to_fit();
+        m_free = npos;
+    }
+}
+
+void TimingWheel::link(uint32_t timer)
+{
+    Timer& entry = m_timers[timer];
+    size_t bucket = kDue;
+    if (entry.deadline > m_now) {
+        const unsigned level = (63 - __builtin_clzll(entry.deadline ^ m_now)) / kBits;
+        const size_t digit = (entry.deadline >> (level * kBits)) % kBuckets;
+        bucket = level * kBuckets + digit;
+        m_occupied[level] |= uint64_t(1) << digit;
+    }
+    entry.bucket = static_cast<uint32_t>(bucket);
+    entry.prev = npos;
+    entry.next = m_heads[bucket];
+    if (entry.next != npos) {
+        m_timers[entry.next].prev = timer;
+    }
+    m_heads[bucket] = timer;
+}
+
+void TimingWheel::unlink(uint32_t timer)
+{
+    const Timer& entry = m_timers[timer];
+    if (entry.prev != npos) {
+        m_timers[entry.prev].next = entry.next;
+    } else {
+        m_heads[entry.bucket] = entry.next;
+        if (entry.next == npos && entry.bucket != kDue) {
+            m_occupied[entry.bucket / kBuckets] &= ~(uint64_t(1) << entry.bucket % kBuckets);
+        }
+    }
+    if (entry.next != npos) {
+        m_timers[entry.next].prev = entry.prev;
+    }
+}
+
+void TimingWheel::take(size_t bucket)
+{
+    for (uint32_t timer = m_heads[bucket]; timer != npos; timer = m_timers[timer].next) {
+        m_pending.push_back(timer);
+    }
+    m_heads[bucket] = npos;
+    if (bucket != kDue) {
+        m_occupied[bucket / kBuckets] &= ~(uint64_t(1) << bucket % kBuckets);
+    }
+}
+
+void TimingWheel::release(uint32_t timer)
+{
+    m_timers[timer].next = m_free;
+    m_free = timer;
+    --m_size;
+}
@@ -0,0 +1,117 @@
+#ifndef TIMINGWHEEL_HPP
+#define TIMINGWHEEL_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timing wheel (Varghese & Lauck) of deadlines in integer ticks, used by the OrderBook to expire
+// good-till-time orders.
+//
+// kLevels wheels of kBuckets buckets each, level l covers ticks in steps of kBuckets^l. A timer goes to the level of
+// the highest base-kBuckets digit in which its deadline differs from the wheel's time and to the bucket of that digit,
+// so insert and cancel are O(1) list operations on a pool of timers. Advancing the wheel visits only the buckets the
+// time passed at each level (found through per level occupancy bitmasks) - timers there either expire or cascade to a
+// lower level, every timer cascades at most kLevels times. Time jumps of any size cost at most kLevels * kBuckets
+// bucket visits, there is no per tick work.
+class TimingWheel {
+public:
+    static constexpr uint32_t npos = static_cast<uint32_t>(-1);
+
+    // schedules id, returns the timer. A deadline which isn't after now() expires on the next advance().
+    uint32_t insert(uint32_t id, uint64_t deadline);
+    void cancel(uint32_t timer);
+    // the timer reports another id, e.g. its order moved to another slot
+    void rebind(uint32_t timer, uint32_t id) { m_timers[timer].id = id; }
+    uint64_t deadline(uint32_t timer) const { return m_timers[timer].deadline; }
+
+    // moves the wheel to now (it never goes back) and appends ids of the timers with deadline <= now to expired, in no
+    // particular order. Expired timers are freed.
+    void advance(uint64_t now, std::vector<uint32_t>& expired);
+
+    uint64_t now() const { return m_now; }
+    // scheduled timers
+    size_t size() const { return m_size; }
+    size_t memoryBytes() const
+    {
+        return m_timers.capacity() * sizeof(Timer) + m_pending.capacity() * sizeof(uint32_t) + sizeof(m_heads);
+    }
+    // frees the timer pool once no timer is scheduled
+    void shrink();
+
+private:
+    static constexpr unsigned kBits = 6;
+    static constexpr size_t kBuckets = size_t(1) << kBits;
+    // 11 * 6 bits cover every uint64_t deadline
+    static constexpr size_t kLevels = 11;
+    // list of timers which were due when they were inserted
+    static constexpr size_t kDue = kLevels * kBuckets;
+
+    struct Timer {
+        uint64_t deadline;
+        uint32_t id;
+        // bucket list links, free timers are chained through next
+        uint32_t prev;
+        uint32_t next;
+        uint32_t bucket;
+    };
+
+    // puts the timer into the bucket of its deadline relative to m_now
+    void link(uint32_t timer);
+    void unlink(uint32_t timer);
+    // moves the timers of the bucket to m_pending
+    void take(size_t bucket);
+    void release(uint32_t timer);
+
+    std::vector<Timer> m_timers;
+    uint32_t m_free { npos };
+    std::array<uint32_t, kDue + 1> m_heads = initialHeads();
+    // non empty buckets by level
+    std::array<uint64_t, kLevels> m_occupied {};
+    uint64_t m_now { 0 };
+    size_t m_size { 0 };
+    // timers taken out of passed buckets, grown once and reused
+    std::vector<uint32_t> m_pending;
+
+    static std::array<uint32_t, kDue + 1> initialHeads()
+    {
+        std::array<uint32_t, kDue + 1> out;
+        out.fill(npos);
+        return out;
+    }
+};
+
+// The caches schedule expiries on the wall clock in milliseconds since the Unix epoch, so deadlines mean the same after
+// a restart and are journaled and saved in snapshots as they are. Deadlines round up and readings of the clock round
+// down, so an order never expires before its time. The wheel never goes back: when the wall clock is set back, orders
+// expire once it passes their deadline again.
+namespace expiry {
+
+using Clock = std::chrono::system_clock;
+
+inline uint64_t deadline(Clock::time_point time)
+{
+    const auto ms = std::chrono::ceil<std::chrono::milliseconds>(time.time_since_epoch()).count();
+    return ms > 0 ? static_cast<uint64_t>(ms) : 0;
+}
+
+inline uint64_t reading(Clock::time_point time)
+{
+    const auto ms = std::chrono::floor<std::chrono::milliseconds>(time.time_since_epoch()).count();
+    return ms > 0 ? static_cast<uint64_t>(ms) : 0;
+}
+
+// back from a deadline, e.g. a journaled one - clamped to what the clock can hold
+inline Clock::time_point timePoint(uint64_t deadline)
+{
+    using std::chrono::milliseconds;
+    const auto limit = std::chrono::floor<milliseconds>(Clock::time_point::max().time_since_epoch()).count();
+    return Clock::time_point(milliseconds(std::min<uint64_t>(deadline, static_cast<uint64_t>(limit))));
+}
+
+} // namespace expiry
+
+#endif // TIMINGWHEEL_HPP
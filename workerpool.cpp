@@ -0,0 +1,87 @@
+#include "workerpool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+WorkerPool::WorkerPool(size_t threads)
+    : m_threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeWorkers.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::run(size_t tasks, const std::function<void(size_t)>& f)
+{
+    if (tasks == 0) {
+        return;
+    }
+    std::scoped_lock runLock(m_runMutex);
+
+    std::unique_lock lock(m_mutex);
+    // the calling thread works too, so a single task never leaves it
+    if (m_workers.empty() && tasks > 1) {
+        for (size_t i = 1; i < m_threads; ++i) {
+            m_workers.emplace_back(&WorkerPool::work, this);
+        }
+    }
+    m_job = &f;
+    m_next = 0;
+    m_tasks = tasks;
+    m_error = nullptr;
+    m_wakeWorkers.notify_all();
+
+    drain(lock);
+    m_done.wait(lock, [this] { return m_running == 0; });
+    m_job = nullptr;
+    if (m_error) {
+        std::rethrow_exception(std::exchange(m_error, nullptr));
+    }
+}
+
+void WorkerPool::work()
+{
+    std::unique_lock lock(m_mutex);
+    for (;;) {
+        m_wakeWorkers.wait(lock, [this] { return m_stop || (m_job && m_next < m_tasks); });
+        if (m_stop) {
+            return;
+        }
+        drain(lock);
+    }
+}
+
+void WorkerPool::drain(std::unique_lock<std::mutex>& lock)
+{
+    while (m_next < m_tasks) {
+        const size_t task = m_next++;
+        const auto* job = m_job;
+        ++m_running;
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            (*job)(task);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+        --m_running;
+        if (error && !m_error) {
+            m_error = error;
+            // skip what is left
+            m_next = m_tasks;
+        }
+    }
+    if (m_running == 0) {
+        m_done.notify_all();
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads for fork-join jobs over the whole book (e.g. matching sizes of all securities). Threads are
+// started by the first run() so caches which never run a bulk job don't pay for them, jobs of concurrent callers
+// run one after another.
+class WorkerPool {
+public:
+    // 0 picks std::thread::hardware_concurrency()
+    explicit WorkerPool(size_t threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // calls f(task) for every task in [0, tasks) on the workers and the calling thread, returns once all of them are
+    // done. The first exception thrown by f is rethrown, tasks not started yet are skipped then.
+    void run(size_t tasks, const std::function<void(size_t)>& f);
+
+    size_t threads() const { return m_threads; }
+
+private:
+    void work();
+    // takes tasks of the current job until there are none left, called with m_mutex held
+    void drain(std::unique_lock<std::mutex>& lock);
+
+    const size_t m_threads;
+    // one job at a time
+    std::mutex m_runMutex;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeWorkers;
+    std::condition_variable m_done;
+    const std::function<void(size_t)>* m_job { nullptr };
+    size_t m_next { 0 };
+    size_t m_tasks { 0 };
+    size_t m_running { 0 };
+    std::exception_ptr m_error;
+    bool m_stop { false };
+    std::vector<std::thread> m_workers;
+};
+
+#endif // WORKERPOOL_HPP